@@ -45,6 +45,27 @@ private:
 #define CONF_DERECHO_MAX_P2P_REQUEST_PAYLOAD_SIZE "DERECHO/max_p2p_request_payload_size"
 #define CONF_DERECHO_MAX_P2P_REPLY_PAYLOAD_SIZE "DERECHO/max_p2p_reply_payload_size"
 #define CONF_DERECHO_P2P_WINDOW_SIZE "DERECHO/p2p_window_size"
+#define CONF_DERECHO_SST_POLLING_MODE "DERECHO/sst_polling_mode"
+#define CONF_DERECHO_SST_POLLING_SPIN_US "DERECHO/sst_polling_spin_us"
+#define CONF_DERECHO_SST_POLLING_MAX_SLEEP_US "DERECHO/sst_polling_max_sleep_us"
+#define CONF_DERECHO_P2P_POLLING_MODE "DERECHO/p2p_polling_mode"
+#define CONF_DERECHO_P2P_POLLING_SPIN_US "DERECHO/p2p_polling_spin_us"
+#define CONF_DERECHO_P2P_POLLING_MAX_SLEEP_US "DERECHO/p2p_polling_max_sleep_us"
+#define CONF_DERECHO_SST_PREDICATE_THREADS "DERECHO/sst_predicate_threads"
+#define CONF_DERECHO_SST_PREDICATE_THREAD_CPUS "DERECHO/sst_predicate_thread_cpus"
+#define CONF_DERECHO_SST_PER_SHARD_SMC "DERECHO/sst_per_shard_smc"
+#define CONF_DERECHO_SHM_TRANSPORT "DERECHO/shm_transport"
+#define CONF_DERECHO_SMC_PACKING "DERECHO/smc_packing"
+#define CONF_DERECHO_SMC_RING_SIZE "DERECHO/smc_ring_size"
+#define CONF_DERECHO_RDMC_MAX_IN_FLIGHT "DERECHO/rdmc_max_in_flight"
+#define CONF_DERECHO_RDMC_RACKS "DERECHO/rdmc_racks"
+#define CONF_DERECHO_RDMC_ADAPTIVE_BLOCK_SIZE "DERECHO/rdmc_adaptive_block_size"
+#define CONF_DERECHO_RDMC_MIN_BLOCK_SIZE "DERECHO/rdmc_min_block_size"
+#define CONF_DERECHO_MAX_REGISTERED_SEND_BUFFERS "DERECHO/max_registered_send_buffers"
+#define CONF_DERECHO_MESSAGE_BUFFER_SLAB_SIZE "DERECHO/message_buffer_slab_size"
+#define CONF_DERECHO_MAX_MESSAGE_BUFFER_BYTES "DERECHO/max_message_buffer_bytes"
+#define CONF_DERECHO_BATCHED_RPC_DELIVERY "DERECHO/batched_rpc_delivery"
+#define CONF_DERECHO_DELIVERY_THREADS "DERECHO/delivery_threads"
 
 #define CONF_SUBGROUP_DEFAULT_MAX_PAYLOAD_SIZE "SUBGROUP/DEFAULT/max_payload_size"
 #define CONF_SUBGROUP_DEFAULT_MAX_REPLY_PAYLOAD_SIZE "SUBGROUP/DEFAULT/max_reply_payload_size"
@@ -89,6 +110,27 @@ private:
 	        {CONF_DERECHO_MAX_P2P_REQUEST_PAYLOAD_SIZE, "10240"},
 	        {CONF_DERECHO_MAX_P2P_REPLY_PAYLOAD_SIZE, "10240"},
 	        {CONF_DERECHO_P2P_WINDOW_SIZE, "16"},
+            {CONF_DERECHO_SST_POLLING_MODE, "spin_sleep"},
+            {CONF_DERECHO_SST_POLLING_SPIN_US, "1000"},
+            {CONF_DERECHO_SST_POLLING_MAX_SLEEP_US, "1000"},
+            {CONF_DERECHO_P2P_POLLING_MODE, "spin_sleep"},
+            {CONF_DERECHO_P2P_POLLING_SPIN_US, "1000"},
+            {CONF_DERECHO_P2P_POLLING_MAX_SLEEP_US, "1000"},
+            {CONF_DERECHO_SST_PREDICATE_THREADS, "1"},
+            {CONF_DERECHO_SST_PREDICATE_THREAD_CPUS, ""},
+            {CONF_DERECHO_SST_PER_SHARD_SMC, "false"},
+            {CONF_DERECHO_SHM_TRANSPORT, "false"},
+            {CONF_DERECHO_SMC_PACKING, "false"},
+            {CONF_DERECHO_SMC_RING_SIZE, "0"},
+            {CONF_DERECHO_RDMC_MAX_IN_FLIGHT, "1"},
+            {CONF_DERECHO_RDMC_RACKS, ""},
+            {CONF_DERECHO_RDMC_ADAPTIVE_BLOCK_SIZE, "false"},
+            {CONF_DERECHO_RDMC_MIN_BLOCK_SIZE, "4096"},
+            {CONF_DERECHO_MAX_REGISTERED_SEND_BUFFERS, "16"},
+            {CONF_DERECHO_MESSAGE_BUFFER_SLAB_SIZE, "16777216"},
+            {CONF_DERECHO_MAX_MESSAGE_BUFFER_BYTES, "0"},
+            {CONF_DERECHO_BATCHED_RPC_DELIVERY, "false"},
+            {CONF_DERECHO_DELIVERY_THREADS, "false"},
             {CONF_DERECHO_MAX_NODE_ID, "1024"},
             // [SUBGROUP/<subgroupname>]
             {CONF_SUBGROUP_DEFAULT_MAX_PAYLOAD_SIZE, "10240"},
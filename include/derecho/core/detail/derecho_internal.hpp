@@ -13,6 +13,7 @@
 #include <string>
 #include <sys/types.h>
 #include <utility>
+#include <vector>
 
 #include "../derecho_type_definitions.hpp"
 #include <derecho/persistent/HLC.hpp>
@@ -62,6 +63,27 @@ using verified_callback_t = std::function<void(subgroup_id_t, persistent::versio
  * Matches the type signature of RPCManager::rpc_message_handler (but as a free function).
  */
 using rpc_handler_t = std::function<void(subgroup_id_t, node_id_t, persistent::version_t, uint64_t, char*, uint32_t)>;
+/**
+ * One RPC message in a batch delivered by MulticastGroup, with the same
+ * contents as the arguments of an rpc_handler_t call.
+ */
+struct rpc_message_t {
+    node_id_t sender_id;
+    persistent::version_t version;
+    /** The message's timestamp, in microseconds */
+    uint64_t timestamp;
+    char* buffer;
+    uint32_t size;
+};
+/**
+ * The type of the function used by MulticastGroup to hand RPCManager a batch
+ * of messages to deliver in order (see RPCManager::rpc_batch_handler). The
+ * last parameter must be called with each message's position in the batch
+ * as soon as its handler has run, so that MulticastGroup can finish
+ * delivering that message before the next one is handled.
+ */
+using rpc_batch_handler_t = std::function<void(subgroup_id_t, const std::vector<rpc_message_t>&,
+                                               const std::function<void(std::size_t)>&)>;
 
 /**
  * Bundles together a set of callback functions for message delivery events.
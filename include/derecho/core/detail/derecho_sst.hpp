@@ -10,6 +10,7 @@
 #include "../derecho_type_definitions.hpp"
 #include "derecho_internal.hpp"
 #include <derecho/sst/sst.hpp>
+#include <derecho/utils/logger.hpp>
 
 namespace derecho {
 
@@ -37,7 +38,12 @@ inline ChangeProposal make_change_proposal(uint16_t leader_id, uint16_t change_i
 
 /**
  * ViewManager and MulticastGroup will share the same SST for efficiency. This
- * class defines all the fields in this SST.
+ * class defines all the fields in this SST. The counters that change with
+ * every message are declared HOT, so each one gets its own cache lines and
+ * does not contend with the GMS fields or with the other counters. A HOT
+ * field is preceded and followed by padding, so code that pushes a run of
+ * consecutive fields at once (like the joiner fields) must compute the range
+ * from the fields' get_base() addresses, never by adding up their sizes.
  */
 class DerechoSST : public sst::SST<DerechoSST> {
 public:
@@ -164,7 +170,10 @@ public:
      * has published a global_min for the current view change
      */
     SSTFieldVector<bool> global_min_ready;
-    /** for SST multicast */
+    /**
+     * for SST multicast; these three columns are empty when
+     * DERECHO/sst_per_shard_smc moves them into per-shard SMCShardSSTs
+     */
     SSTFieldVector<char> slots;
     SSTFieldVector<int32_t> num_received_sst;
     SSTFieldVector<int32_t> index;
@@ -179,13 +188,17 @@ public:
      * (0, false, etc.). Initializing the MulticastGroup fields is left to MulticastGroup.
      * @param parameters The SST parameters, which will be forwarded to the
      * standard SST constructor.
+     * @param num_received_sst_size The size of the num_received_sst column,
+     * which is 0 (like slot_size and index_field_size) when the SMC columns
+     * are kept in per-shard SSTs instead.
      */
-    DerechoSST(const sst::SSTParams& parameters, uint32_t num_subgroups, uint32_t signature_size, uint32_t num_received_size, uint64_t slot_size, uint32_t index_field_size)
+    DerechoSST(const sst::SSTParams& parameters, uint32_t num_subgroups, uint32_t signature_size, uint32_t num_received_size,
+               uint64_t slot_size, uint32_t index_field_size, uint32_t num_received_sst_size)
             : sst::SST<DerechoSST>(this, parameters),
-              seq_num(num_subgroups),
-              delivered_num(num_subgroups),
+              seq_num(num_subgroups, sst::FieldAccess::HOT),
+              delivered_num(num_subgroups, sst::FieldAccess::HOT),
               signatures(num_subgroups * signature_size),
-              persisted_num(num_subgroups),
+              persisted_num(num_subgroups, sst::FieldAccess::HOT),
               verified_num(num_subgroups),
               suspected(parameters.members.size()),
               changes(100 + parameters.members.size()),  //The extra 100 entries allows for more joins at startup, when the group is very small
@@ -195,20 +208,21 @@ public:
               joiner_sst_ports(100 + parameters.members.size()),
               joiner_rdmc_ports(100 + parameters.members.size()),
               joiner_external_ports(100 + parameters.members.size()),
-              num_received(num_received_size),
+              num_received(num_received_size, sst::FieldAccess::HOT),
               global_min(num_received_size),
               global_min_ready(num_subgroups),
               slots(slot_size),
-              num_received_sst(num_received_size),
-              index(index_field_size),
+              num_received_sst(num_received_sst_size, sst::FieldAccess::HOT),
+              index(index_field_size, sst::FieldAccess::HOT),
               local_stability_frontier(num_subgroups) {
-        SSTInit(seq_num, delivered_num, signatures,
-                persisted_num, verified_num,
-                vid, suspected, changes, joiner_ips,
-                joiner_gms_ports, joiner_state_transfer_ports, joiner_sst_ports, joiner_rdmc_ports, joiner_external_ports,
-                num_changes, num_committed, num_acked, num_installed,
-                num_received, wedged, global_min, global_min_ready,
-                slots, num_received_sst, index, local_stability_frontier, rip);
+        SST_INIT_NAMED(seq_num, delivered_num, signatures,
+                       persisted_num, verified_num,
+                       vid, suspected, changes, joiner_ips,
+                       joiner_gms_ports, joiner_state_transfer_ports, joiner_sst_ports, joiner_rdmc_ports, joiner_external_ports,
+                       num_changes, num_committed, num_acked, num_installed,
+                       num_received, wedged, global_min, global_min_ready,
+                       slots, num_received_sst, index, local_stability_frontier, rip);
+        dbg_default_debug("DerechoSST row layout: {}", layout_to_string());
         //Once superclass constructor has finished, table entries can be initialized
         for(unsigned int row = 0; row < get_num_rows(); ++row) {
             vid[row] = 0;
@@ -280,6 +294,45 @@ public:
     std::string to_string() const;
 };
 
+/**
+ * An SST that holds the SST multicast (SMC) columns of a single shard, used
+ * in place of DerechoSST's slots, num_received_sst, and index columns when
+ * DERECHO/sst_per_shard_smc is enabled. Its rows are the shard's members in
+ * shard-rank order, so only shard members register it, and its columns are
+ * sized for this shard alone.
+ */
+class SMCShardSST : public sst::SST<SMCShardSST> {
+public:
+    /** The SMC message slots of this shard, laid out as in DerechoSST. */
+    SSTFieldVector<char> slots;
+    /** One entry per shard sender: the number of SMC messages received from it. */
+    SSTFieldVector<int32_t> num_received_sst;
+    /** A single entry: the index of the last SMC message this member committed. */
+    SSTFieldVector<int32_t> index;
+
+    /**
+     * Constructs the SST and initializes every row (not only the local one)
+     * to "nothing sent, nothing received", since the remote rows are only
+     * ever written by their owners' SMC pushes.
+     * @param parameters The SST parameters; the members must be the shard members
+     * @param slot_size The size of the slots column for this shard
+     * @param num_shard_senders The number of senders in this shard
+     */
+    SMCShardSST(const sst::SSTParams& parameters, uint64_t slot_size, uint32_t num_shard_senders)
+            : sst::SST<SMCShardSST>(this, parameters),
+              slots(slot_size),
+              num_received_sst(num_shard_senders, sst::FieldAccess::HOT),
+              index(1, sst::FieldAccess::HOT) {
+        SSTInit(slots, num_received_sst, index);
+        for(unsigned int row = 0; row < get_num_rows(); ++row) {
+            for(size_t i = 0; i < num_received_sst.size(); ++i) {
+                num_received_sst[row][i] = -1;
+            }
+            index[row][0] = -1;
+        }
+    }
+};
+
 namespace gmssst {
 
 /**
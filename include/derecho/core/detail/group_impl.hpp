@@ -199,6 +199,11 @@ Group<ReplicatedTypes...>::Group(const UserMessageCallbacks& callbacks,
             //Verification callback
             [this](subgroup_id_t subgroup, persistent::version_t version) {
                 rpc_manager.notify_verification_finished(subgroup, version);
+            },
+            //Batched RPC message handler
+            [this](subgroup_id_t subgroup, const std::vector<rpc_message_t>& messages,
+                   const std::function<void(std::size_t)>& message_delivered) {
+                rpc_manager.rpc_batch_handler(subgroup, messages, message_delivered);
             }};
     view_manager.initialize_multicast_groups(callbacks, internal_callbacks);
     rpc_manager.create_connections();
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <derecho/rdmc/rdmc.hpp>
+
+namespace derecho {
+
+/**
+ * The type of the function called to hand a buffer lent to
+ * MulticastGroup::send_registered back to the application.
+ */
+using registered_buffer_callback_t = std::function<void(char* buffer)>;
+
+/**
+ * Represents a block of memory used to store a message: a range of bytes in
+ * an RDMA memory region, which is usually shared with other MessageBuffers.
+ * The bytes either come from a MessageBufferPool or, for a message sent with
+ * MulticastGroup::send_registered, are lent by the application.
+ * This is a move-only type, since a buffer has only one user at a time.
+ */
+struct MessageBuffer {
+    /** The registered memory region that holds the buffer */
+    std::shared_ptr<rdma::memory_region> mr;
+    /** The start of the buffer, within mr */
+    char* buffer = nullptr;
+    /** The size of the buffer, in bytes */
+    std::size_t size = 0;
+    /** Hands the buffer back to the application if it lent the buffer; empty otherwise */
+    registered_buffer_callback_t release_callback;
+
+    MessageBuffer() {}
+    MessageBuffer(std::shared_ptr<rdma::memory_region> mr, char* buffer, std::size_t size,
+                  const registered_buffer_callback_t& release_callback = nullptr)
+            : mr(std::move(mr)), buffer(buffer), size(size), release_callback(release_callback) {}
+    MessageBuffer(const MessageBuffer&) = delete;
+    MessageBuffer(MessageBuffer&&) = default;
+    MessageBuffer& operator=(const MessageBuffer&) = delete;
+    MessageBuffer& operator=(MessageBuffer&&) = default;
+
+    /** The start of the message's bytes */
+    char* data() const {
+        return buffer;
+    }
+    /** The offset of the message's bytes within mr */
+    std::size_t offset() const {
+        return buffer - mr->buffer;
+    }
+    /** True if the application lent this buffer */
+    bool is_lent() const {
+        return static_cast<bool>(release_callback);
+    }
+};
+
+/**
+ * Hands out MessageBuffers sized to the messages they will hold, instead of
+ * one maximum-size buffer (and registration) per message. Buffers come in
+ * power-of-two size classes from min_buffer_size up; each class is carved out
+ * of slabs of slab_size bytes, each registered as one memory region, and a
+ * class bigger than a slab gets a region of its own per buffer. reserve()
+ * registers a slab for each size class a view can use, and further slabs are
+ * registered when a class runs out and kept for reuse, up to a limit on the
+ * registered memory. So the registered memory follows the largest amount in
+ * use at once rather than the configured maximum message size.
+ * Thread-safe, since all the subgroups of a MulticastGroup share one pool.
+ * Memory is registered without holding the pool's lock.
+ */
+class MessageBufferPool {
+    /** The size of the smallest size class, in bytes */
+    const std::size_t min_buffer_size;
+    /** The size of each slab, in bytes (DERECHO/message_buffer_slab_size) */
+    const std::size_t slab_size;
+    /** The free buffers of each size class, indexed by size class */
+    std::vector<std::vector<MessageBuffer>> free_buffers;
+    std::size_t num_slabs = 0;
+    /** The bytes registered for slabs, including the ones being registered */
+    std::size_t registered_bytes = 0;
+    /** The most bytes that allocate registers unless told to go over */
+    std::size_t max_registered_bytes;
+    /** Guards all of the above */
+    mutable std::mutex pool_mutex;
+
+    /** Returns true if the size class has a free buffer. pool_mutex must be held. */
+    bool has_free_buffer(uint32_t size_class) const;
+    /**
+     * Registers a new slab for a size class and adds its buffers to the
+     * class's free list, unless that would take the registered memory over
+     * max_registered_bytes and allow_over_limit is false.
+     * @return True if it registered the slab
+     */
+    bool add_slab(uint32_t size_class, bool allow_over_limit);
+
+public:
+    static constexpr std::size_t default_min_buffer_size = 4096;
+
+    MessageBufferPool(std::size_t slab_size, std::size_t max_registered_bytes,
+                      std::size_t min_buffer_size = default_min_buffer_size);
+
+    /** Changes the limit on the registered memory, which takes effect the next time a slab is needed. */
+    void set_max_registered_bytes(std::size_t max_bytes);
+    /**
+     * Registers a slab for the size class if it has no free buffer and the
+     * limit allows, so that the class's first message does not wait for a
+     * registration.
+     * @return False if the class has no free buffer and the limit does not allow a slab
+     */
+    bool reserve(uint32_t size_class);
+    /**
+     * Returns a buffer of at least size bytes, registering another slab if
+     * there is no free one. If that would take the registered memory over the
+     * limit, returns an empty MessageBuffer (with a null mr) instead, unless
+     * allow_over_limit is true; that is for buffers that cannot wait, such as
+     * one for an incoming message.
+     */
+    MessageBuffer allocate(std::size_t size, bool allow_over_limit = false);
+    /** Returns a buffer that came from allocate to the pool. */
+    void release(MessageBuffer&& message_buffer);
+
+    /** The number of bytes of memory registered for the pool's slabs so far. */
+    std::size_t get_registered_bytes() const {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        return registered_bytes;
+    }
+    /** The number of slabs registered so far. */
+    std::size_t get_num_slabs() const {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        return num_slabs;
+    }
+    /** The number of free buffers in each size class, indexed by size class. */
+    std::vector<std::size_t> get_num_free_buffers() const;
+    /** Returns the smallest size class that holds buffers of at least size bytes. */
+    uint32_t get_size_class(std::size_t size) const;
+    /** The size of the buffers in the given size class, in bytes. */
+    std::size_t get_buffer_size(uint32_t size_class) const {
+        return min_buffer_size << size_class;
+    }
+    /** The size of the memory regions that the given size class is carved out of, in bytes. */
+    std::size_t get_slab_size(uint32_t size_class) const {
+        return std::max(slab_size, get_buffer_size(size_class));
+    }
+};
+
+}  // namespace derecho
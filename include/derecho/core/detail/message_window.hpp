@@ -0,0 +1,171 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "derecho_internal.hpp"
+
+namespace derecho {
+
+/**
+ * Holds a subgroup's messages by message (or sequence) number, in a ring
+ * buffer indexed by the number modulo its capacity, instead of a tree of
+ * separately allocated nodes. The numbers held at once must fit in a span of
+ * the capacity, as they do for the messages of one subgroup's window: once
+ * the capacity is reserved, adding, finding and removing a message allocates
+ * nothing and takes constant time. If a number falls outside the span
+ * anyway, the ring doubles until it fits, so the capacity is a hint rather
+ * than a limit.
+ * Like the std::map it replaces, it keeps its messages in order of number;
+ * the lowest is always at front().
+ */
+template <typename T>
+class MessageWindow {
+    /** The slots of the ring; the size is always 0 or a power of two */
+    std::vector<std::optional<T>> slots;
+    /** The lowest and highest numbers held; only meaningful if count > 0 */
+    message_id_t first_id = 0;
+    message_id_t last_id = 0;
+    std::size_t count = 0;
+
+    std::optional<T>& slot(message_id_t id) {
+        return slots[static_cast<std::size_t>(id) & (slots.size() - 1)];
+    }
+    const std::optional<T>& slot(message_id_t id) const {
+        return slots[static_cast<std::size_t>(id) & (slots.size() - 1)];
+    }
+
+public:
+    MessageWindow() {}
+    explicit MessageWindow(std::size_t capacity) {
+        reserve(capacity);
+    }
+
+    /** Makes room for messages whose numbers span up to capacity, keeping the ones held. */
+    void reserve(std::size_t capacity) {
+        std::size_t new_size = 1;
+        while(new_size < capacity) {
+            new_size <<= 1;
+        }
+        if(new_size <= slots.size()) {
+            return;
+        }
+        std::vector<std::optional<T>> new_slots(new_size);
+        if(count > 0) {
+            for(message_id_t id = first_id; id <= last_id; ++id) {
+                if(slot(id)) {
+                    new_slots[static_cast<std::size_t>(id) & (new_size - 1)] = std::move(slot(id));
+                }
+            }
+        }
+        slots = std::move(new_slots);
+    }
+
+    bool empty() const {
+        return count == 0;
+    }
+    std::size_t size() const {
+        return count;
+    }
+    std::size_t capacity() const {
+        return slots.size();
+    }
+
+    /** The lowest number held. The window must not be empty. */
+    message_id_t front_id() const {
+        assert(count > 0);
+        return first_id;
+    }
+    /** The message with the lowest number. The window must not be empty. */
+    T& front() {
+        assert(count > 0);
+        return *slot(first_id);
+    }
+
+    /** Returns the message with the given number, or nullptr if there is none. */
+    T* find(message_id_t id) {
+        if(count == 0 || id < first_id || id > last_id || !slot(id)) {
+            return nullptr;
+        }
+        return &*slot(id);
+    }
+
+    /** Stores a message under the given number, replacing any message already there. */
+    template <typename... Args>
+    T& emplace(message_id_t id, Args&&... args) {
+        if(count == 0) {
+            reserve(1);
+            first_id = id;
+            last_id = id;
+        } else {
+            const message_id_t new_first_id = std::min(first_id, id);
+            const message_id_t new_last_id = std::max(last_id, id);
+            if(static_cast<std::size_t>(new_last_id - new_first_id) >= slots.size()) {
+                reserve(2 * slots.size() > static_cast<std::size_t>(new_last_id - new_first_id)
+                                ? 2 * slots.size()
+                                : static_cast<std::size_t>(new_last_id - new_first_id) + 1);
+            }
+            first_id = new_first_id;
+            last_id = new_last_id;
+        }
+        std::optional<T>& entry = slot(id);
+        if(!entry) {
+            ++count;
+        }
+        entry.emplace(std::forward<Args>(args)...);
+        return *entry;
+    }
+
+    /** Removes the message with the given number, if there is one. */
+    void erase(message_id_t id) {
+        if(!find(id)) {
+            return;
+        }
+        slot(id).reset();
+        if(--count == 0) {
+            return;
+        }
+        if(id == first_id) {
+            while(!slot(first_id)) {
+                ++first_id;
+            }
+        } else if(id == last_id) {
+            while(!slot(last_id)) {
+                --last_id;
+            }
+        }
+    }
+    /** Removes the message with the lowest number. The window must not be empty. */
+    void pop_front() {
+        erase(front_id());
+    }
+
+    /** Removes every message, keeping the capacity. */
+    void clear() {
+        if(count > 0) {
+            for(message_id_t id = first_id; id <= last_id; ++id) {
+                slot(id).reset();
+            }
+        }
+        count = 0;
+    }
+
+    /** Calls f(number, message) on every message, in order of number. */
+    template <typename Function>
+    void for_each(Function&& f) {
+        if(count == 0) {
+            return;
+        }
+        for(message_id_t id = first_id; id <= last_id; ++id) {
+            if(slot(id)) {
+                f(id, *slot(id));
+            }
+        }
+    }
+};
+
+}  // namespace derecho
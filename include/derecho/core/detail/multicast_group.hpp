@@ -1,7 +1,10 @@
 #pragma once
 
+#include <algorithm>
 #include <assert.h>
+#include <atomic>
 #include <condition_variable>
+#include <deque>
 #include <functional>
 #include <list>
 #include <map>
@@ -19,7 +22,10 @@
 #include "connection_manager.hpp"
 #include "derecho_internal.hpp"
 #include "derecho_sst.hpp"
+#include "message_buffer_pool.hpp"
+#include "message_window.hpp"
 #include "persistence_manager.hpp"
+#include "spsc_queue.hpp"
 #include <derecho/conf/conf.hpp>
 #include <derecho/mutils-serialization/SerializationMacros.hpp>
 #include <derecho/mutils-serialization/SerializationSupport.hpp>
@@ -42,6 +48,23 @@ struct __attribute__((__packed__)) header {
     bool cooked_send;
 };
 
+/**
+ * The number of bytes at the start of a buffer passed to
+ * MulticastGroup::send_registered that Derecho reserves for the message's
+ * header; the payload follows them.
+ */
+constexpr std::size_t registered_send_header_size = sizeof(header);
+
+/**
+ * Precedes each message in an SST multicast slot when small messages are
+ * packed several to a slot (DERECHO/smc_packing). A size of 0 marks the end
+ * of the messages in a slot that they do not fill.
+ */
+struct __attribute__((__packed__)) packed_message_header {
+    /** The size of the message that follows, including its header */
+    uint32_t size;
+};
+
 /**
  * Bundles together a set of low-level parameters for configuring Derecho
  * subgroups and shards, mostly related to the way multicast messages are sent.
@@ -54,7 +77,11 @@ struct DerechoParams : public mutils::ByteRepresentable {
     uint64_t max_msg_size;
     /** The maximum size (in bytes) of a message sent in reply to an ordered_send RPC message. */
     uint64_t max_reply_msg_size;
-    /** The maximum size (in bytes) of an SST Multicast message. */
+    /**
+     * The maximum size (in bytes) of an SST Multicast message, which is also
+     * the usable size of an SMC slot; with SMC packing this includes room for one
+     * packed_message_header.
+     */
     uint64_t sst_max_msg_size;
     /** The size of a single block for RDMC. */
     uint64_t block_size;
@@ -65,7 +92,7 @@ struct DerechoParams : public mutils::ByteRepresentable {
     unsigned int window_size;
     /** The number of milliseconds between heartbeat messages sent to detect failures. */
     unsigned int heartbeat_ms;
-    /** The algorithm to use for RDMC (binomial, chain, sequential, or tree). */
+    /** The algorithm to use for RDMC (binomial, chain, sequential, tree, or hybrid). */
     rdmc::send_algorithm rdmc_send_algorithm;
     /** The TCP port to use when transferring state to new members. */
     uint32_t state_transfer_port;
@@ -92,6 +119,8 @@ struct DerechoParams : public mutils::ByteRepresentable {
             return rdmc::send_algorithm::SEQUENTIAL_SEND;
         } else if(rdmc_send_algorithm_string == "tree_send") {
             return rdmc::send_algorithm::TREE_SEND;
+        } else if(rdmc_send_algorithm_string == "hybrid_send") {
+            return rdmc::send_algorithm::HYBRID_SEND;
         } else {
             throw "wrong value for RDMC send algorithm: " + rdmc_send_algorithm_string + ". Check your config file.";
         }
@@ -106,7 +135,10 @@ struct DerechoParams : public mutils::ByteRepresentable {
                   rdmc::send_algorithm rdmc_send_algorithm,
                   uint32_t state_transfer_port)
             : max_reply_msg_size(max_reply_payload_size + sizeof(header)),
-              sst_max_msg_size(max_smc_payload_size + sizeof(header)),
+              sst_max_msg_size(max_smc_payload_size + sizeof(header)
+                               + (getConfBoolean(CONF_DERECHO_SMC_PACKING) && !getConfUInt64(CONF_DERECHO_SMC_RING_SIZE)
+                                          ? sizeof(packed_message_header)
+                                          : 0)),
               block_size(block_size),
               window_size(window_size),
               heartbeat_ms(heartbeat_ms),
@@ -119,6 +151,16 @@ struct DerechoParams : public mutils::ByteRepresentable {
 
     DerechoParams() {}
 
+    /**
+     * The number of bytes of each member's row of the SMC slots column that a
+     * subgroup with these parameters uses: window_size slots, or a byte ring
+     * of DERECHO/smc_ring_size bytes if that is set.
+     */
+    uint64_t smc_region_size() const {
+        const uint64_t ring_size = getConfUInt64(CONF_DERECHO_SMC_RING_SIZE);
+        return ring_size ? ring_size : window_size * (sst_max_msg_size + sizeof(uint64_t));
+    }
+
     /**
      * Constructs DerechoParams specifying subgroup metadata for specified profile.
      * @param profile Name of profile in the configuration file to use.
@@ -164,29 +206,6 @@ struct DerechoParams : public mutils::ByteRepresentable {
                                   heartbeat_ms, rdmc_send_algorithm, state_transfer_port);
 };
 
-/**
- * Represents a block of memory used to store a message. This object contains
- * both the array of bytes in which the message is stored and the corresponding
- * RDMA memory region (which has registered that array of bytes as its buffer).
- * This is a move-only type, since memory regions can't be copied.
- */
-struct MessageBuffer {
-    std::unique_ptr<char[]> buffer;
-    std::shared_ptr<rdma::memory_region> mr;
-
-    MessageBuffer() {}
-    MessageBuffer(size_t size) {
-        if(size != 0) {
-            buffer = std::unique_ptr<char[]>(new char[size]);
-            mr = std::make_shared<rdma::memory_region>(buffer.get(), size);
-        }
-    }
-    MessageBuffer(const MessageBuffer&) = delete;
-    MessageBuffer(MessageBuffer&&) = default;
-    MessageBuffer& operator=(const MessageBuffer&) = delete;
-    MessageBuffer& operator=(MessageBuffer&&) = default;
-};
-
 /**
  * A structure containing an RDMC message (which consists of some bytes in a
  * registered memory region) and some associated metadata. Note that the
@@ -236,9 +255,15 @@ struct SubgroupSettings {
     int sender_rank;
     /** The offset of this node's num_received counter within the subgroup's SST section */
     uint32_t num_received_offset;
-    /** The offset of this node's slot within the subgroup's SST section */
+    /**
+     * The offset of this node's slot within the subgroup's SST section
+     * (always 0 when the shard's SMC columns are in their own SMCShardSST)
+     */
     uint32_t slot_offset;
-    /** The index of the SST index used to track SMC messages in a specific subgroup */
+    /**
+     * The index of the SST index used to track SMC messages in a specific subgroup
+     * (always 0 when the shard's SMC columns are in their own SMCShardSST)
+     */
     uint32_t index_offset;
     /** The operation mode of the shard */
     Mode mode;
@@ -271,6 +296,12 @@ struct MulticastGroupCallbacks {
      * verification callback in UserMessageCallbacks).
      */
     verified_callback_t global_verified_callback;
+    /**
+     * A function to be called with a batch of multicast RPC messages that
+     * became stable together, used instead of rpc_callback for ordered
+     * deliveries if DERECHO/batched_rpc_delivery is set.
+     */
+    rpc_batch_handler_t rpc_batch_callback;
 };
 
 /** Implements the low-level mechanics of tracking multicasts in a Derecho group,
@@ -285,6 +316,13 @@ private:
     std::vector<node_id_t> members;
     /** inverse map of node_ids to sst_row */
     std::map<node_id_t, uint32_t> node_id_to_sst_index;
+    /**
+     * For each subgroup this node belongs to, the SST rows of the members of
+     * its shard, in shard rank order, indexed by subgroup number (empty for
+     * the other subgroups). Computed once at construction, so that triggers
+     * and predicates that reduce over the shard need no lookups.
+     */
+    std::vector<std::vector<uint32_t>> shard_sst_indices_by_subgroup;
     /**  number of members */
     const unsigned int num_members;
     /** index of the local node in the members vector, which should also be its row index in the SST */
@@ -299,16 +337,33 @@ private:
     const std::map<subgroup_id_t, SubgroupSettings> subgroup_settings_map;
     /** Used for synchronizing receives by RDMC and SST */
     std::vector<std::list<int32_t>> received_intervals;
-    /** Maps subgroup IDs for which this node is a sender to the RDMC group it should use to send.
+    /** Maps subgroup IDs for which this node is a sender to the first of the RDMC groups it should use to send.
+     * Message index i is sent in group (first + i % get_num_rdmc_lanes(subgroup)).
      * Constructed incrementally in create_rdmc_sst_groups(), so it can't be const.  */
     std::map<subgroup_id_t, uint32_t> subgroup_to_rdmc_group;
     /** Offset to add to member ranks to form RDMC group numbers. */
     uint16_t rdmc_group_num_offset;
+    /** The number of RDMC messages each sender can have in flight at once in a subgroup (DERECHO/rdmc_max_in_flight). */
+    const uint32_t rdmc_max_in_flight;
     /** false if RDMC groups haven't been created successfully */
     bool rdmc_sst_groups_created = false;
-    /** Stores message buffers not currently in use. Protected by
-     * msg_state_mtx */
-    std::map<uint32_t, std::vector<MessageBuffer>> free_message_buffers;
+    /** Supplies the message buffers for RDMC messages, shared by all the subgroups.
+     * Handed over to the next view's MulticastGroup. Thread-safe. */
+    std::unique_ptr<MessageBufferPool> buffer_pool;
+    /**
+     * Memory regions registered for buffers lent by send_registered, by the
+     * address of their first byte, along with when each was last used, so
+     * that a buffer sent again is not registered again. Holds at most
+     * max_registered_send_buffers regions, evicting the least recently used.
+     * Protected by registration_cache_mtx, not msg_state_mtxs, since
+     * registering a large buffer is slow.
+     */
+    std::map<char*, std::pair<std::shared_ptr<rdma::memory_region>, uint64_t>> registered_send_buffers;
+    /** The number of uses of registered_send_buffers so far, which orders its entries by last use */
+    uint64_t registration_cache_clock = 0;
+    /** The most memory regions registered_send_buffers keeps (DERECHO/max_registered_send_buffers). */
+    const uint32_t max_registered_send_buffers;
+    std::mutex registration_cache_mtx;
 
     /** Index to be used the next time get_sendbuffer_ptr is called.
      * When next_message is not none, then next_message.index = future_message_index-1 */
@@ -317,35 +372,107 @@ private:
     /** next_message is the message that will be sent when send is called the next time.
      * It is std::nullopt when there is no message to send. */
     std::vector<std::optional<RDMCMessage>> next_sends;
-    std::map<uint32_t, bool> pending_sst_sends;
+    /** The last SMC slot (or ring entry) number, per subgroup, whose messages have all been written. */
     std::vector<uint32_t> committed_sst_index;
+    /** The last SMC slot (or ring entry) number, per subgroup, that will not get any more messages. */
+    std::vector<uint32_t> closed_sst_index;
     std::vector<uint32_t> num_nulls_queued;
     std::vector<int32_t> first_null_index;
+    /**
+     * For each subgroup, the number of messages still being written into each
+     * SMC slot (or ring entry) that has been taken but not committed, indexed
+     * by slot number modulo smc_num_positions. Senders write their messages
+     * without holding the subgroup's lock and decrement the count when they are
+     * done; sst_send_trigger then commits closed slots in order as their
+     * counts reach 0.
+     */
+    std::vector<std::unique_ptr<std::atomic<uint32_t>[]>> smc_unfinished_writes;
+    /** The size of each subgroup's smc_unfinished_writes, more than the number of slots that can be taken but not committed. */
+    std::vector<uint32_t> smc_num_positions;
+    /** The SMC slot number of the message most recently returned by get_sendbuffer_ptr, for each subgroup. */
+    std::vector<uint32_t> last_sst_send_position;
+    /** True if small SMC messages are packed several to a slot (DERECHO/smc_packing). */
+    const bool smc_packing;
+    /** The SMC slot that a subgroup's messages are currently being packed into. */
+    struct OpenSMCSlot {
+        /** The slot, or nullptr if no slot is open */
+        char* buf = nullptr;
+        /** The number of bytes of the slot used so far, sub-headers included */
+        uint64_t used = 0;
+    };
+    /** The open SMC slot of each subgroup, indexed by subgroup number; only used if smc_packing. */
+    std::vector<OpenSMCSlot> open_smc_slots;
+    /** The number of SMC slots this node has taken in each subgroup; only used if smc_packing. */
+    std::vector<uint64_t> smc_slots_taken;
+    /**
+     * For each subgroup and SMC slot position, the index of the last message
+     * in the slot most recently taken at that position, or -1; only used if
+     * smc_packing. A position can be taken again once every member is done
+     * with that message.
+     */
+    std::vector<std::vector<message_id_t>> smc_slot_last_message;
+    /** The size of each sender's SMC byte ring, or 0 if SMC uses fixed slots (DERECHO/smc_ring_size). */
+    const uint64_t smc_ring_size;
+    /**
+     * For each subgroup, the index of the message in each of this node's SMC
+     * ring entries that has not been released yet, oldest first; only used
+     * if smc_ring_size is set.
+     */
+    std::vector<std::deque<message_id_t>> smc_ring_entry_messages;
+    /**
+     * For each subgroup and sender rank, the ring position of the next SMC
+     * entry to receive; only used if smc_ring_size is set.
+     */
+    std::vector<std::vector<uint64_t>> smc_ring_read_positions;
+    /**
+     * What send_loop needs in order to decide whether this node's next RDMC
+     * message in a subgroup can go out, copied out of SubgroupSettings once
+     * at construction so that the check allocates nothing and looks nothing
+     * up in a map.
+     */
+    struct SendReadiness {
+        /** False if this node does not send in the subgroup, or is not a member of it */
+        bool is_sender = false;
+        bool ordered = true;
+        uint32_t num_shard_senders = 0;
+        int32_t sender_rank = -1;
+        /** The column of num_received that counts this node's messages in the subgroup */
+        uint32_t num_received_column = 0;
+        int32_t num_rdmc_lanes = 0;
+        int32_t window_size = 0;
+        /** The SST rows of the shard's members */
+        std::vector<uint32_t> shard_sst_indices;
+    };
+    /** The SendReadiness of each subgroup, indexed by subgroup number */
+    std::vector<SendReadiness> send_readiness;
     /** Messages that are ready to be sent, but must wait until the current send finishes. */
     std::vector<std::queue<RDMCMessage>> pending_sends;
-    /** Vector of messages that are currently being sent out using RDMC, or boost::none otherwise. */
-    /** one per subgroup */
-    std::vector<std::optional<RDMCMessage>> current_sends;
+    /** Messages that are currently being sent out using RDMC, by message index; one window per subgroup */
+    std::vector<MessageWindow<RDMCMessage>> current_sends;
 
-    /** Messages that are currently being received. */
-    std::map<std::pair<subgroup_id_t, node_id_t>, RDMCMessage> current_receives;
+    /**
+     * Messages that are currently being received, one per RDMC group, indexed
+     * by subgroup number and then by sender rank * number of lanes + lane. An
+     * entry with no message buffer is not receiving anything.
+     */
+    std::vector<std::vector<RDMCMessage>> current_receives;
     /** Receiver lambdas for shards that have only one member. */
     std::map<subgroup_id_t, std::function<void(char*, size_t)>> singleton_shard_receive_handlers;
 
     /** Messages that have finished sending/receiving but aren't yet globally stable.
      * Organized by [subgroup number] -> [sequence number] -> [message] */
-    std::map<subgroup_id_t, std::map<message_id_t, RDMCMessage>> locally_stable_rdmc_messages;
-    /** Same map as locally_stable_rdmc_messages, but for SST messages */
-    std::map<subgroup_id_t, std::map<message_id_t, SSTMessage>> locally_stable_sst_messages;
+    std::vector<MessageWindow<RDMCMessage>> locally_stable_rdmc_messages;
+    /** Same as locally_stable_rdmc_messages, but for SST messages */
+    std::vector<MessageWindow<SSTMessage>> locally_stable_sst_messages;
     /** For each subgroup, the set of timestamps associated with currently-pending
      * (not yet delivered) messages. Used to compute the stability frontier. */
-    std::map<subgroup_id_t, std::set<uint64_t>> pending_message_timestamps;
+    std::vector<std::set<uint64_t>> pending_message_timestamps;
     /** Tracks the timestamps of messages that are currently being written to persistent storage */
-    std::map<subgroup_id_t, std::map<message_id_t, uint64_t>> pending_persistence;
+    std::vector<MessageWindow<uint64_t>> pending_persistence;
     /** Messages that are currently being written to persistent storage */
-    std::map<subgroup_id_t, std::map<message_id_t, RDMCMessage>> non_persistent_messages;
+    std::vector<MessageWindow<RDMCMessage>> non_persistent_messages;
     /** Messages that are currently being written to persistent storage */
-    std::map<subgroup_id_t, std::map<message_id_t, SSTMessage>> non_persistent_sst_messages;
+    std::vector<MessageWindow<SSTMessage>> non_persistent_sst_messages;
 
     /** The next message ID that can be delivered in each subgroup, indexed by subgroup number. */
     std::vector<message_id_t> next_message_to_deliver;
@@ -361,8 +488,22 @@ private:
      */
     std::vector<persistent::version_t> minimum_verified_version;
 
-    std::recursive_mutex msg_state_mtx;
-    std::condition_variable_any sender_cv;
+    /**
+     * Guards the message state of each subgroup, indexed by subgroup number:
+     * the entries for that subgroup in the vectors above, and its SST
+     * counters. Each subgroup has its own lock so that the threads sending
+     * and delivering in one subgroup do not hold up the others; only
+     * operations on the whole group, like a view change, take them all, in
+     * subgroup order. Delivery upcalls run without it, so that an upcall in
+     * one subgroup can send in another while an upcall there sends in the
+     * first; a thread never holds two of these locks except in subgroup order.
+     */
+    std::unique_ptr<std::recursive_mutex[]> msg_state_mtxs;
+    /** Guards sender_woken; never held while taking a lock in msg_state_mtxs. */
+    std::mutex sender_mtx;
+    std::condition_variable sender_cv;
+    /** Set when a subgroup may have an RDMC message ready to send, to wake send_loop */
+    bool sender_woken = true;
 
     /** The time, in milliseconds, that a sender can wait to send a message before it is considered failed. */
     unsigned int sender_timeout;
@@ -378,7 +519,34 @@ private:
     std::shared_ptr<DerechoSST> sst;
 
     /** The SSTs for multicasts **/
-    std::vector<std::unique_ptr<sst::multicast_group<DerechoSST>>> sst_multicast_group_ptrs;
+    std::vector<std::unique_ptr<sst::multicast_group_base>> sst_multicast_group_ptrs;
+
+    /**
+     * Locates one subgroup's SMC columns, which are either ranges of the
+     * shared DerechoSST's columns or the whole columns of the shard's own
+     * SMCShardSST.
+     */
+    struct SMCColumns {
+        SSTFieldVector<char>* slots = nullptr;
+        SSTFieldVector<int32_t>* num_received_sst = nullptr;
+        SSTFieldVector<int32_t>* index = nullptr;
+        uint32_t slot_offset = 0;
+        uint32_t num_received_offset = 0;
+        uint32_t index_offset = 0;
+        /** The row of each shard member in the SST that holds the columns, indexed by shard rank */
+        std::vector<uint32_t> rows;
+        /** The local node's row in the SST that holds the columns */
+        uint32_t my_row = 0;
+    };
+    /** True if each shard's SMC columns live in a separate SMCShardSST (DERECHO/sst_per_shard_smc). */
+    const bool per_shard_smc;
+    /** The SMC columns of each subgroup this node belongs to, indexed by subgroup number. */
+    std::vector<SMCColumns> smc_columns;
+    /**
+     * If per_shard_smc is true, the SMCShardSST of each subgroup this node
+     * belongs to, indexed by subgroup number; otherwise empty pointers.
+     */
+    std::vector<std::shared_ptr<SMCShardSST>> smc_shard_ssts;
 
     using pred_handle = typename sst::Predicates<DerechoSST>::pred_handle;
     std::list<pred_handle> receiver_pred_handles;
@@ -387,7 +555,62 @@ private:
     std::list<pred_handle> persistence_pred_handles;
     std::list<pred_handle> sender_pred_handles;
 
-    std::vector<bool> last_transfer_medium;
+    /** Whether each subgroup's last message went by RDMC; not std::vector<bool>, whose elements share bytes across subgroups */
+    std::vector<char> last_transfer_medium;
+
+    /**
+     * If true, delivery_trigger hands consecutive stable RPC messages to
+     * internal_callbacks.rpc_batch_callback together instead of calling
+     * rpc_callback for each one (DERECHO/batched_rpc_delivery).
+     */
+    const bool batched_rpc_delivery;
+    /**
+     * A stable message that has been taken out of the locally stable
+     * messages, so that it can be delivered without the subgroup's lock: right
+     * away, in an RPC batch, or on the subgroup's delivery thread.
+     */
+    struct StableMessage {
+        message_id_t seq_num;
+        persistent::version_t version;
+        /** The timestamp from the message header, in nanoseconds */
+        uint64_t msg_timestamp;
+        /** True if the message is in rdmc_message, false if it is in sst_message */
+        bool is_rdmc;
+        RDMCMessage rdmc_message;
+        SSTMessage sst_message;
+    };
+    /**
+     * For each subgroup, the messages collected for the next batch, in
+     * delivery order, and the batch as handed to rpc_batch_callback. Both are
+     * reused from batch to batch, so they stop allocating once they are big enough.
+     */
+    std::vector<std::vector<StableMessage>> rpc_batch_messages;
+    std::vector<std::vector<rpc_message_t>> rpc_batches;
+
+    /**
+     * Delivers one ordered subgroup's stable messages on a thread of its own
+     * (DERECHO/delivery_threads), so that slow upcalls do not hold up the
+     * predicate thread. delivery_trigger is the queue's only producer and
+     * delivery_loop its only consumer.
+     */
+    struct DeliveryWorker {
+        /** Holds at most a window of each sender's messages, like the locally stable messages */
+        SPSCQueue<StableMessage> queue;
+        /** Guards shutdown, and lets the thread sleep while the queue is empty */
+        std::mutex mtx;
+        std::condition_variable cv;
+        /**
+         * Set by wedge to make the thread exit once the queue is empty.
+         * Only written with the subgroup's lock in msg_state_mtxs held as
+         * well, so delivery_trigger can read it under that lock.
+         */
+        bool shutdown = false;
+        std::thread thread;
+
+        explicit DeliveryWorker(std::size_t capacity) : queue(capacity) {}
+    };
+    /** The DeliveryWorker of each subgroup, indexed by subgroup number; empty pointers unless delivery threads are enabled */
+    std::vector<std::unique_ptr<DeliveryWorker>> delivery_workers;
 
 
     /** A reference to the PersistenceManager that lives in Group, used to
@@ -397,13 +620,50 @@ private:
     /** Continuously waits for a new pending send, then sends it. This function
      * implements the sender thread. */
     void send_loop();
+    /** Tells send_loop that a subgroup may have an RDMC message ready to send. */
+    void wake_sender();
+
+    /** Waits for stable messages in a subgroup's DeliveryWorker queue and
+     * delivers them, until wedge stops it. This function implements the
+     * subgroup's delivery thread. */
+    void delivery_loop(subgroup_id_t subgroup_num);
+    /** Moves a subgroup's stable messages, in order, to its DeliveryWorker queue. */
+    void queue_stable_messages(subgroup_id_t subgroup_num, DerechoSST& sst);
+    /**
+     * Takes the next message to deliver in a subgroup out of the locally
+     * stable messages, if its sequence number is at most min_stable_num.
+     * The subgroup's lock in msg_state_mtxs must be held.
+     * @return true if a message was put in stable
+     */
+    bool take_stable_message(subgroup_id_t subgroup_num, message_id_t min_stable_num, StableMessage& stable);
+    /**
+     * Delivers a message taken out of the locally stable messages, or adds it
+     * to the subgroup's RPC batch, then versions it and advances delivered_num.
+     * The subgroup's lock in msg_state_mtxs must not be held; it is taken only
+     * to version the message, not while the upcalls run.
+     * @return true if the message was not a null message
+     */
+    bool deliver_stable_message(subgroup_id_t subgroup_num, StableMessage& stable);
 
     /** Checks for failures when a sender reaches its timeout. This function
      * implements the timeout thread. */
     void check_failures_loop();
 
     bool create_rdmc_sst_groups();
+    /**
+     * Fills in smc_columns, first constructing the per-shard SMC SSTs if
+     * per_shard_smc is enabled. Every member constructs its shard SSTs in
+     * subgroup-number order, so pairs of members set up their connections in
+     * the same order.
+     * @param already_failed The failed flags of the top-level group's members
+     */
+    void initialize_smc_columns(const std::vector<char>& already_failed);
     void initialize_sst_row();
+    /**
+     * Returns the SST predicate partition (and hence the predicate evaluation
+     * thread) that handles the given subgroup's predicates.
+     */
+    uint32_t predicate_partition_for(subgroup_id_t subgroup_num) const;
     void register_predicates();
 
     /**
@@ -434,26 +694,38 @@ private:
      * @param msg The message that should cause a new version to be registered
      * with PersistenceManager
      * @param subgroup_num The ID of the subgroup this message is in
+     * @param seq_num The message's sequence number in the subgroup
      * @param version The version assigned to the message
      * @param msg_ts The timestamp of this message
      * @return true if a new version was created
      * false if the message is a null message
      */
-    bool version_message(RDMCMessage& msg, const subgroup_id_t& subgroup_num,
+    bool version_message(RDMCMessage& msg, const subgroup_id_t& subgroup_num, message_id_t seq_num,
                          const persistent::version_t& version, const uint64_t& msg_timestamp);
     /**
      * Same as the other version_message, but for the SSTMessage type.
      * @param msg The message that should cause a new version to be registered
      * with PersistenceManager
      * @param subgroup_num The ID of the subgroup this message is in
+     * @param seq_num The message's sequence number in the subgroup
      * @param version The version assigned to the message
      * @param msg_ts The timestamp of this message
      * @return true if a new version was created
      * false if the message is a null message
      */
-    bool version_message(SSTMessage& msg, const subgroup_id_t& subgroup_num,
+    bool version_message(SSTMessage& msg, const subgroup_id_t& subgroup_num, message_id_t seq_num,
                          const persistent::version_t& version, const uint64_t& msg_timestamp);
 
+    /**
+     * Hands the ordered RPC messages collected in rpc_batch_messages for a
+     * subgroup to internal_callbacks.rpc_batch_callback, and finishes
+     * delivering each one (stability upcall, new version, buffer release and
+     * delivered_num) as soon as its RPC function has run. Does nothing if
+     * no messages are waiting. The subgroup's lock in msg_state_mtxs must not
+     * be held, since the RPC functions run in the calling thread.
+     */
+    void deliver_rpc_batch(subgroup_id_t subgroup_num);
+
     uint32_t get_num_senders(const std::vector<int>& shard_senders) {
         uint32_t num = 0;
         for(const auto i : shard_senders) {
@@ -464,23 +736,30 @@ private:
         return num;
     };
 
+    /**
+     * The number of RDMC groups each sender uses in a subgroup, which is also
+     * the number of RDMC messages it can have in flight at once: at most
+     * rdmc_max_in_flight and the subgroup's window size.
+     */
+    uint32_t get_num_rdmc_lanes(subgroup_id_t subgroup_num) const {
+        return std::min(rdmc_max_in_flight, subgroup_settings_map.at(subgroup_num).profile.window_size);
+    }
+
     int32_t resolve_num_received(int32_t index, uint32_t num_received_entry);
 
     /* Predicate functions for receiving and delivering messages, parameterized by subgroup.
      * register_predicates will create and bind one of these for each subgroup. */
 
-    void delivery_trigger(subgroup_id_t subgroup_num, const SubgroupSettings& subgroup_settings,
-                          const uint32_t num_shard_members, DerechoSST& sst);
+    void delivery_trigger(subgroup_id_t subgroup_num, const SubgroupSettings& subgroup_settings, DerechoSST& sst);
 
-    void sst_send_trigger(subgroup_id_t subgroup_num, const SubgroupSettings& subgroup_settings,
-                          const uint32_t num_shard_members, DerechoSST& sst);
+    void sst_send_trigger(subgroup_id_t subgroup_num, const SubgroupSettings& subgroup_settings, DerechoSST& sst);
 
     void sst_receive_handler(subgroup_id_t subgroup_num, const SubgroupSettings& subgroup_settings,
                              const std::map<uint32_t, uint32_t>& shard_ranks_by_sender_rank,
                              uint32_t num_shard_senders, uint32_t sender_rank,
                              volatile char* data, uint64_t size);
 
-    bool receiver_predicate(const SubgroupSettings& subgroup_settings,
+    bool receiver_predicate(subgroup_id_t subgroup_num, const SubgroupSettings& subgroup_settings,
                             const std::map<uint32_t, uint32_t>& shard_ranks_by_sender_rank,
                             uint32_t num_shard_senders, const DerechoSST& sst);
 
@@ -489,17 +768,61 @@ private:
                            uint32_t num_shard_senders, DerechoSST& sst,
                            const std::function<void(uint32_t, volatile char*, uint32_t)>& sst_receive_handler_lambda);
 
-    void update_min_persisted_num(subgroup_id_t subgroup_num, const SubgroupSettings& subgroup_settings,
-                                  uint32_t num_shard_members, DerechoSST& sst);
+    void update_min_persisted_num(subgroup_id_t subgroup_num, const SubgroupSettings& subgroup_settings, DerechoSST& sst);
 
-    void update_min_verified_num(subgroup_id_t subgroup_num, const SubgroupSettings& subgroup_settings,
-                                 uint32_t num_shard_members, DerechoSST& sst);
+    void update_min_verified_num(subgroup_id_t subgroup_num, const SubgroupSettings& subgroup_settings, DerechoSST& sst);
 
     // Internally used to automatically send a NULL message
     void get_buffer_and_send_auto_null(subgroup_id_t subgroup_num);
+    /**
+     * Reserves room for a message of msg_size bytes (header included) in the
+     * subgroup's open SMC slot, first opening a new slot if there is none or
+     * the message does not fit, and writes the message's packed_message_header.
+     * Only used if smc_packing; the subgroup's lock in msg_state_mtxs must be held.
+     * @return A pointer to where the message should be written, or nullptr
+     * if no slot is free yet.
+     */
+    char* get_packed_buffer(subgroup_id_t subgroup_num, uint64_t msg_size);
+    /**
+     * Returns a buffer for a message of msg_size bytes (header included) in
+     * the subgroup's SMC ring, after releasing the entries every member is
+     * done with, or nullptr if the ring is full. Only used if smc_ring_size
+     * is set; the subgroup's lock in msg_state_mtxs must be held.
+     */
+    char* get_ring_buffer(subgroup_id_t subgroup_num, uint64_t msg_size);
+    /**
+     * Returns the index of the last message this node sent in the subgroup
+     * that every shard member is done with, having delivered it (or, in
+     * unordered mode, received it), so that the SMC space holding it can be
+     * reused; -1 if there is none.
+     */
+    message_id_t last_released_message(subgroup_id_t subgroup_num);
+    /**
+     * Commits the subgroup's open SMC slot, if it has one, so that
+     * sst_send_trigger will send it. Only used if smc_packing;
+     * the subgroup's lock in msg_state_mtxs must be held.
+     */
+    void close_open_smc_slot(subgroup_id_t subgroup_num);
     /* Get a pointer into the current buffer, to write data into it before sending
-     * Now this is a private function, called by send internally */
-    char* get_sendbuffer_ptr(subgroup_id_t subgroup_num, long long unsigned int payload_size, bool cooked_send);
+     * Now this is a private function, called by send internally.
+     * If lent_buffer is not null, the message is sent by RDMC from it instead of
+     * from a buffer_pool buffer, and it is moved from if this succeeds. */
+    char* get_sendbuffer_ptr(subgroup_id_t subgroup_num, long long unsigned int payload_size, bool cooked_send,
+                             MessageBuffer* lent_buffer = nullptr);
+    /**
+     * Returns a message buffer to buffer_pool, or, if the application lent
+     * it, hands it back to the application.
+     */
+    void release_message_buffer(MessageBuffer&& message_buffer);
+    /**
+     * Sets buffer_pool's limit on registered memory for this view's subgroups
+     * (DERECHO/max_message_buffer_bytes) and registers a slab for each size
+     * class their RDMC messages can use, so that the RDMC receive callbacks
+     * seldom have to register memory.
+     */
+    void prepare_buffer_pool();
+    /** Returns a memory region covering the given bytes, from registered_send_buffers if it has one. */
+    std::shared_ptr<rdma::memory_region> get_registered_region(char* buffer, size_t size);
 
 public:
     /**
@@ -549,12 +872,36 @@ public:
 	The user function that generates the message is supplied to send */
     bool send(subgroup_id_t subgroup_num, long long unsigned int payload_size,
               const std::function<void(char* buf)>& msg_generator, bool cooked_send);
+    /**
+     * Sends a raw message that the application has already written into a
+     * buffer it owns, without copying it into a message buffer if it is sent
+     * by RDMC. The buffer must begin with registered_send_header_size bytes
+     * for Derecho's header, followed by the payload, and must not be changed
+     * until release_callback is called with it, on a Derecho thread, once
+     * the message has been delivered locally. The buffer is registered for
+     * RDMA the first time it is sent; call unregister_send_buffer before
+     * freeing it. Messages small enough for SMC are copied into an SMC slot,
+     * and their buffer is released before this returns.
+     * @param buffer The header space and payload
+     * @param size The size of buffer, including the header space
+     * @param release_callback The function that hands the buffer back
+     * @return false if the message could not be sent in this view
+     */
+    bool send_registered(subgroup_id_t subgroup_num, char* buffer, long long unsigned int size,
+                         const registered_buffer_callback_t& release_callback);
+    /** Removes any memory region registered by send_registered that overlaps the given bytes. */
+    void unregister_send_buffer(char* buffer, std::size_t size);
     bool check_pending_sst_sends(subgroup_id_t subgroup_num);
 
     const uint64_t compute_global_stability_frontier(subgroup_id_t subgroup_num);
 
     /** Stops all sending and receiving in this group, in preparation for shutting it down. */
     void wedge();
+    /**
+     * Freezes the row of a failed member in each SMCShardSST it belongs to,
+     * so that SMC pushes no longer go to it. Does nothing unless per_shard_smc.
+     */
+    void freeze_shard_sst_rows(node_id_t failed_node);
     /** Debugging function; prints the current state of the SST to stdout. */
     void debug_print();
 
@@ -565,6 +912,9 @@ public:
     const std::map<subgroup_id_t, SubgroupSettings>& get_subgroup_settings() {
         return subgroup_settings_map;
     }
-    std::vector<uint32_t> get_shard_sst_indices(subgroup_id_t subgroup_num);
+    /** Returns the SST rows of the members of this node's shard of a subgroup, in shard rank order. */
+    const std::vector<uint32_t>& get_shard_sst_indices(subgroup_id_t subgroup_num) const {
+        return shard_sst_indices_by_subgroup[subgroup_num];
+    }
 };
 }  // namespace derecho
@@ -37,7 +37,8 @@ class P2PConnection {
     const uint32_t my_node_id;
     const uint32_t remote_id;
     const RequestParams& request_params;
-    std::unique_ptr<volatile char[]> incoming_p2p_buffer;
+    /** Allocated with shm_allocate(), so that a co-located remote node can write to it directly. */
+    std::unique_ptr<volatile char[], shm_buffer_deleter> incoming_p2p_buffer;
     std::unique_ptr<volatile char[]> outgoing_p2p_buffer;
     std::unique_ptr<resources> res;
     std::map<REQUEST_TYPE, std::atomic<uint64_t>> incoming_seq_nums_map, outgoing_seq_nums_map;
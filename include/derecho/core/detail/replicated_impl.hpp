@@ -169,6 +169,17 @@ void Replicated<T>::send(unsigned long long int payload_size,
     group_rpc_manager.view_manager.send(subgroup_id, payload_size, msg_generator);
 }
 
+template <typename T>
+void Replicated<T>::send_registered(char* buffer, unsigned long long int size,
+                                    const registered_buffer_callback_t& release_callback) {
+    group_rpc_manager.view_manager.send_registered(subgroup_id, buffer, size, release_callback);
+}
+
+template <typename T>
+void Replicated<T>::unregister_send_buffer(char* buffer, std::size_t size) {
+    group_rpc_manager.view_manager.unregister_send_buffer(buffer, size);
+}
+
 template <typename T>
 std::size_t Replicated<T>::object_size() const {
     return mutils::bytes_size(**user_object_ptr);
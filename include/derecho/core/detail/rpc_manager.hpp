@@ -21,6 +21,7 @@
 #include "rpc_utils.hpp"
 #include <derecho/mutils-serialization/SerializationSupport.hpp>
 #include <derecho/utils/logger.hpp>
+#include <derecho/utils/polling_policy.hpp>
 
 namespace derecho {
 
@@ -157,6 +158,8 @@ class RPCManager {
     std::atomic<bool> thread_shutdown{false};
     /** The thread that listens for incoming P2P RPC calls; implemented by p2p_receive_loop() */
     std::thread rpc_listener_thread;
+    /** Decides how the P2P listening thread waits when there are no incoming messages. */
+    PollingPolicy p2p_polling;
     /** The thread that processes P2P requests in FIFO order; implemented by p2p_request_worker() */
     std::thread request_worker_thread;
     /** A simple struct representing a P2P request message.
@@ -227,12 +230,28 @@ class RPCManager {
     std::exception_ptr parse_and_receive(char* buf, std::size_t size,
                                          const std::function<char*(int)>& out_alloc);
 
+    /**
+     * Delivers one ordered (multicast) RPC message, placing any reply in a
+     * P2P reply buffer for the sender, and sends the reply unless the message
+     * came from this node. A self-reply is left for the caller to receive,
+     * once it has fulfilled the message's PendingResults.
+     * @param sender_id The ID of the node that sent the message
+     * @param msg_buf A buffer containing the message
+     * @param buffer_size The size of the message in the buffer, in bytes
+     * @param reply_buf Set to the reply, if the message was a self-receive
+     * with a reply
+     * @return The size of the reply, or 0 if there was none
+     */
+    std::size_t receive_ordered_message(node_id_t sender_id, char* msg_buf, uint32_t buffer_size,
+                                        char*& reply_buf);
+
 public:
     RPCManager(ViewManager& group_view_manager,
                const std::vector<DeserializationContext*>& deserialization_context)
             : nid(getConfUInt32(CONF_DERECHO_LOCAL_ID)),
               receivers(new std::decay_t<decltype(*receivers)>()),
-              view_manager(group_view_manager) {
+              view_manager(group_view_manager),
+              p2p_polling(PollingPolicy::from_config("p2p")) {
         for(const auto& deserialization_context_ptr : deserialization_context) {
             rdv.push_back(deserialization_context_ptr);
         }
@@ -311,6 +330,22 @@ public:
                              uint64_t timestamp,
                              char* msg_buf, uint32_t buffer_size);
 
+    /**
+     * Handler to be called by MulticastGroup, instead of rpc_message_handler,
+     * with a batch of "cooked send" RPC messages that became stable together
+     * in a subgroup (see DERECHO/batched_rpc_delivery). Delivers them one at
+     * a time, in order, just as rpc_message_handler would, but sets up the
+     * handler context once and fulfills the PendingResults of all the
+     * messages this node sent under one lock.
+     * @param subgroup_id The internal subgroup number of the subgroup the
+     * messages were received in
+     * @param messages The messages, in delivery order
+     * @param message_delivered A function to call with each message's
+     * position in messages as soon as its RPC function has run
+     */
+    void rpc_batch_handler(subgroup_id_t subgroup_id, const std::vector<rpc_message_t>& messages,
+                           const std::function<void(std::size_t)>& message_delivered);
+
     /**
      * Callback to be called by PersistenceManager when it has finished
      * persisting a version. This will deliver "local persistence done" events
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace derecho {
+
+/**
+ * A fixed-capacity, lock-free queue for exactly one producer thread and one
+ * consumer thread. Items are moved into and out of a ring of preallocated
+ * slots, so pushing and popping never allocate. It has no way to block: a
+ * consumer that runs out of items must arrange to be woken up some other way.
+ * T must be default-constructible and move-assignable.
+ */
+template <typename T>
+class SPSCQueue {
+    /** The slots of the ring; the size is always a power of two */
+    std::vector<T> slots;
+    /** The number of items ever popped; written only by the consumer */
+    alignas(64) std::atomic<std::size_t> head{0};
+    /** The number of items ever pushed; written only by the producer */
+    alignas(64) std::atomic<std::size_t> tail{0};
+
+    static std::size_t round_up(std::size_t capacity) {
+        std::size_t size = 1;
+        while(size < capacity) {
+            size <<= 1;
+        }
+        return size;
+    }
+
+public:
+    /** Makes a queue that holds at least capacity items. */
+    explicit SPSCQueue(std::size_t capacity) : slots(round_up(capacity)) {}
+
+    /** Moves an item to the back of the queue, or returns false if the queue is full. Producer only. */
+    bool try_push(T&& item) {
+        const std::size_t current_tail = tail.load(std::memory_order_relaxed);
+        if(current_tail - head.load(std::memory_order_acquire) == slots.size()) {
+            return false;
+        }
+        slots[current_tail & (slots.size() - 1)] = std::move(item);
+        tail.store(current_tail + 1, std::memory_order_release);
+        return true;
+    }
+    /** Moves the item at the front of the queue into item, or returns false if the queue is empty. Consumer only. */
+    bool try_pop(T& item) {
+        const std::size_t current_head = head.load(std::memory_order_relaxed);
+        if(current_head == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = std::move(slots[current_head & (slots.size() - 1)]);
+        head.store(current_head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /** True if the queue holds no items; exact only when called by the consumer. */
+    bool empty() const {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+    /** True if the queue has no room for another item; exact only when called by the producer. */
+    bool full() const {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire) == slots.size();
+    }
+};
+
+}  // namespace derecho
@@ -247,6 +247,13 @@ private:
      */
     bool active_leader;
 
+    /**
+     * The SST rows that min_acked reduces over (the local row first). Cleared
+     * when a view is installed or a member is marked failed, and rebuilt by
+     * the next call to min_acked.
+     */
+    std::vector<uint32_t> min_acked_rows;
+
     /**
      * A 2-dimensional vector, indexed by (subgroup ID -> shard number),
      * containing the ID of the node in each shard that was its leader
@@ -454,9 +461,16 @@ private:
     static void copy_suspected(const DerechoSST& gmsSST, std::vector<bool>& old);
     static bool changes_contains(const DerechoSST& gmsSST, const node_id_t q);
     static bool changes_includes_end_of_view(const DerechoSST& gmsSST, const int rank_of_leader);
-    static int min_acked(const DerechoSST& gmsSST, const std::vector<char>& failed);
     static bool previous_leaders_suspected(const DerechoSST& gmsSST, const View& curr_view);
 
+    /**
+     * Returns the lowest num_acked of the local row and the rows of the
+     * members that have not failed. Only called by the GMS predicate thread,
+     * with curr_view->failed, so min_acked_rows must be cleared whenever that
+     * changes.
+     */
+    int min_acked(const DerechoSST& gmsSST, const std::vector<char>& failed);
+
     /**
      * Searches backwards from this node's row in the SST to lower-ranked rows,
      * looking for proposed changes not in this node's changes list, assuming
@@ -838,6 +852,16 @@ public:
     void send(subgroup_id_t subgroup_num, long long unsigned int payload_size,
               const std::function<void(char* buf)>& msg_generator, bool cooked_send = false);
 
+    /**
+     * Instructs the managed MulticastGroup to send a raw message from a
+     * buffer the application owns; see MulticastGroup::send_registered.
+     */
+    void send_registered(subgroup_id_t subgroup_num, char* buffer, long long unsigned int size,
+                         const registered_buffer_callback_t& release_callback);
+
+    /** Stops the managed MulticastGroup from keeping the given bytes registered for send_registered. */
+    void unregister_send_buffer(char* buffer, std::size_t size);
+
     const uint64_t compute_global_stability_frontier(subgroup_id_t subgroup_num);
 
     /**
@@ -250,6 +250,27 @@ public:
      */
     void send(unsigned long long int payload_size, const std::function<void(char* buf)>& msg_generator);
 
+    /**
+     * Submits a call to send a "raw" (byte array) message in a multicast to
+     * this object's subgroup from a buffer the caller has already filled, which
+     * large messages are sent from directly instead of being copied. The buffer
+     * must start with derecho::registered_send_header_size bytes of space for
+     * Derecho's header, followed by the message, and must be left alone until
+     * release_callback is called with it once the message has been delivered.
+     * @param buffer The header space and message
+     * @param size The size of buffer, including the header space
+     * @param release_callback The function that hands the buffer back
+     */
+    void send_registered(char* buffer, unsigned long long int size,
+                         const registered_buffer_callback_t& release_callback);
+
+    /**
+     * Unregisters the given bytes, if they were registered for RDMA by
+     * send_registered. Must be called before freeing a buffer that was
+     * passed to send_registered.
+     */
+    void unregister_send_buffer(char* buffer, std::size_t size);
+
     /**
      * @return The serialized size of the object, of type T, that holds the
      * state of this Replicated<T>.
@@ -19,17 +19,42 @@ inline uint64_t form_tag(uint16_t group_number, uint32_t target) {
     return (((uint64_t)group_number) << 32) | (uint64_t)target;
 }
 
+/**
+ * The immediate value sent with each RDMC block. Groups whose messages all use
+ * the group's block size send the number of blocks in the message in the high
+ * 16 bits and the number of this block in the low 16 bits. Groups with adaptive
+ * block sizes also need the message's block size, so from the high bits down
+ * they send it as a right shift of the group's block size (4 bits), the number
+ * of blocks (14 bits), and the number of this block (14 bits).
+ */
 struct ParsedImmediate {
     uint16_t total_blocks;
     uint16_t block_number;
+    uint8_t block_size_shift;
 };
 
-inline ParsedImmediate parse_immediate(uint32_t imm) {
-    return ParsedImmediate{(uint16_t)((imm & 0xffff0000) >> 16),
-                           (uint16_t)(imm & 0x0000ffff)};
+/** The largest number of blocks an RDMC message can have. */
+constexpr uint16_t max_message_blocks = 0xffff;
+/** The largest number of blocks an RDMC message can have in a group with adaptive block sizes. */
+constexpr uint16_t max_adaptive_message_blocks = (1 << 14) - 1;
+/** The largest block_size_shift an RDMC message can have. */
+constexpr uint8_t max_block_size_shift = (1 << 4) - 1;
+
+inline ParsedImmediate parse_immediate(uint32_t imm, bool adaptive_block_size) {
+    if(!adaptive_block_size) {
+        return ParsedImmediate{(uint16_t)((imm & 0xffff0000) >> 16),
+                               (uint16_t)(imm & 0x0000ffff), 0};
+    }
+    return ParsedImmediate{(uint16_t)((imm & 0x0fffc000) >> 14),
+                           (uint16_t)(imm & 0x00003fff),
+                           (uint8_t)((imm & 0xf0000000) >> 28)};
 }
-inline uint32_t form_immediate(uint16_t total_blocks, uint16_t block_number) {
-    return ((uint32_t)total_blocks) << 16 | ((uint32_t)block_number);
+inline uint32_t form_immediate(uint16_t total_blocks, uint16_t block_number, uint8_t block_size_shift,
+                               bool adaptive_block_size) {
+    if(!adaptive_block_size) {
+        return ((uint32_t)total_blocks) << 16 | ((uint32_t)block_number);
+    }
+    return ((uint32_t)block_size_shift) << 28 | ((uint32_t)total_blocks) << 14 | ((uint32_t)block_number);
 }
 
 #endif
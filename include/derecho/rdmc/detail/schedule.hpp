@@ -2,6 +2,7 @@
 #define SCHEDULE_HPP
 
 #include <cmath>
+#include <cstdint>
 #include <optional>
 #include <vector>
 
@@ -69,10 +70,40 @@ private:
     optional<block_transfer> get_vertex_outgoing_transfer(size_t send_step);
     optional<block_transfer> get_vertex_incoming_transfer(size_t receive_step);
 
+    /** One step of a precomputed transfer table; target is no_transfer on steps without a transfer. */
+    struct table_entry {
+        uint32_t target;
+        uint32_t block_number;
+    };
+    static constexpr uint32_t no_transfer = UINT32_MAX;
+
+    /** This member's outgoing and incoming transfers on every step of a message of num_blocks blocks, indexed by step. */
+    struct transfer_tables {
+        size_t num_blocks;
+        vector<table_entry> outgoing;
+        vector<table_entry> incoming;
+    };
+    /** The number of message sizes whose tables are kept. */
+    static constexpr size_t max_cached_tables = 4;
+    /**
+     * Working out the transfers takes a walk over the hypercube for every
+     * step, so the tables for a number of blocks are computed on the first
+     * lookup for a message of that size, and kept for the last
+     * max_cached_tables sizes looked up, most recent first; groups tend to
+     * send messages of a few sizes. The tables are filled in by const
+     * lookups, so callers must not look up transfers from several threads
+     * at once (polling_group holds its monitor).
+     */
+    mutable vector<transfer_tables> cached_tables;
+    /** The first block this member receives, which does not depend on the number of blocks. */
+    optional<block_transfer> first_block;
+
+    /** Returns the tables for num_blocks blocks, building them if they are not cached. */
+    const transfer_tables& get_tables(size_t num_blocks) const;
+    static optional<block_transfer> lookup(const vector<table_entry>& table, size_t step);
+
 public:
-    binomial_schedule(uint32_t members, uint32_t index)
-            : schedule(members, index),
-              log2_num_members(floor(log2(num_members))) {}
+    binomial_schedule(uint32_t members, uint32_t index);
 
     static optional<block_transfer> get_vertex_outgoing_transfer(
             uint32_t vertex, size_t step, uint32_t num_members,
@@ -104,4 +135,69 @@ public:
     size_t get_total_steps(size_t num_blocks) const;
 };
 
+/**
+ * A two-level schedule for groups whose members sit in racks (or other
+ * locality domains) with less bandwidth between racks than within them. The
+ * racks run a binomial pipeline among themselves, and each rack passes every
+ * block it gets down a chain through its members, so each block crosses into
+ * a rack only once. The first member of each rack (the sender, for the
+ * sender's rack) is its leader: it receives the rack's binomial transfers and
+ * starts the chain. The last member of the chain sends the rack's binomial
+ * transfers. Every member therefore sends one stream of blocks and receives
+ * one, as in binomial_send, instead of a leader splitting its outgoing link
+ * between the binomial pipeline and the chain. A rack with one member plays
+ * both roles, as in binomial_send.
+ *
+ * A binomial pipeline forwards each block on the step after it arrives, but
+ * here a block takes a trip down the chain in between. So the racks run
+ * several binomial pipelines interleaved step by step, one per position in
+ * the longest chain, with pipeline j carrying blocks j, j + n, j + 2n, ...
+ * (for n pipelines). Each pipeline then has enough steps between receiving a
+ * block and forwarding it for the block to reach the end of the chain.
+ */
+class hybrid_schedule : public schedule {
+private:
+    /** The members of each rack in chain order, leader first; the sender's rack is rack 0. */
+    vector<vector<uint32_t>> racks;
+    uint32_t my_rack;
+    /** This member's position in its rack's chain; 0 for the leader. */
+    uint32_t my_position;
+    // Base 2 logarithm of the number of racks, rounded down.
+    unsigned int log2_num_racks;
+    /** The number of interleaved binomial pipelines, which is the length of the longest chain. */
+    uint32_t num_pipelines;
+
+    /** The number of blocks that binomial pipeline j carries. */
+    size_t get_pipeline_blocks(size_t num_blocks, uint32_t pipeline) const;
+    /** The number of steps of one binomial pipeline that carries the given number of blocks. */
+    size_t get_pipeline_total_steps(size_t pipeline_blocks) const;
+    size_t get_leader_total_steps(size_t num_blocks) const;
+    /** A rack's binomial transfer on the given step, in (global) block numbers and rack numbers. */
+    optional<block_transfer> get_binomial_transfer(bool outgoing, uint32_t rack, size_t num_blocks, size_t step) const;
+    /**
+     * The block that a rack's leader gets on the given step, which every
+     * member of its chain forwards on the same step. For the sender's rack,
+     * the sender "gets" block i on step i.
+     */
+    optional<size_t> get_leader_block(uint32_t rack, size_t num_blocks, size_t step) const;
+    /** The member that receives a rack's binomial transfers. */
+    uint32_t binomial_receiver(uint32_t rack) const { return racks[rack].front(); }
+    /** The member that sends a rack's binomial transfers. */
+    uint32_t binomial_sender(uint32_t rack) const { return racks[rack].back(); }
+
+public:
+    /**
+     * @param members The number of members in the group
+     * @param index This node's index in the group; member 0 is the sender
+     * @param member_racks The rack of each member, by index; any numbering
+     * can be used as long as members in the same rack have the same number
+     */
+    hybrid_schedule(uint32_t members, uint32_t index, const vector<uint32_t>& member_racks);
+    vector<uint32_t> get_connections() const;
+    optional<block_transfer> get_outgoing_transfer(size_t num_blocks, size_t send_step) const;
+    optional<block_transfer> get_incoming_transfer(size_t num_blocks, size_t receive_step) const;
+    optional<block_transfer> get_first_block(size_t num_blocks) const;
+    size_t get_total_steps(size_t num_blocks) const;
+};
+
 #endif /* SCHEDULE_HPP */
@@ -28,7 +28,14 @@ class group {
 protected:
     const vector<uint32_t> members;  // first element is the sender
     const uint16_t group_number;
+    // The largest block size messages can use, and the size of the first block buffer
     const size_t block_size;
+    // The smallest block size a message can be split into; equal to block_size
+    // if every message uses block_size
+    const size_t min_block_size;
+    // True if messages can use blocks smaller than block_size, which changes
+    // the layout of the block immediates and limits the number of blocks
+    const bool adaptive_block_size;
     const uint32_t num_members;
     const uint32_t member_index;  // our index in the members list
 
@@ -40,11 +47,14 @@ protected:
     size_t mr_offset;
     size_t message_size;
     size_t num_blocks;
+    // The block size of the current message, which is block_size >> block_size_shift
+    size_t message_block_size;
+    uint8_t block_size_shift;
 
     completion_callback_t completion_callback;
     incoming_message_callback_t incoming_message_upcall;
 
-    group(uint16_t group_number, size_t block_size,
+    group(uint16_t group_number, size_t block_size, size_t min_block_size,
           vector<uint32_t> members, uint32_t member_index,
           incoming_message_callback_t upcall,
           completion_callback_t callback,
@@ -69,6 +79,8 @@ private:
     unique_ptr<rdma::memory_region> first_block_mr;
     optional<size_t> first_block_number;
     unique_ptr<char[]> first_block_buffer;
+    // The number of bytes actually received into first_block_buffer
+    size_t first_block_size;
 
     size_t incoming_block;
     size_t message_number = 0;
@@ -99,7 +111,7 @@ private:
 public:
     static void initialize_message_types();
 
-    polling_group(uint16_t group_number, size_t block_size,
+    polling_group(uint16_t group_number, size_t block_size, size_t min_block_size,
                   vector<uint32_t> members, uint32_t member_index,
                   incoming_message_callback_t upcall,
                   completion_callback_t callback,
@@ -113,6 +125,11 @@ public:
                               size_t offset, size_t length);
 
 private:
+    // Estimated fixed cost of sending a block, expressed as the number of
+    // bytes that could have been sent in the same time
+    static constexpr size_t block_overhead_bytes = 64 << 10;
+
+    uint8_t choose_block_size_shift(size_t length) const;
     void post_recv(schedule::block_transfer transfer);
     void send_next_block();
     void complete_message();
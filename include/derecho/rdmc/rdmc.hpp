@@ -29,7 +29,8 @@ enum send_algorithm {
     BINOMIAL_SEND = 1,
     CHAIN_SEND = 2,
     SEQUENTIAL_SEND = 3,
-    TREE_SEND = 4
+    TREE_SEND = 4,
+    HYBRID_SEND = 5
 };
 
 struct receive_destination {
@@ -76,6 +77,16 @@ void destroy_group(uint16_t group_number);
 bool send(uint16_t group_number, std::shared_ptr<rdma::memory_region> mr,
           size_t offset, size_t length) __attribute__((warn_unused_result));
 
+/**
+ * Looks up the rack of each member of a group in the DERECHO/rdmc_racks
+ * option, for HYBRID_SEND groups. Members that are not listed there are all
+ * placed in one rack.
+ * @param members The node IDs of the group members
+ * @return The rack number of each member, in the same order; members in the
+ * same rack get the same number
+ */
+std::vector<uint32_t> get_member_racks(const std::vector<uint32_t>& members);
+
 // Convenience function to obtain the addresses of other nodes that might be
 // part of group communication.
 // void query_addresses(std::map<uint32_t, std::string>& addresses,
@@ -0,0 +1,139 @@
+/**
+ * @file inline_function.hpp
+ *
+ * A move-only, type-erased callable wrapper that stores small callables
+ * inside the wrapper object itself, so that a vector of them is contiguous
+ * and calling one does not chase a heap pointer.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace sst {
+namespace util {
+
+template <typename Signature, std::size_t Capacity = 64>
+class inline_function;
+
+/**
+ * Similar to std::function, but with a configurable amount of in-object
+ * storage (Capacity bytes). Callables that fit in that storage are placed
+ * there; larger ones fall back to a single heap allocation, so any callable
+ * that std::function accepts is still accepted. Unlike std::function, this
+ * wrapper is move-only, which avoids hidden copies of captured state.
+ */
+template <typename R, typename... Args, std::size_t Capacity>
+class inline_function<R(Args...), Capacity> {
+    using storage_t = std::aligned_storage_t<Capacity, alignof(std::max_align_t)>;
+
+    /** Per-callable-type operations, one static instance per stored type. */
+    struct ops_t {
+        R (*invoke)(void* target, Args&&... args);
+        void (*move)(void* dest, void* src) noexcept;
+        void (*destroy)(void* target) noexcept;
+    };
+
+    template <typename F>
+    static constexpr bool fits_inline = sizeof(F) <= Capacity
+                                        && alignof(storage_t) % alignof(F) == 0
+                                        && std::is_nothrow_move_constructible<F>::value;
+
+    template <typename F>
+    struct inline_ops {
+        static R invoke(void* target, Args&&... args) {
+            return (*static_cast<F*>(target))(std::forward<Args>(args)...);
+        }
+        static void move(void* dest, void* src) noexcept {
+            new(dest) F(std::move(*static_cast<F*>(src)));
+            static_cast<F*>(src)->~F();
+        }
+        static void destroy(void* target) noexcept {
+            static_cast<F*>(target)->~F();
+        }
+        static constexpr ops_t table{&invoke, &move, &destroy};
+    };
+
+    template <typename F>
+    struct heap_ops {
+        static R invoke(void* target, Args&&... args) {
+            return (**static_cast<F**>(target))(std::forward<Args>(args)...);
+        }
+        static void move(void* dest, void* src) noexcept {
+            new(dest) F*(*static_cast<F**>(src));
+        }
+        static void destroy(void* target) noexcept {
+            delete *static_cast<F**>(target);
+        }
+        static constexpr ops_t table{&invoke, &move, &destroy};
+    };
+
+    storage_t storage;
+    const ops_t* ops;
+
+public:
+    inline_function() noexcept : ops(nullptr) {}
+    inline_function(std::nullptr_t) noexcept : ops(nullptr) {}
+
+    template <typename F,
+              typename D = std::decay_t<F>,
+              typename = std::enable_if_t<!std::is_same<D, inline_function>::value
+                                          && std::is_invocable_r<R, D&, Args...>::value>>
+    inline_function(F&& f) : ops(nullptr) {
+        if constexpr(fits_inline<D>) {
+            new(&storage) D(std::forward<F>(f));
+            ops = &inline_ops<D>::table;
+        } else {
+            new(&storage) D*(new D(std::forward<F>(f)));
+            ops = &heap_ops<D>::table;
+        }
+    }
+
+    inline_function(inline_function&& other) noexcept : ops(other.ops) {
+        if(ops) {
+            ops->move(&storage, &other.storage);
+            other.ops = nullptr;
+        }
+    }
+
+    inline_function& operator=(inline_function&& other) noexcept {
+        if(this != &other) {
+            reset();
+            if(other.ops) {
+                other.ops->move(&storage, &other.storage);
+                ops = other.ops;
+                other.ops = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    inline_function(const inline_function&) = delete;
+    inline_function& operator=(const inline_function&) = delete;
+
+    ~inline_function() { reset(); }
+
+    /** Destroys the stored callable, leaving this wrapper empty. */
+    void reset() noexcept {
+        if(ops) {
+            ops->destroy(&storage);
+            ops = nullptr;
+        }
+    }
+
+    explicit operator bool() const noexcept { return ops != nullptr; }
+
+    R operator()(Args... args) const {
+        if(!ops) {
+            throw std::bad_function_call();
+        }
+        return ops->invoke(const_cast<storage_t*>(&storage), std::forward<Args>(args)...);
+    }
+};
+
+}  // namespace util
+}  // namespace sst
@@ -17,6 +17,9 @@
 #include <derecho/core/detail/connection_manager.hpp>
 #include <derecho/utils/logger.hpp>
 
+#include "shm.hpp"
+#include "write_range.hpp"
+
 #ifndef LF_VERSION
 #define LF_VERSION FI_VERSION(1, 5)
 #endif
@@ -55,6 +58,8 @@ private:
 
 protected:
     std::atomic<bool> remote_failed;
+    /** The shared-memory connection to the remote node, if it is on this host; otherwise null. */
+    std::unique_ptr<shm_peer> shm;
     /** 
      * post read/write request
      * 
@@ -67,6 +72,13 @@ protected:
      */
     int post_remote_send(lf_sender_ctxt* ctxt, const long long int offset, const long long int size,
                          const int op, const bool completion);
+    /**
+     * post a list of write requests without completion
+     *
+     * @param writes - The ranges of the local row to write, in order
+     * @param return the return code for the first failed operation, or 0.
+     */
+    int post_remote_write_list(const write_range* writes, const std::size_t num_writes);
 
 public:
     /** ID of the remote node. */
@@ -111,9 +123,11 @@ public:
      *         client initiates connection to the passive endpoint of the remote 
      *         node, while a libfabric server waiting for the conneciton using its
      *         local passive endpoint.
+     * @param allow_shm Whether the connection may use shared memory instead of
+     *         RDMA if the remote node is on the same host.
      */
     _resources(int r_id, char* write_addr, char* read_addr, int size_w,
-               int size_r, int is_lf_server);
+               int size_r, int is_lf_server, bool allow_shm = true);
     /** Destroys the resources. */
     virtual ~_resources();
 };
@@ -146,6 +160,12 @@ public:
     void post_remote_write(const long long int size);
     /** Post an RDMA write at an offset into remote memory. */
     void post_remote_write(const long long int offset, long long int size);
+    /**
+     * Post several RDMA writes at once. All but the last are posted with
+     * FI_MORE, so the provider can ring the doorbell once for the whole list;
+     * the writes are performed in list order.
+     */
+    void post_remote_writes(const write_range* writes, const std::size_t num_writes);
     void post_remote_write_with_completion(lf_sender_ctxt* ctxt, const long long int size);
     /** Post an RDMA write at an offset into remote memory. */
     void post_remote_write_with_completion(lf_sender_ctxt* ctxt, const long long int offset, const long long int size);
@@ -159,9 +179,12 @@ class resources_two_sided : public _resources {
     int post_receive(lf_sender_ctxt* ctxt, const long long int offset, const long long int size);
 
 public:
-    /** constructor: simply forwards to _resources::_resources */
+    /**
+     * constructor: forwards to _resources::_resources, but never uses shared
+     * memory, since two-sided operations need a real endpoint.
+     */
     resources_two_sided(int r_id, char* write_addr, char* read_addr, int size_w,
-                        int size_r, int is_lf_server) : _resources(r_id, write_addr, read_addr, size_w, size_r, is_lf_server) {
+                        int size_r, int is_lf_server) : _resources(r_id, write_addr, read_addr, size_w, size_r, is_lf_server, false) {
     }
     /**
      * Report that the remote node this object is connected to has failed.
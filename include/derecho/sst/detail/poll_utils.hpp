@@ -1,40 +1,140 @@
 #pragma once
 
+#include <array>
+#include <atomic>
 #include <condition_variable>
+#include <deque>
 #include <optional>
-#include <list>
-#include <map>
 #include <mutex>
 #include <thread>
+#include <utility>
 #include <vector>
 
 namespace sst {
 namespace util {
+/**
+ * Routes completions from the polling thread to the threads that posted the
+ * corresponding operations. Each thread that waits for completions owns a
+ * completion slot, which it registers once (the first time it calls
+ * get_index()) and which is remembered in thread-local storage; the polling
+ * thread appends to a slot and its owner removes from it without taking any
+ * lock. Slots are recycled when their owning threads exit. At most max_slots
+ * threads can own a slot at the same time; get_index() throws once that many
+ * live threads have waited for completions.
+ *
+ * The functions that take a thread ID must be called with the ID of the
+ * calling thread; the ID is only kept for compatibility with older callers.
+ */
 class PollingData {
-    // static std::vector<std::list<std::pair<int32_t, int32_t>>> completion_entries;
-    // static std::map<std::thread::id, uint32_t> tid_to_index;
-    // static std::vector<bool> if_waiting;
-    // static std::condition_variable poll_cv;
-    // static std::mutex poll_mutex;
-    // static bool check_waiting();
-
-    std::vector<std::list<std::pair<int32_t, int32_t>>> completion_entries;
-    std::map<std::thread::id, uint32_t> tid_to_index;
-    std::vector<bool> if_waiting;
+    /** The maximum number of threads that can own a completion slot at once. */
+    static constexpr uint32_t max_slots = 1024;
+    /** The number of completions that a slot holds without locking; further ones go to its overflow list. */
+    static constexpr uint32_t slot_capacity = 1024;
+
+    /**
+     * A bounded queue of completions for one thread, with any number of
+     * producers (the polling thread, and the owner itself for operations that
+     * complete immediately) and a single consumer (the owner). Each cell's
+     * sequence number says whether it is free for the producer that claims
+     * position pos (sequence == pos) or holds that producer's entry
+     * (sequence == pos + 1). Producers never wait for the owner: a completion
+     * that finds the queue full goes to a locked overflow list instead, so a
+     * thread that falls behind cannot stall the polling thread and no
+     * completion is lost.
+     */
+    struct alignas(64) completion_slot {
+        struct cell {
+            std::atomic<uint64_t> sequence;
+            std::pair<int32_t, int32_t> entry;
+        };
+        std::array<cell, slot_capacity> cells;
+        /** The next position a producer will claim. */
+        alignas(64) std::atomic<uint64_t> enqueue_pos;
+        /** The next position the owner will read; only the owner touches it. */
+        alignas(64) uint64_t dequeue_pos;
+        /** The sequence number of the owner's latest call; only the owner touches it. */
+        uint32_t call_sequence;
+        /** True while the owner is waiting for completions. */
+        std::atomic<bool> waiting;
+        /** True while a live thread owns the slot; completions for a free slot are dropped. */
+        std::atomic<bool> owned;
+        /** True while overflow may be non-empty, so the owner only locks it when it has to. */
+        std::atomic<bool> has_overflow;
+        /** Guards overflow. */
+        std::mutex overflow_mutex;
+        /** Completions that arrived while the queue was full, oldest first. */
+        std::deque<std::pair<int32_t, int32_t>> overflow;
+
+        completion_slot();
+        /** Appends a completion to the queue, or returns false if the queue is full. */
+        bool push(const std::pair<int32_t, int32_t>& ce);
+        /** Appends a completion to the overflow list; returns true if the list was empty. */
+        bool push_overflow(const std::pair<int32_t, int32_t>& ce);
+        std::optional<std::pair<int32_t, int32_t>> pop();
+    };
+
+    /** Releases a thread's completion slot when the thread exits. */
+    struct thread_registration {
+        uint32_t index = max_slots;
+        ~thread_registration();
+    };
+    static thread_local thread_registration this_thread_slot;
+
+    /** Slots indexed by completion entry index; entries never move once published. */
+    std::array<std::atomic<completion_slot*>, max_slots> slots;
+    /** The number of slots that have been allocated. */
+    std::atomic<uint32_t> num_slots;
+    /** Guards free_slots and allocation of new slots; only taken when a thread registers or exits. */
+    std::mutex registration_mutex;
+    /** Indexes of allocated slots whose threads have exited. */
+    std::vector<uint32_t> free_slots;
+
+    /** The number of threads currently waiting for completions. */
+    std::atomic<uint32_t> num_waiting;
+    /** Used only to put the polling thread to sleep in wait_for_requests. */
     std::condition_variable poll_cv;
     std::mutex poll_mutex;
-    bool check_waiting();
+
+    /** Returns the calling thread's slot, registering the thread if necessary. */
+    completion_slot& my_slot();
+    void release_slot(uint32_t index);
+
 public:
+    PollingData();
+    ~PollingData();
+    PollingData(const PollingData&) = delete;
+    PollingData& operator=(const PollingData&) = delete;
+
+    /**
+     * Delivers a completion to the thread that owns the given slot. Lock-free
+     * unless the slot's queue is full, and never waits for the owner; the
+     * completion is dropped only if the slot has no owner.
+     */
     void insert_completion_entry(uint32_t index, std::pair<int32_t, int32_t> ce);
 
+    /** Removes the oldest completion delivered to the calling thread, if there is one. Lock-free. */
     std::optional<std::pair<int32_t, int32_t>> get_completion_entry(const std::thread::id id);
 
+    /**
+     * Returns the index of the calling thread's completion slot, which should
+     * be put in the context of each operation it posts with completion.
+     */
     uint32_t get_index(const std::thread::id id);
 
+    /**
+     * Returns a new sequence number for the calling thread, which callers put
+     * in the contexts of the operations they post so that they can tell the
+     * completions of an earlier call that timed out from their own.
+     */
+    uint32_t next_sequence(const std::thread::id id);
+
+    /** Marks the calling thread as waiting for completions, waking up the polling thread if it sleeps. */
     void set_waiting(const std::thread::id id);
 
+    /** Marks the calling thread as no longer waiting for completions. */
     void reset_waiting(const std::thread::id id);
 
+    /** Blocks until at least one thread is waiting for completions. */
     void wait_for_requests();
 };
 
@@ -0,0 +1,123 @@
+#ifndef SHM_HPP
+#define SHM_HPP
+
+/**
+ * @file shm.hpp
+ * Contains declarations for the shared-memory transport, which the SST and
+ * P2P resources use instead of RDMA when both ends of a connection are
+ * processes on the same host.
+ */
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <derecho/core/derecho_type_definitions.hpp>
+
+namespace tcp {
+class tcp_connections;
+}
+
+namespace sst {
+
+/**
+ * Allocates a zero-filled, page-aligned buffer that co-located processes can
+ * map, by backing it with a POSIX shared memory segment. If the shared-memory
+ * transport is disabled (DERECHO/shm_transport) or the segment cannot be
+ * created, falls back to private anonymous memory, which still works with
+ * RDMA but is never offered to peers.
+ * @param size The size of the buffer in bytes; must be nonzero
+ * @return A pointer to the buffer, which must be released with shm_free()
+ */
+char* shm_allocate(std::size_t size);
+
+/** Releases a buffer returned by shm_allocate(), and removes its segment if it has one. */
+void shm_free(char* buffer);
+
+/** A deleter for smart pointers that own buffers returned by shm_allocate(). */
+struct shm_buffer_deleter {
+    void operator()(volatile char* buffer) const {
+        shm_free(const_cast<char*>(buffer));
+    }
+};
+
+/**
+ * One side of a shared-memory connection to a process on the same host. The
+ * peer's receive buffer is mapped into this process, so a "remote write" is a
+ * copy from the local buffer into the peer's buffer. The copy stores words in
+ * ascending address order with release semantics, so a reader polling on the
+ * last word of a write sees the rest of it, just as with an RDMA write.
+ * The peer's heartbeat counter is mapped too, so that a peer that hangs is
+ * suspected just as one that exits is.
+ */
+class shm_peer {
+    /** The base of the peer's segment, as mapped into this process. */
+    char* mapping;
+    /** The length of the mapping. */
+    std::size_t mapping_size;
+    /** The peer's buffer that receives this process's writes. */
+    char* remote_buf;
+    /** The local buffer that writes are copied from (and reads copied into). */
+    char* local_buf;
+    /** The base of the segment that holds the peer's heartbeat counter, mapped read-only. */
+    char* heartbeat_mapping;
+    std::size_t heartbeat_mapping_size;
+    /** The peer's heartbeat counter, which a thread of the peer increments periodically. */
+    const volatile uint64_t* remote_heartbeat;
+    /** An open descriptor of the heartbeat segment, to test for the peer's flock on it. */
+    int heartbeat_fd;
+    /** How long the heartbeat may stay unchanged before the peer is suspected (DERECHO/sst_poll_cq_timeout_ms). */
+    const std::chrono::milliseconds heartbeat_timeout;
+    std::mutex heartbeat_mutex;
+    /** The last value read from remote_heartbeat, and when it was first seen. Protected by heartbeat_mutex. */
+    uint64_t last_heartbeat;
+    std::chrono::steady_clock::time_point last_heartbeat_change;
+
+    shm_peer(char* mapping, std::size_t mapping_size, char* remote_buf, char* local_buf,
+             char* heartbeat_mapping, std::size_t heartbeat_mapping_size,
+             const volatile uint64_t* remote_heartbeat, int heartbeat_fd);
+
+public:
+    /**
+     * Negotiates a shared-memory connection over an existing TCP connection.
+     * Both ends must call this at the same point in their connection setup,
+     * since it exchanges data over the TCP connection even if shared memory
+     * turns out to be unusable. Shared memory is used only if both ends allow
+     * it, the peer's IP address belongs to this host, both receive buffers
+     * came from shm_allocate(), and both ends manage to map each other's
+     * segments.
+     * @param connections The TCP connections that include one to remote_id
+     * @param remote_id The ID of the peer node
+     * @param write_buf The local buffer that the peer writes into
+     * @param write_size The size of write_buf
+     * @param read_buf The local buffer that writes to the peer are copied from
+     * @param allow Whether this end is willing to use shared memory at all
+     * @return The connection, or nullptr if the caller should use RDMA instead
+     */
+    static std::unique_ptr<shm_peer> try_connect(tcp::tcp_connections& connections, node_id_t remote_id,
+                                                 char* write_buf, std::size_t write_size, char* read_buf,
+                                                 bool allow = true);
+    shm_peer(const shm_peer&) = delete;
+    shm_peer& operator=(const shm_peer&) = delete;
+    ~shm_peer();
+
+    /** Copies [offset, offset + size) of the local buffer into the same range of the peer's buffer. */
+    void write(const long long int offset, const long long int size);
+    /** Copies [offset, offset + size) of the peer's buffer into the same range of the local buffer. */
+    void read(const long long int offset, const long long int size);
+    /**
+     * Returns false once the peer process has exited, or once its heartbeat
+     * has not changed for DERECHO/sst_poll_cq_timeout_ms.
+     */
+    bool remote_alive();
+};
+
+/** Returns true if the given IP address is assigned to one of this host's interfaces. */
+bool is_local_ip(const std::string& ip);
+
+}  // namespace sst
+
+#endif  // SHM_HPP
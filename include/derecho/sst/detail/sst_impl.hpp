@@ -8,15 +8,20 @@
 
 #include <chrono>
 #include <condition_variable>
+#include <cstdio>
 #include <memory>
 #include <mutex>
 #include <pthread.h>
+#include <sched.h>
+#include <sstream>
+#include <string>
 #include <sys/time.h>
 #include <thread>
 #include <time.h>
 #include <vector>
 
 #include "poll_utils.hpp"
+#include <derecho/utils/logger.hpp>
 #include "../predicates.hpp"
 #include "../sst.hpp"
 
@@ -24,18 +29,47 @@ namespace sst {
 
 /**
  * Destructor for the SST object; sets thread_shutdown to true and waits for
- * background threads to exit cleanly.
+ * background threads to exit cleanly, waking up any that are still waiting
+ * for start_predicate_evaluation().
  */
 template <typename DerivedSST>
 SST<DerivedSST>::~SST() {
     thread_shutdown = true;
+    {
+        std::lock_guard<std::mutex> lock(thread_start_mutex);
+        thread_start = true;
+    }
+    thread_start_cv.notify_all();
     for(auto& thread : background_threads) {
         if(thread.joinable()) thread.join();
     }
 
     if(rows != nullptr) {
-        delete[](const_cast<char*>(rows));
+        shm_free(const_cast<char*>(rows));
+    }
+}
+
+template <typename DerivedSST>
+std::string SST<DerivedSST>::layout_to_string(const std::vector<std::string>& names) const {
+    const std::vector<std::string>& field_names = names.empty() ? this->field_names : names;
+    std::stringstream out;
+    out << "SST row length " << rowLen << " bytes (" << (rowLen + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE
+        << " cache lines), " << row_layout.size() << " fields" << std::endl;
+    for(std::size_t i = 0; i < row_layout.size(); ++i) {
+        const field_layout& field = row_layout[i];
+        if(i < field_names.size()) {
+            out << field_names[i];
+        } else {
+            out << "field " << i;
+        }
+        out << ": offset " << field.offset
+            << ", size " << field.field_len
+            << ", padding " << (field.padded_len - field.field_len)
+            << ", " << (field.access == FieldAccess::HOT ? "hot" : "cold")
+            << ", lines " << field.offset / CACHE_LINE_SIZE << "-"
+            << (field.offset + field.padded_len - 1) / CACHE_LINE_SIZE << std::endl;
     }
+    return out.str();
 }
 
 /**
@@ -55,89 +89,112 @@ void SST<DerivedSST>::start_predicate_evaluation() {
  * events. It continuously evaluates predicates one by one, and runs the
  * trigger functions for each predicate that fires. In addition, it
  * continuously evaluates named functions one by one, and updates the local
- * row's observed values of those functions.
+ * row's observed values of those functions. When there are several detector
+ * threads, each one evaluates only the predicates in its own partition.
  */
 template <typename DerivedSST>
-void SST<DerivedSST>::detect() {
-    pthread_setname_np(pthread_self(), "sst_detect");
+void SST<DerivedSST>::detect(uint32_t thread_index) {
+    if(thread_index == 0) {
+        pthread_setname_np(pthread_self(), "sst_detect");
+    } else {
+        char thread_name[16];
+        snprintf(thread_name, sizeof(thread_name), "sst_detect_%u", thread_index);
+        pthread_setname_np(pthread_self(), thread_name);
+    }
+    if(thread_index < predicate_thread_cpus.size()) {
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        CPU_SET(predicate_thread_cpus[thread_index], &cpu_set);
+        if(pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) != 0) {
+            dbg_default_warn("Failed to pin SST predicate thread {} to CPU {}",
+                             thread_index, predicate_thread_cpus[thread_index]);
+        }
+    }
     if(!thread_start) {
         std::unique_lock<std::mutex> lock(thread_start_mutex);
         thread_start_cv.wait(lock, [this]() { return thread_start; });
     }
-    struct timespec last_time, cur_time;
-    clock_gettime(CLOCK_REALTIME, &last_time);
+
+    auto& partition = *predicates.partitions[thread_index];
+    derecho::PollingPolicy& polling = *predicate_polling[thread_index];
+    {
+        std::lock_guard<std::mutex> lock(partition.predicate_mutex);
+        partition.evaluator_id = std::this_thread::get_id();
+    }
+    // Runs a trigger with the predicate lock released, recording which
+    // predicate it belongs to so that Predicates::remove can wait for it
+    auto run_trigger = [&](std::unique_lock<std::mutex>& predicates_lock, uint64_t predicate_id,
+                           const std::shared_ptr<typename Predicates<DerivedSST>::trig>& trigger) {
+        partition.trigger_running = true;
+        partition.running_predicate_id = predicate_id;
+        predicates_lock.unlock();
+        (*trigger)(*derived_this);
+        predicates_lock.lock();
+        partition.trigger_running = false;
+        partition.trigger_finished.notify_all();
+    };
 
     while(!thread_shutdown) {
         bool predicate_fired = false;
-        // Take the predicate lock before reading the predicate lists
-        std::unique_lock<std::mutex> predicates_lock(predicates.predicate_mutex);
+        // Take the predicate lock before reading the predicate tables
+        std::unique_lock<std::mutex> predicates_lock(partition.predicate_mutex);
+        // Tables are walked by index rather than by reference, since a trigger
+        // may insert predicates (and reallocate a table) while the lock is released
+        auto& one_time = partition.one_time_predicates;
+        auto& recurrent = partition.recurrent_predicates;
+        auto& transition = partition.transition_predicates;
 
         // one time predicates need to be evaluated only until they become true
-        for(auto& pred : predicates.one_time_predicates) {
-            if(pred != nullptr && (pred->first(*derived_this) == true)) {
+        for(std::size_t i = 0; i < one_time.entries.size(); ++i) {
+            if(one_time.entries[i].live && one_time.entries[i].predicate(*derived_this)) {
                 predicate_fired = true;
                 // Copy the trigger pointer locally, so it can continue running without
                 // segfaulting even if this predicate gets deleted when we unlock predicates_lock
-                std::shared_ptr<typename Predicates<DerivedSST>::trig> trigger(pred->second);
-                predicates_lock.unlock();
-                (*trigger)(*derived_this);
-                predicates_lock.lock();
+                std::shared_ptr<typename Predicates<DerivedSST>::trig> trigger(one_time.entries[i].trigger);
+                const uint64_t id = one_time.entries[i].id;
                 // erase the predicate as it was just found to be true
-                pred.reset();
+                one_time.kill(one_time.entries[i]);
+                run_trigger(predicates_lock, id, trigger);
             }
         }
 
         // recurrent predicates are evaluated each time they are found to be true
-        for(auto& pred : predicates.recurrent_predicates) {
-            if(pred != nullptr && (pred->first(*derived_this) == true)) {
+        for(std::size_t i = 0; i < recurrent.entries.size(); ++i) {
+            if(recurrent.entries[i].live && recurrent.entries[i].predicate(*derived_this)) {
                 predicate_fired = true;
-                std::shared_ptr<typename Predicates<DerivedSST>::trig> trigger(pred->second);
-                predicates_lock.unlock();
-                (*trigger)(*derived_this);
-                predicates_lock.lock();
+                std::shared_ptr<typename Predicates<DerivedSST>::trig> trigger(recurrent.entries[i].trigger);
+                run_trigger(predicates_lock, recurrent.entries[i].id, trigger);
             }
         }
 
         // transition predicates are only evaluated when they change from false to true
-        // We need to use iterators here because we need to iterate over two lists in parallel
-        auto pred_it = predicates.transition_predicates.begin();
-        auto pred_state_it = predicates.transition_predicate_states.begin();
-        while(pred_it != predicates.transition_predicates.end()) {
-            if(*pred_it != nullptr) {
-                //*pred_state_it is the previous state of the predicate at *pred_it
-                bool curr_pred_state = (*pred_it)->first(*derived_this);
-                if(curr_pred_state == true && *pred_state_it == false) {
-                    predicate_fired = true;
-                    std::shared_ptr<typename Predicates<DerivedSST>::trig> trigger(
-                            (*pred_it)->second);
-                    predicates_lock.unlock();
-                    (*trigger)(*derived_this);
-                    predicates_lock.lock();
-                }
-                *pred_state_it = curr_pred_state;
-
-                ++pred_it;
-                ++pred_state_it;
+        for(std::size_t i = 0; i < transition.entries.size(); ++i) {
+            if(!transition.entries[i].live) {
+                continue;
+            }
+            bool curr_pred_state = transition.entries[i].predicate(*derived_this);
+            bool prev_pred_state = transition.entries[i].last_state;
+            transition.entries[i].last_state = curr_pred_state;
+            if(curr_pred_state == true && prev_pred_state == false) {
+                predicate_fired = true;
+                std::shared_ptr<typename Predicates<DerivedSST>::trig> trigger(transition.entries[i].trigger);
+                run_trigger(predicates_lock, transition.entries[i].id, trigger);
             }
         }
 
+        // Clean up deleted predicates now that no table is being walked
+        partition.compact_tables();
+
         if(predicate_fired) {
-            // update last time
-            clock_gettime(CLOCK_REALTIME, &last_time);
+            polling.on_progress();
         } else {
-            clock_gettime(CLOCK_REALTIME, &cur_time);
-            // check if the system has been inactive for enough time to induce sleep
-            double time_elapsed_in_ms = (cur_time.tv_sec - last_time.tv_sec) * 1e3
-                                        + (cur_time.tv_nsec - last_time.tv_nsec) / 1e6;
-            if(time_elapsed_in_ms > 1) {
-                predicates_lock.unlock();
-                using namespace std::chrono_literals;
-                std::this_thread::sleep_for(1ms);
-                predicates_lock.lock();
-            }
+            // spin, yield, sleep, or block according to the configured polling mode
+            predicates_lock.unlock();
+            polling.on_idle();
         }
-        //Still to do: Clean up deleted predicates
     }
+    dbg_default_debug("SST predicate thread {} wakeup latencies:\n{}",
+                      thread_index, polling.get_wakeup_latencies().to_string());
 }
 
 template <typename DerivedSST>
@@ -155,91 +212,100 @@ void SST<DerivedSST>::put(const std::vector<uint32_t> receiver_ranks, size_t off
 }
 
 template <typename DerivedSST>
-void SST<DerivedSST>::put_with_completion(const std::vector<uint32_t> receiver_ranks, size_t offset, size_t size) {
-    assert(offset + size <= rowLen);
-    unsigned int num_writes_posted = 0;
-    std::vector<bool> posted_write_to(num_members, false);
-
-    const auto tid = std::this_thread::get_id();
-    // get id first
-    uint32_t ce_idx = util::polling_data.get_index(tid);
-
-    util::polling_data.set_waiting(tid);
-#ifdef USE_VERBS_API
-    verbs_sender_ctxt sctxt[receiver_ranks.size()];
-#else
-    lf_sender_ctxt sctxt[receiver_ranks.size()];
-#endif
+void SST<DerivedSST>::put(const std::vector<uint32_t>& receiver_ranks, const SSTWriteBatch& batch) {
+    if(batch.empty()) {
+        return;
+    }
+    const write_range* ranges = batch.data();
     for(auto index : receiver_ranks) {
         // don't write to yourself or a frozen row
         if(index == my_index || row_is_frozen[index]) {
             continue;
         }
-        // perform a remote RDMA write on the owner of the row
-        sctxt[index].set_remote_id(index);
-        sctxt[index].set_ce_idx(ce_idx);
-        res_vec[index]->post_remote_write_with_completion(&sctxt[index], offset, size);
-        posted_write_to[index] = true;
-        num_writes_posted++;
+        if(batch.size() == 1) {
+            res_vec[index]->post_remote_write(ranges[0].offset, ranges[0].size);
+        } else {
+            res_vec[index]->post_remote_writes(ranges, batch.size());
+        }
     }
+}
 
-    // track which nodes respond successfully
-    std::vector<bool> polled_successfully_from(num_members, false);
-
-    std::vector<uint32_t> failed_node_indexes;
+template <typename DerivedSST>
+void SST<DerivedSST>::put_with_completion(const std::vector<uint32_t>& receiver_ranks, size_t offset, size_t size) {
+    assert(offset + size <= rowLen);
+    // Only used by the calling thread, after it has released completion_mutex
+    thread_local std::vector<uint32_t> failed_node_indexes;
+    failed_node_indexes.clear();
+    {
+        std::lock_guard<std::mutex> lock(completion_mutex);
+        posted_write_to.assign(num_members, false);
+        polled_successfully_from.assign(num_members, false);
+        unsigned int num_writes_posted = 0;
 
-    unsigned long start_time_msec;
-    unsigned long cur_time_msec;
-    struct timeval cur_time;
+        const auto tid = std::this_thread::get_id();
+        // get id first
+        uint32_t ce_idx = util::polling_data.get_index(tid);
+        // Completions tagged with an older sequence number are left over from calls that timed out
+        const uint32_t sequence = util::polling_data.next_sequence(tid) & ((1u << (32 - completion_row_bits)) - 1);
 
-    // wait for completions for a while but eventually give up on it
-    gettimeofday(&cur_time, NULL);
-    start_time_msec = (cur_time.tv_sec * 1000) + (cur_time.tv_usec / 1000);
+        util::polling_data.set_waiting(tid);
+        for(auto index : receiver_ranks) {
+            // don't write to yourself, a frozen row, or a row whose context is still in use
+            if(index == my_index || row_is_frozen[index] || completion_pending[index]) {
+                continue;
+            }
+            // perform a remote RDMA write on the owner of the row
+            completion_ctxts[index].set_remote_id((sequence << completion_row_bits) | index);
+            completion_ctxts[index].set_ce_idx(ce_idx);
+            completion_pending[index] = true;
+            res_vec[index]->post_remote_write_with_completion(&completion_ctxts[index], offset, size);
+            posted_write_to[index] = true;
+            num_writes_posted++;
+        }
 
-    // poll for a single completion for each write request submitted
-    for(unsigned int index = 0; index < num_writes_posted; ++index) {
-        std::optional<std::pair<int32_t, int32_t>> ce;
+        // wait for completions for a while but eventually give up on it
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(poll_cq_timeout_ms);
 
-        while(true) {
+        // poll for a single completion for each write request submitted
+        unsigned int num_completions = 0;
+        while(num_completions < num_writes_posted) {
             // check if polling result is available
-            ce = util::polling_data.get_completion_entry(tid);
-            if(ce) {
-                break;
-            }
-            gettimeofday(&cur_time, NULL);
-            cur_time_msec = (cur_time.tv_sec * 1000) + (cur_time.tv_usec / 1000);
-            if((cur_time_msec - start_time_msec) >= poll_cq_timeout_ms) {
-                break;
-            }
-        }
-        // if waiting for a completion entry timed out
-        if(!ce) {
-            // mark all nodes that have not yet responded as failed
-            for(unsigned int index2 = 0; index2 < num_members; ++index2) {
-                if(!posted_write_to[index2] || polled_successfully_from[index2]) {
+            std::optional<std::pair<int32_t, int32_t>> ce = util::polling_data.get_completion_entry(tid);
+            if(!ce) {
+                if(std::chrono::steady_clock::now() < deadline) {
                     continue;
                 }
-                failed_node_indexes.push_back(index2);
+                // mark all nodes that have not yet responded as failed
+                for(unsigned int index = 0; index < num_members; ++index) {
+                    if(!posted_write_to[index] || polled_successfully_from[index]) {
+                        continue;
+                    }
+                    failed_node_indexes.push_back(index);
+                }
+                break;
             }
-            break;
-        }
 
-        auto ce_v = ce.value();
-        int remote_id = ce_v.first;
-        int result = ce_v.second;
-        if(result == 1) {
+            const uint32_t tag = static_cast<uint32_t>(ce->first);
+            const uint32_t remote_id = tag & ((1u << completion_row_bits) - 1);
+            if((tag >> completion_row_bits) != sequence || remote_id >= num_members
+               || !posted_write_to[remote_id] || polled_successfully_from[remote_id]) {
+                // A late completion from an earlier call, possibly on another SST
+                continue;
+            }
+            completion_pending[remote_id] = false;
             polled_successfully_from[remote_id] = true;
-        } else if(result == -1) {
-            if(!row_is_frozen[index]) {
+            num_completions++;
+            if(ce->second == -1 && !row_is_frozen[remote_id]) {
                 failed_node_indexes.push_back(remote_id);
             }
         }
-    }
 
-    util::polling_data.reset_waiting(tid);
+        util::polling_data.reset_waiting(tid);
+    }
 
-    for(auto index : failed_node_indexes) {
-        freeze(index);
+    // Index instead of iterating, in case a failure upcall reenters this function
+    for(std::size_t i = 0; i < failed_node_indexes.size(); ++i) {
+        freeze(failed_node_indexes[i]);
     }
 }
 
@@ -284,7 +350,7 @@ void SST<DerivedSST>::sync_with_members() const {
  * Same as before but syncs with only a subset of the members
  */
 template <typename DerivedSST>
-void SST<DerivedSST>::sync_with_members(std::vector<uint32_t> row_indices) const {
+void SST<DerivedSST>::sync_with_members(const std::vector<uint32_t>& row_indices) const {
     for(auto const& row_index : row_indices) {
         if(row_index == my_index) {
             continue;
@@ -11,6 +11,11 @@
 #include <atomic>
 #include <infiniband/verbs.h>
 #include <derecho/core/derecho_type_definitions.hpp>
+#include <cstddef>
+#include <memory>
+
+#include "shm.hpp"
+#include "write_range.hpp"
 
 namespace sst {
 
@@ -69,8 +74,12 @@ private:
 
 protected:
     std::atomic<bool> remote_failed;
+    /** The shared-memory connection to the remote node, if it is on this host; otherwise null. */
+    std::unique_ptr<shm_peer> shm;
     /** Post a remote RDMA operation. */
     int post_remote_send(verbs_sender_ctxt* sctxt, const long long int offset, const long long int size, const int op, const bool completion);
+    /** Post a list of RDMA writes, without completion, as one chained work request list. */
+    int post_remote_write_list(const write_range* writes, const std::size_t num_writes);
 
 public:
     /** Index of the remote node. */
@@ -97,10 +106,12 @@ public:
     /** context for the polling thread */
     verbs_sender_ctxt without_completion_sender_ctxt;
 
-    /** Constructor; initializes Queue Pair, Memory Regions, and `remote_props`.
+    /** Constructor; initializes Queue Pair, Memory Regions, and `remote_props`,
+     * unless allow_shm is true and the remote node can be reached through
+     * shared memory instead.
      */
     _resources(int r_index, char *write_addr, char *read_addr, int size_w,
-               int size_r);
+               int size_r, bool allow_shm = true);
     /** Destroys the resources. */
     virtual ~_resources();
 };
@@ -126,6 +137,12 @@ public:
     void post_remote_write(const long long int size);
     /** Post an RDMA write at an offset into remote memory. */
     void post_remote_write(const long long int offset, long long int size);
+    /**
+     * Post several RDMA writes at once. The writes are chained into a single
+     * work request list, so the NIC is notified once for the whole list
+     * instead of once per write, and they are performed in list order.
+     */
+    void post_remote_writes(const write_range* writes, const std::size_t num_writes);
     /** Post an RDMA write at the beginning address of remote memory, and also request a completion event for it. */
     void post_remote_write_with_completion(verbs_sender_ctxt* sctxt, const long long int size);
     /** Post an RDMA write at an offset into remote memory, and also request a completion event for it. */
@@ -0,0 +1,19 @@
+#pragma once
+
+/**
+ * @file write_range.hpp
+ * The description of one RDMA write, shared by the verbs and libfabric
+ * resources classes so that a list of writes can be posted at once.
+ */
+
+namespace sst {
+
+/** A contiguous range of the local row to write to the same range of a remote row. */
+struct write_range {
+    /** The offset, in bytes, from the start of the row. */
+    long long int offset;
+    /** The number of bytes to write. */
+    long long int size;
+};
+
+}  // namespace sst
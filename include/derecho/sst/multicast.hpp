@@ -2,6 +2,7 @@
 #include <chrono>
 #include <cstdlib>
 #include <ctime>
+#include <deque>
 #include <functional>
 #include <iostream>
 #include <map>
@@ -12,8 +13,35 @@
 #include "sst.hpp"
 
 namespace sst {
+/**
+ * The interface of multicast_group that does not depend on the type of the
+ * SST holding its columns, so that groups whose columns live in different
+ * SST types can be kept side by side.
+ */
+class multicast_group_base {
+public:
+    virtual ~multicast_group_base() = default;
+    virtual volatile char* get_buffer(uint64_t msg_size) = 0;
+    /**
+     * Makes send() push only the first size bytes of the slot most recently
+     * returned by get_buffer(), instead of the whole slot.
+     */
+    virtual void set_push_size(uint64_t size) = 0;
+    /**
+     * Lets the oldest num_entries messages' buffer space be reused. Only a
+     * multicast_ring needs to be told; a multicast_group reuses a slot as
+     * soon as every member has received its message.
+     */
+    virtual void release(uint32_t num_entries) = 0;
+    virtual uint32_t commit_send(uint32_t ready_to_be_sent = 1) = 0;
+    virtual void send(uint32_t committed_index, uint32_t ready_to_be_sent = 1,
+                      uint32_t num_nulls_queued = 0, int32_t first_null_index = -1,
+                      size_t header_size = 0) = 0;
+    virtual void debug_print() = 0;
+};
+
 template <typename sstType>
-class multicast_group {
+class multicast_group : public multicast_group_base {
     // number of messages for which get_buffer has been called
     long long int queued_num = -1;
     // the number of messages acknowledged by all the nodes
@@ -48,6 +76,8 @@ class multicast_group {
     const uint32_t window_size;
     // maximum size that the SST can send
     const uint64_t max_msg_size;
+    // number of bytes of each slot that send() pushes
+    std::vector<uint64_t> push_sizes;
 
     std::thread timeout_thread;
 
@@ -83,7 +113,8 @@ public:
               slots_offset(slots_offset),
               num_members(row_indices.size()),
               window_size(window_size),
-              max_msg_size(max_msg_size + sizeof(uint64_t)) {
+              max_msg_size(max_msg_size + sizeof(uint64_t)),
+              push_sizes(window_size, this->max_msg_size) {
         // find my_member_index
         for(uint i = 0; i < num_members; ++i) {
             if(row_indices[i] == my_row) {
@@ -107,7 +138,7 @@ public:
         initialize();
     }
 
-    volatile char* get_buffer(uint64_t msg_size) {
+    volatile char* get_buffer(uint64_t msg_size) override {
         assert(my_sender_index >= 0);
         std::lock_guard<std::mutex> lock(msg_send_mutex);
         assert(msg_size <= max_msg_size);
@@ -115,6 +146,7 @@ public:
             if(queued_num - finished_multicasts_num < window_size) {
                 queued_num++;
                 uint32_t slot = queued_num % window_size;
+                push_sizes[slot] = max_msg_size;
                 // set size appropriately
                 (uint64_t&)sst->slots[my_row][slots_offset + (max_msg_size * (slot + 1)) - sizeof(uint64_t)] = msg_size;
                 return &sst->slots[my_row][slots_offset + (max_msg_size * slot)];
@@ -134,45 +166,46 @@ public:
     }
 
     // In ORDERED MODE, we should hold the lock on msg_state_mtx
-    uint32_t commit_send(uint32_t ready_to_be_sent = 1) {
+    uint32_t commit_send(uint32_t ready_to_be_sent = 1) override {
         return sst->index[my_row][index_offset] += ready_to_be_sent;
     }
 
+    void set_push_size(uint64_t size) override {
+        std::lock_guard<std::mutex> lock(msg_send_mutex);
+        assert(size <= max_msg_size);
+        push_sizes[queued_num % window_size] = size;
+    }
+
+    void release(uint32_t) override {}
+
     // This function invocation should be always preceded by the commit_send,
     // that returns the first parameter (committed index) to be used here.
     void send(uint32_t committed_index, uint32_t ready_to_be_sent = 1,
               uint32_t num_nulls_queued = 0, int32_t first_null_index = -1,
-              size_t header_size = 0) {
-        if(ready_to_be_sent == 0) {
-            // Push the index
-            sst->put(sst->index, index_offset);
-            return;
-        }
-
-        uint32_t first_slot = (committed_index - ready_to_be_sent + 1) % window_size;
-        uint64_t size_to_push;
-        if(num_nulls_queued == 0) {
-            uint32_t last_slot = std::min(first_slot + ready_to_be_sent - 1, window_size - 1);
-            size_to_push = (last_slot - first_slot + 1) * max_msg_size;
-            ready_to_be_sent -= last_slot - first_slot + 1;
-        } else {
-            uint32_t first_null_slot = first_null_index % window_size;
-            if(first_null_slot < first_slot) {
-                size_to_push = (window_size - first_slot) * max_msg_size;
-                ready_to_be_sent -= window_size - first_slot;
+              size_t header_size = 0) override {
+        // Adjacent slots merge into a single write, and the index goes last,
+        // behind a fence, so receivers never see it before the slots it covers
+        SSTWriteBatch batch = sst->make_write_batch();
+        const long long int slots_start = (char*)std::addressof(sst->slots[0][slots_offset]) - sst->getBaseAddress();
+        for(uint32_t slot_num = committed_index - ready_to_be_sent + 1; ready_to_be_sent > 0; --ready_to_be_sent) {
+            const uint32_t slot = slot_num % window_size;
+            if(num_nulls_queued > 0 && slot_num == static_cast<uint32_t>(first_null_index)) {
+                // Only the first of a run of nulls is written; its header counts the rest
+                batch.add(slots_start + max_msg_size * slot, header_size);
+                slot_num += num_nulls_queued;
+                ready_to_be_sent -= num_nulls_queued - 1;
             } else {
-                size_to_push = (first_null_slot - first_slot) * max_msg_size + header_size;
-                ready_to_be_sent -= first_null_slot - first_slot + num_nulls_queued;
-                num_nulls_queued = 0;
+                batch.add(slots_start + max_msg_size * slot, push_sizes[slot]);
+                slot_num++;
             }
         }
-        sst->put((char*)std::addressof(sst->slots[0][slots_offset + max_msg_size * first_slot]) - sst->getBaseAddress(),
-                 size_to_push);
-        send(committed_index, ready_to_be_sent, num_nulls_queued,
-             first_null_index, header_size);
+        batch.fence();
+        batch.add(sst->index, index_offset);
+        // Only the group's own rows read the slots, so don't push them anywhere else
+        sst->put(row_indices, batch);
     }
 
-    void debug_print() {
+    void debug_print() override {
         using std::cout;
         using std::endl;
         cout << "Printing slots::size" << endl;
@@ -192,4 +225,167 @@ public:
         cout << endl;
     }
 };
+
+/** Precedes each message in a multicast_ring. */
+struct __attribute__((__packed__)) ring_entry_header {
+    /** The size of the message that follows, or wrap_marker */
+    uint32_t size;
+    /** Says that the next entry starts at the beginning of the ring. */
+    static constexpr uint32_t wrap_marker = 0xffffffff;
+};
+
+/** The number of bytes a message of msg_size bytes takes in a multicast_ring. */
+inline uint64_t ring_entry_size(uint64_t msg_size) {
+    const uint64_t unpadded = sizeof(ring_entry_header) + msg_size;
+    return (unpadded + sizeof(ring_entry_header) - 1) / sizeof(ring_entry_header) * sizeof(ring_entry_header);
+}
+
+/**
+ * Reads the multicast_ring entry at position pos of a ring of ring_size bytes,
+ * following a wrap marker if there is one there.
+ * @param ring The start of the ring in the sender's row
+ * @param pos The position of the entry, counting every byte ever written to
+ * the ring; advanced to the position of the next entry
+ * @param size Set to the size of the entry's message
+ * @return A pointer to the entry's message
+ */
+inline volatile char* read_ring_entry(volatile char* ring, uint64_t ring_size, uint64_t& pos, uint32_t& size) {
+    size = ((ring_entry_header*)(ring + pos % ring_size))->size;
+    if(size == ring_entry_header::wrap_marker) {
+        pos += ring_size - pos % ring_size;
+        size = ((ring_entry_header*)ring)->size;
+    }
+    volatile char* msg = ring + pos % ring_size + sizeof(ring_entry_header);
+    pos += ring_entry_size(size);
+    return msg;
+}
+
+/**
+ * A multicast group whose messages are appended one after another to a byte
+ * ring in each sender's row, instead of each taking a slot of the maximum
+ * message size, so that flow control is in bytes and the SST memory needed
+ * does not grow with the maximum message size. Each entry is a
+ * ring_entry_header followed by the message, padded to a multiple of
+ * sizeof(ring_entry_header); an entry that would run past the end of the ring
+ * starts again at the beginning, after a wrap marker.
+ *
+ * The index column counts entries, as it counts slots in a multicast_group.
+ * Receivers may keep pointing into the ring after they have received a
+ * message, so space is only reused once the owner of the group calls
+ * release().
+ */
+template <typename sstType>
+class multicast_ring : public multicast_group_base {
+    // row of the node in the sst
+    const uint32_t my_row;
+
+    // SST
+    std::shared_ptr<sstType> sst;
+
+    // rows indices
+    const std::vector<uint32_t> row_indices;
+
+    // start indexes for sst fields it uses
+    const uint32_t index_offset;
+    const uint32_t slots_offset;
+
+    // size of the ring in bytes
+    const uint64_t ring_size;
+
+    // guards the state below, which send() shares with get_buffer() and release()
+    std::mutex ring_mutex;
+    // positions count every byte ever written to the ring
+    // position of the next entry
+    uint64_t write_pos = 0;
+    // position before which the ring may be overwritten
+    uint64_t release_pos = 0;
+    // number of entries released
+    long long int released_num = -1;
+    // end positions of the entries that have not been released, oldest first
+    std::deque<uint64_t> entry_ends;
+    // position up to which the ring has been pushed; only send() uses it
+    uint64_t push_pos = 0;
+
+public:
+    multicast_ring(std::shared_ptr<sstType> sst,
+                   std::vector<uint32_t> row_indices,
+                   uint64_t ring_size,
+                   uint32_t slots_offset = 0,
+                   int32_t index_offset = 0)
+            : my_row(sst->get_local_index()),
+              sst(sst),
+              row_indices(row_indices),
+              index_offset(index_offset),
+              slots_offset(slots_offset),
+              ring_size(ring_size / sizeof(ring_entry_header) * sizeof(ring_entry_header)) {}
+
+    volatile char* get_buffer(uint64_t msg_size) override {
+        std::lock_guard<std::mutex> lock(ring_mutex);
+        const uint64_t entry_size = ring_entry_size(msg_size);
+        assert(entry_size <= ring_size);
+        uint64_t start = write_pos;
+        if(start % ring_size + entry_size > ring_size) {
+            start += ring_size - start % ring_size;
+        }
+        if(start + entry_size - release_pos > ring_size) {
+            return nullptr;
+        }
+        volatile char* ring = &sst->slots[my_row][slots_offset];
+        if(start != write_pos) {
+            ((ring_entry_header*)(ring + write_pos % ring_size))->size = ring_entry_header::wrap_marker;
+        }
+        ((ring_entry_header*)(ring + start % ring_size))->size = msg_size;
+        write_pos = start + entry_size;
+        entry_ends.push_back(write_pos);
+        return ring + start % ring_size + sizeof(ring_entry_header);
+    }
+
+    void set_push_size(uint64_t) override {}
+
+    void release(uint32_t num_entries) override {
+        std::lock_guard<std::mutex> lock(ring_mutex);
+        assert(num_entries <= entry_ends.size());
+        if(num_entries == 0) {
+            return;
+        }
+        release_pos = entry_ends[num_entries - 1];
+        entry_ends.erase(entry_ends.begin(), entry_ends.begin() + num_entries);
+        released_num += num_entries;
+    }
+
+    uint32_t commit_send(uint32_t ready_to_be_sent = 1) override {
+        return sst->index[my_row][index_offset] += ready_to_be_sent;
+    }
+
+    // Like multicast_group::send, but there are no null runs to skip: every
+    // null is an entry of its own
+    void send(uint32_t committed_index, uint32_t ready_to_be_sent = 1,
+              uint32_t = 0, int32_t = -1, size_t = 0) override {
+        SSTWriteBatch batch = sst->make_write_batch();
+        if(ready_to_be_sent > 0) {
+            uint64_t end;
+            {
+                std::lock_guard<std::mutex> lock(ring_mutex);
+                end = entry_ends[static_cast<long long int>(committed_index) - released_num - 1];
+            }
+            const long long int ring_start = (char*)std::addressof(sst->slots[0][slots_offset]) - sst->getBaseAddress();
+            while(push_pos < end) {
+                const uint64_t size = std::min(end - push_pos, ring_size - push_pos % ring_size);
+                batch.add(ring_start + push_pos % ring_size, size);
+                push_pos += size;
+            }
+        }
+        batch.fence();
+        batch.add(sst->index, index_offset);
+        // Only the group's own rows read the ring, so don't push it anywhere else
+        sst->put(row_indices, batch);
+    }
+
+    void debug_print() override {
+        std::lock_guard<std::mutex> lock(ring_mutex);
+        std::cout << "Ring of " << ring_size << " bytes: write position " << write_pos
+                  << ", release position " << release_pos << ", push position " << push_pos
+                  << ", " << entry_ends.size() << " unreleased entries" << std::endl;
+    }
+};
 }  // namespace sst
@@ -1,11 +1,18 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
 #include <functional>
 #include <list>
+#include <memory>
 #include <mutex>
+#include <thread>
 #include <utility>
+#include <vector>
 
+#include "detail/inline_function.hpp"
 
 namespace sst {
 
@@ -26,122 +33,279 @@ enum class PredicateType {
 
 template <class DerivedSST>
 class Predicates {
-    using pred = std::function<bool(const DerivedSST&)>;
+    using pred = util::inline_function<bool(const DerivedSST&)>;
     using trig = std::function<void(DerivedSST&)>;
-    using pred_list = std::list<std::unique_ptr<std::pair<pred, std::shared_ptr<trig>>>>;
-    /** Predicate list for one-time predicates. */
-    pred_list one_time_predicates;
-    /** Predicate list for recurrent predicates */
-    pred_list recurrent_predicates;
-    /** Predicate list for transition predicates */
-    pred_list transition_predicates;
-    /** Contains one entry for every predicate in `transition_predicates`, in parallel. */
-    std::list<bool> transition_predicate_states;
-    // SST needs to read these predicate lists directly
-    friend class SST<DerivedSST>;
 
-    std::mutex predicate_mutex;
+    /**
+     * One row of a predicate table. The predicate is stored inline so that
+     * evaluating a table only walks a contiguous array; the trigger is only
+     * needed when the predicate fires, so it stays behind a shared_ptr that
+     * the evaluation thread can copy before releasing the predicate lock.
+     */
+    struct pred_entry {
+        /** Identifier handed out to pred_handles; increases with insertion order. */
+        uint64_t id;
+        pred predicate;
+        std::shared_ptr<trig> trigger;
+        /** False once the entry has been removed (a tombstone awaiting compaction). */
+        bool live;
+        /** For transition predicates, the value of the predicate at the last evaluation. */
+        bool last_state;
+
+        pred_entry(uint64_t id, pred&& predicate, std::shared_ptr<trig> trigger)
+                : id(id),
+                  predicate(std::move(predicate)),
+                  trigger(std::move(trigger)),
+                  live(true),
+                  last_state(false) {}
+    };
+
+    /**
+     * A flat table of predicates of one type. Entries are never erased while
+     * the evaluation loop may be iterating over the table; removed entries are
+     * marked as tombstones, and compact() erases them in bulk.
+     */
+    struct pred_table {
+        std::vector<pred_entry> entries;
+        std::size_t num_tombstones = 0;
+
+        /** Finds the entry with the given ID, or returns nullptr if it has been compacted away. */
+        pred_entry* find(uint64_t id) {
+            auto entry_iter = std::lower_bound(entries.begin(), entries.end(), id,
+                                               [](const pred_entry& entry, uint64_t id) {
+                                                   return entry.id < id;
+                                               });
+            if(entry_iter == entries.end() || entry_iter->id != id) {
+                return nullptr;
+            }
+            return &(*entry_iter);
+        }
+
+        /** Marks an entry as deleted and releases its predicate and trigger. */
+        void kill(pred_entry& entry) {
+            if(!entry.live) {
+                return;
+            }
+            entry.live = false;
+            entry.predicate.reset();
+            entry.trigger.reset();
+            ++num_tombstones;
+        }
+
+        /** True if enough of the table is tombstones that it is worth compacting. */
+        bool needs_compaction() const {
+            return num_tombstones > 0 && num_tombstones * 4 >= entries.size();
+        }
+
+        /** Erases all tombstones. Insertion order (and hence ID order) is preserved. */
+        void compact() {
+            entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                         [](const pred_entry& entry) { return !entry.live; }),
+                          entries.end());
+            num_tombstones = 0;
+        }
+    };
+
+    /**
+     * A set of predicate tables that is evaluated by a single thread. All the
+     * predicates in one partition are evaluated (and their triggers run) in
+     * insertion order by the same thread, so predicates whose triggers must
+     * not run concurrently with each other should share a partition.
+     */
+    struct pred_partition {
+        /** Predicate table for one-time predicates. */
+        pred_table one_time_predicates;
+        /** Predicate table for recurrent predicates */
+        pred_table recurrent_predicates;
+        /** Predicate table for transition predicates */
+        pred_table transition_predicates;
+        /** Guards the tables and the trigger-tracking fields below. */
+        std::mutex predicate_mutex;
+        /** True while the evaluation thread is running a trigger with the predicate lock released. */
+        bool trigger_running = false;
+        /** The ID of the predicate whose trigger is running, if trigger_running is true. */
+        uint64_t running_predicate_id = 0;
+        /** Notified each time the evaluation thread finishes running a trigger. */
+        std::condition_variable trigger_finished;
+        /** The ID of the thread that evaluates this partition. */
+        std::thread::id evaluator_id;
+
+        pred_table& table_for(PredicateType type) {
+            switch(type) {
+                case PredicateType::ONE_TIME:
+                    return one_time_predicates;
+                case PredicateType::RECURRENT:
+                    return recurrent_predicates;
+                default:
+                    return transition_predicates;
+            }
+        }
+
+        /**
+         * Erases tombstones from any table that has accumulated enough of them.
+         * Must be called with predicate_mutex held, and only from the thread that
+         * evaluates this partition, between evaluation passes.
+         */
+        void compact_tables() {
+            for(pred_table* table : {&one_time_predicates, &recurrent_predicates, &transition_predicates}) {
+                if(table->needs_compaction()) {
+                    table->compact();
+                }
+            }
+        }
+    };
+
+    /** One partition per predicate evaluation thread; the number is fixed at construction. */
+    std::vector<std::unique_ptr<pred_partition>> partitions;
+    /** The ID to assign to the next inserted predicate. */
+    std::atomic<uint64_t> next_predicate_id;
+    // SST needs to read these predicate tables directly
+    friend class SST<DerivedSST>;
 
 public:
     class pred_handle {
-        bool valid;
-        typename pred_list::iterator iter;
+        Predicates* owner;
+        uint64_t id;
         PredicateType type;
+        uint32_t partition;
         friend class Predicates;
 
     public:
-        pred_handle() : valid(false), type(PredicateType::ONE_TIME) {}
-        pred_handle(typename pred_list::iterator iter, PredicateType type)
-                : valid{true}, iter{iter}, type{type} {}
+        pred_handle() : owner(nullptr), id(0), type(PredicateType::ONE_TIME), partition(0) {}
+        pred_handle(Predicates* owner, uint64_t id, PredicateType type, uint32_t partition)
+                : owner(owner), id(id), type(type), partition(partition) {}
         pred_handle(pred_handle&) = delete;
         pred_handle(pred_handle&& other)
-                : pred_handle(std::move(other.iter), other.type) {
-            other.valid = false;
+                : pred_handle(other.owner, other.id, other.type, other.partition) {
+            other.owner = nullptr;
         }
         pred_handle& operator=(pred_handle&) = delete;
         pred_handle& operator=(pred_handle&& other) {
-            iter = std::move(other.iter);
+            owner = other.owner;
+            id = other.id;
             type = other.type;
-            valid = true;
-            other.valid = false;
+            partition = other.partition;
+            other.owner = nullptr;
             return *this;
         }
         bool is_valid() const {
-            return valid && (*iter);
+            return owner && owner->is_live(id, type, partition);
         }
     };
 
-    /** Inserts a single (predicate, trigger) pair to the appropriate predicate list. */
+    /**
+     * Constructs an empty set of predicates.
+     * @param num_partitions The number of partitions to divide predicates
+     * into, which should equal the number of threads that will evaluate them.
+     */
+    explicit Predicates(uint32_t num_partitions = 1) : next_predicate_id(0) {
+        for(uint32_t i = 0; i < std::max(num_partitions, 1u); ++i) {
+            partitions.emplace_back(std::make_unique<pred_partition>());
+        }
+    }
+
+    /** Returns the number of partitions (and hence evaluation threads) predicates are divided into. */
+    uint32_t num_partitions() const { return partitions.size(); }
+
+    /**
+     * Inserts a single (predicate, trigger) pair to the appropriate predicate list.
+     * @param partition The partition (evaluation thread) the predicate should
+     * belong to; taken modulo num_partitions(). Partition 0 is the default.
+     */
     pred_handle insert(pred predicate, trig trigger,
-                       PredicateType type = PredicateType::ONE_TIME);
+                       PredicateType type = PredicateType::ONE_TIME,
+                       uint32_t partition = 0);
 
     /** Inserts a predicate with a list of triggers (which will be run in
      * sequence) to the appropriate predicate list. */
     pred_handle insert(pred predicate, const std::list<trig>& triggers,
-                       PredicateType type = PredicateType::ONE_TIME) {
-        return insert(predicate, [triggers](DerivedSST& t) {
+                       PredicateType type = PredicateType::ONE_TIME,
+                       uint32_t partition = 0) {
+        return insert(std::move(predicate), [triggers](DerivedSST& t) {
             for(const auto& trigger : triggers)
                 trigger(t);
         },
-                      type);
+                      type, partition);
     }
 
-    /** Removes a (predicate, trigger) pair previously registered with insert(). */
+    /**
+     * Removes a (predicate, trigger) pair previously registered with insert().
+     * If the predicate's trigger is currently running on another thread, this
+     * waits for it to finish, so once remove() returns the trigger will not
+     * be running and will never run again.
+     */
     void remove(pred_handle& pred);
 
-    /** Deletes all predicates, including evolvers and their triggers. */
+    /** Deletes all predicates, including evolvers and their triggers. Does not wait for running triggers. */
     void clear();
+
+private:
+    /** Returns true if the predicate with this ID has neither been removed nor (for one-time predicates) fired. */
+    bool is_live(uint64_t id, PredicateType type, uint32_t partition);
 };
 
 /**
  * This is a convenience method for when the predicate has only one trigger; it
  * automatically chooses the right list based on the predicate type. To insert
- * a predicate with multiple triggers, use std::list::insert() directly on the
- * appropriate predicate list member.
+ * a predicate with multiple triggers, use the overload that takes a
+ * std::list of triggers.
  * @param predicate The predicate to insert.
  * @param trigger The trigger to execute when the predicate is true.
  * @param type The type of predicate being inserted; default is
  * PredicateType::ONE_TIME
  */
 template <class DerivedSST>
-auto Predicates<DerivedSST>::insert(pred predicate, trig trigger, PredicateType type) -> pred_handle {
-    std::lock_guard<std::mutex> lock(predicate_mutex);
-    if(type == PredicateType::ONE_TIME) {
-        one_time_predicates.push_back(std::make_unique<std::pair<pred, std::shared_ptr<trig>>>(
-                predicate, std::make_shared<trig>(trigger)));
-        return pred_handle(--one_time_predicates.end(), type);
-    } else if(type == PredicateType::RECURRENT) {
-        recurrent_predicates.push_back(std::make_unique<std::pair<pred, std::shared_ptr<trig>>>(
-                predicate, std::make_shared<trig>(trigger)));
-        return pred_handle(--recurrent_predicates.end(), type);
-    } else {
-        transition_predicates.push_back(std::make_unique<std::pair<pred, std::shared_ptr<trig>>>(
-                predicate, std::make_shared<trig>(trigger)));
-        transition_predicate_states.push_back(false);
-        return pred_handle(--transition_predicates.end(), type);
-    }
+auto Predicates<DerivedSST>::insert(pred predicate, trig trigger, PredicateType type,
+                                    uint32_t partition) -> pred_handle {
+    partition %= partitions.size();
+    pred_partition& part = *partitions[partition];
+    std::lock_guard<std::mutex> lock(part.predicate_mutex);
+    const uint64_t id = next_predicate_id++;
+    part.table_for(type).entries.emplace_back(id, std::move(predicate),
+                                              std::make_shared<trig>(std::move(trigger)));
+    return pred_handle(this, id, type, partition);
 }
 
 template <class DerivedSST>
 void Predicates<DerivedSST>::remove(pred_handle& handle) {
-    std::lock_guard<std::mutex> lock(predicate_mutex);
-    if(!handle.is_valid()) {
+    if(handle.owner != this) {
         return;
     }
-    handle.iter->reset();
-    handle.valid = false;
+    pred_partition& part = *partitions[handle.partition];
+    std::unique_lock<std::mutex> lock(part.predicate_mutex);
+    pred_table& table = part.table_for(handle.type);
+    pred_entry* entry = table.find(handle.id);
+    if(entry) {
+        table.kill(*entry);
+    }
+    // A trigger that removes its own predicate must not wait for itself
+    if(std::this_thread::get_id() != part.evaluator_id) {
+        const uint64_t id = handle.id;
+        part.trigger_finished.wait(lock, [&part, id]() {
+            return !part.trigger_running || part.running_predicate_id != id;
+        });
+    }
+    handle.owner = nullptr;
 }
 
 template <class DerivedSST>
 void Predicates<DerivedSST>::clear() {
-    std::lock_guard<std::mutex> lock(predicate_mutex);
-    using ptr_to_pred = std::unique_ptr<std::pair<pred, std::shared_ptr<trig>>>;
-    std::for_each(one_time_predicates.begin(), one_time_predicates.end(),
-                  [](ptr_to_pred& ptr) { ptr.reset(); });
-    std::for_each(recurrent_predicates.begin(), recurrent_predicates.end(),
-                  [](ptr_to_pred& ptr) { ptr.reset(); });
-    std::for_each(transition_predicates.begin(), transition_predicates.end(),
-                  [](ptr_to_pred& ptr) { ptr.reset(); });
+    for(auto& part : partitions) {
+        std::lock_guard<std::mutex> lock(part->predicate_mutex);
+        for(pred_table* table : {&part->one_time_predicates, &part->recurrent_predicates, &part->transition_predicates}) {
+            for(pred_entry& entry : table->entries) {
+                table->kill(entry);
+            }
+        }
+    }
+}
+
+template <class DerivedSST>
+bool Predicates<DerivedSST>::is_live(uint64_t id, PredicateType type, uint32_t partition) {
+    pred_partition& part = *partitions[partition];
+    std::lock_guard<std::mutex> lock(part.predicate_mutex);
+    pred_entry* entry = part.table_for(type).find(id);
+    return entry && entry->live;
 }
 
 } /* namespace sst */
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <atomic>
 #include <bitset>
 #include <cassert>
@@ -9,15 +11,18 @@
 #include <list>
 #include <memory>
 #include <mutex>
+#include <new>
 #include <numeric>
 #include <stdexcept>
 #include <string.h>
 #include <string>
 #include <thread>
+#include <type_traits>
 #include <vector>
 
 #include "predicates.hpp"
 #include <derecho/conf/conf.hpp>
+#include <derecho/utils/polling_policy.hpp>
 
 #ifdef USE_VERBS_API
 #include "detail/verbs.hpp"
@@ -27,6 +32,13 @@
 
 using sst::resources;
 
+/**
+ * Initializes an SST's fields, like SSTInit, and records each field's name as
+ * written in the argument list, so the names shown by layout_to_string()
+ * always match the order of the fields.
+ */
+#define SST_INIT_NAMED(...) SSTInitNamed(#__VA_ARGS__, __VA_ARGS__)
+
 namespace sst {
 
 // strongly assumes that no counter in the SST row
@@ -37,18 +49,53 @@ constexpr size_t padded_len(const size_t& len) {
     return (len <= alignTo) ? alignTo : (len + alignTo) & ~(alignTo - 1);
 }
 
+/** The size of a cache line, which HOT fields are aligned and padded to. */
+constexpr size_t CACHE_LINE_SIZE = 64;
+
+constexpr size_t round_up_to_cache_line(const size_t& len) {
+    return (len + CACHE_LINE_SIZE - 1) & ~(CACHE_LINE_SIZE - 1);
+}
+
+/**
+ * How often a field is written, which decides where the SST row layout places
+ * it. Fields keep their declaration order either way, so code that relies on
+ * one field preceding another (or on a run of fields being contiguous) is not
+ * affected by the access class.
+ */
+enum class FieldAccess {
+    /** Rarely written; packed right after the previous field. This is the default. */
+    COLD,
+    /**
+     * Written constantly; starts on a cache line boundary and is padded to a
+     * whole number of cache lines, so local writes to it and NIC writes to
+     * the fields around it never touch the same line.
+     */
+    HOT
+};
+
 /** Internal helper class, never exposed to the client. */
 class _SSTField {
 public:
     volatile char* base;
     size_t rowLen;
     size_t field_len;
+    FieldAccess access;
+
+    _SSTField(const size_t field_len, FieldAccess access = FieldAccess::COLD)
+            : base(nullptr), rowLen(0), field_len(field_len), access(access) {}
+
+    /** Returns the offset within the row at which this field starts, if the previous field ended at offset. */
+    size_t layout_offset(const size_t offset) const {
+        return access == FieldAccess::HOT ? round_up_to_cache_line(offset) : offset;
+    }
 
-    _SSTField(const size_t field_len) : base(nullptr), rowLen(0), field_len(field_len) {}
+    /** Returns the number of bytes this field occupies in the row, including padding. */
+    size_t layout_len() const {
+        return access == FieldAccess::HOT ? round_up_to_cache_line(field_len) : padded_len(field_len);
+    }
 
-    size_t set_base(volatile char* const base) {
+    void set_base(volatile char* const base) {
         this->base = base;
-        return padded_len(field_len);
     }
 
     char* get_base() {
@@ -71,7 +118,7 @@ public:
     using _SSTField::field_len;
     using _SSTField::rowLen;
 
-    SSTField() : _SSTField(sizeof(T)) {
+    SSTField(FieldAccess access = FieldAccess::COLD) : _SSTField(sizeof(T), access) {
     }
 
     // Tracks down the appropriate row
@@ -104,7 +151,8 @@ public:
     using _SSTField::rowLen;
     using value_type = T;
 
-    SSTFieldVector(size_t num_elements) : _SSTField(num_elements * sizeof(T)), length(num_elements) {
+    SSTFieldVector(size_t num_elements, FieldAccess access = FieldAccess::COLD)
+            : _SSTField(num_elements * sizeof(T), access), length(num_elements) {
     }
 
     // Tracks down the appropriate row
@@ -122,6 +170,122 @@ public:
     }
 };
 
+/** A binary operation for SST::reduce() that computes the minimum of a column. */
+struct reduce_min {
+    template <typename T>
+    T operator()(const T a, const T b) const { return b < a ? b : a; }
+};
+
+/** A binary operation for SST::reduce() that computes the maximum of a column. */
+struct reduce_max {
+    template <typename T>
+    T operator()(const T a, const T b) const { return a < b ? b : a; }
+};
+
+/**
+ * A set of byte ranges of the local SST row that should be pushed to remote
+ * rows together. Callers mark the fields they changed with add(), then pass
+ * the batch to SST::put(), which posts one chained list of writes per remote
+ * node. A range that overlaps or is adjacent to the one added just before it
+ * is merged into it, and RDMA does not order the bytes within one write, so
+ * ranges merged together may become visible in any order. Ranges that stay
+ * separate are written, and become visible, in the order they were added.
+ * When a field must not be seen before the fields added ahead of it (like a
+ * counter that announces new data), call fence() before adding it, which
+ * keeps it out of any earlier range.
+ */
+class SSTWriteBatch {
+    /** Batches with up to this many (merged) ranges do not allocate. */
+    static constexpr std::size_t INLINE_CAPACITY = 8;
+    /** The base address of the SST, which field offsets are relative to. */
+    const char* sst_base;
+    std::size_t num_ranges;
+    /** True if the next range must not be merged into the last one */
+    bool fenced;
+    std::array<write_range, INLINE_CAPACITY> inline_ranges;
+    /** Holds all the ranges instead of inline_ranges once there are too many. */
+    std::vector<write_range> overflow_ranges;
+
+    write_range* ranges() {
+        return overflow_ranges.empty() ? inline_ranges.data() : overflow_ranges.data();
+    }
+
+public:
+    /** Creates an empty batch for the SST whose rows start at sst_base (see SST::getBaseAddress()). */
+    explicit SSTWriteBatch(const char* sst_base) : sst_base(sst_base), num_ranges(0), fenced(false) {}
+
+    /** Marks a contiguous range of the local row, given by its offset from the start of the row. */
+    void add(long long int offset, long long int size) {
+        if(size <= 0) {
+            return;
+        }
+        if(num_ranges > 0 && !fenced) {
+            write_range& last = ranges()[num_ranges - 1];
+            if(offset <= last.offset + last.size && offset + size >= last.offset) {
+                const long long int end = std::max(last.offset + last.size, offset + size);
+                last.offset = std::min(last.offset, offset);
+                last.size = end - last.offset;
+                return;
+            }
+        }
+        if(num_ranges < INLINE_CAPACITY) {
+            inline_ranges[num_ranges] = write_range{offset, size};
+        } else {
+            if(overflow_ranges.empty()) {
+                overflow_ranges.assign(inline_ranges.begin(), inline_ranges.end());
+            }
+            overflow_ranges.push_back(write_range{offset, size});
+        }
+        ++num_ranges;
+        fenced = false;
+    }
+
+    /**
+     * Makes the ranges added after this call become visible to remote nodes
+     * only after all the ranges added before it, by never merging across it.
+     */
+    void fence() {
+        fenced = true;
+    }
+
+    /** Marks a whole field. */
+    template <typename T>
+    void add(SSTField<T>& field) {
+        add(field.get_base() - sst_base, sizeof(field[0]));
+    }
+
+    /** Marks a whole vector field. */
+    template <typename T>
+    void add(SSTFieldVector<T>& vec_field) {
+        add(vec_field.get_base() - sst_base, sizeof(vec_field[0][0]) * vec_field.size());
+    }
+
+    /** Marks a contiguous slice of a vector field, starting at index. */
+    template <typename T>
+    void add(SSTFieldVector<T>& vec_field, std::size_t index, std::size_t count = 1) {
+        add(const_cast<char*>(reinterpret_cast<volatile char*>(std::addressof(vec_field[0][index])))
+                    - sst_base,
+            sizeof(vec_field[0][index]) * count);
+    }
+
+    /** Returns the merged ranges, in the order they will be written; there are size() of them. */
+    const write_range* data() const {
+        return overflow_ranges.empty() ? inline_ranges.data() : overflow_ranges.data();
+    }
+
+    /** Returns the number of (merged) ranges in the batch. */
+    std::size_t size() const { return num_ranges; }
+
+    bool empty() const { return num_ranges == 0; }
+
+    /** Removes all ranges so the batch can be reused. */
+    void clear() {
+        num_ranges = 0;
+        fenced = false;
+        overflow_ranges.clear();
+    }
+};
+
 typedef std::function<void(uint32_t)> failure_upcall_t;
 
 /** Constructor parameter pack for SST. */
@@ -131,6 +295,7 @@ struct SSTParams {
     const failure_upcall_t failure_upcall;
     const std::vector<char> already_failed;
     const bool start_predicate_thread;
+    const bool predicate_threads;
 
     /**
      *
@@ -147,17 +312,22 @@ struct SSTParams {
      * should be started immediately on construction of the SST. If false,
      * predicate evaluation will not start until start_predicate_evalution()
      * is called.
+     * @param predicate_threads Whether the SST should have predicate
+     * evaluation threads at all. Tables that never have predicates can set
+     * this to false, and then start_predicate_thread has no effect.
      */
     SSTParams(const std::vector<uint32_t>& _members,
               const uint32_t my_node_id,
               const failure_upcall_t failure_upcall = nullptr,
               const std::vector<char> already_failed = {},
-              const bool start_predicate_thread = true)
+              const bool start_predicate_thread = true,
+              const bool predicate_threads = true)
             : members(_members),
               my_node_id(my_node_id),
               failure_upcall(failure_upcall),
               already_failed(already_failed),
-              start_predicate_thread(start_predicate_thread) {}
+              start_predicate_thread(start_predicate_thread),
+              predicate_threads(predicate_threads) {}
 };
 
 template <class DerivedSST>
@@ -166,19 +336,42 @@ private:
     template <typename... Fields>
     void init_SSTFields(Fields&... fields) {
         rowLen = 0;
-        compute_rowLen(rowLen, fields...);
-        rows = new char[rowLen * num_members];
+        bool has_hot_fields = false;
+        compute_rowLen(rowLen, has_hot_fields, fields...);
+        // Keep every row's hot fields cache-aligned, and keep the last line of
+        // one row from being shared with the first line of the next
+        if(has_hot_fields) {
+            rowLen = round_up_to_cache_line(rowLen);
+        }
+        // Page-aligned (so also cache-aligned), and shareable with co-located members
+        rows = shm_allocate(rowLen * num_members);
         // snapshot = new char[rowLen * num_members];
-        volatile char* base = rows;
-        set_bases_and_rowLens(base, rowLen, fields...);
+        size_t offset = 0;
+        set_bases_and_rowLens(offset, rowLen, fields...);
     }
 
+    /** The placement of one field in the row, recorded for layout_to_string(). */
+    struct field_layout {
+        size_t offset;
+        size_t field_len;
+        size_t padded_len;
+        FieldAccess access;
+    };
+    std::vector<field_layout> row_layout;
+    /** The names of the fields, in row order, if they were given with SST_INIT_NAMED. */
+    std::vector<std::string> field_names;
+
     DerivedSST* derived_this;
 
     std::vector<std::thread> background_threads;
     std::atomic<bool> thread_shutdown;
 
-    void detect();
+    /**
+     * The predicate evaluation loop run by each detector thread.
+     * @param thread_index The index of the detector thread, which is also the
+     * index of the predicate partition it evaluates.
+     */
+    void detect(uint32_t thread_index);
 
 public:
     Predicates<DerivedSST> predicates;
@@ -187,6 +380,10 @@ public:
 private:
     /** timeout settings for poll completion queue */
     const uint32_t poll_cq_timeout_ms;
+    /** Decides how each predicate evaluation thread waits when no predicate fires; indexed by thread. */
+    std::vector<std::unique_ptr<derecho::PollingPolicy>> predicate_polling;
+    /** The CPU cores to pin the predicate evaluation threads to; thread i uses entry i, if it exists. */
+    std::vector<int> predicate_thread_cpus;
     /** Pointer to memory where the SST rows are stored. */
     volatile char* rows;
     // char* snapshot;
@@ -219,6 +416,34 @@ private:
     /** RDMA resources vector, one for each member. */
     std::vector<std::unique_ptr<resources>> res_vec;
 
+#ifdef USE_VERBS_API
+    using sender_ctxt = verbs_sender_ctxt;
+#else
+    using sender_ctxt = lf_sender_ctxt;
+#endif
+    /** The number of low bits of a completion tag that hold the row index; the rest hold the call's sequence number. */
+    static constexpr uint32_t completion_row_bits = 16;
+    /** Serializes put_with_completion, which reuses the members below. */
+    std::mutex completion_mutex;
+    /**
+     * The context of each row's write with completion. They live as long as
+     * the SST, so a completion that arrives after its call timed out still
+     * refers to valid memory.
+     */
+    std::vector<sender_ctxt> completion_ctxts;
+    /**
+     * True for rows whose last write with completion has not completed. Their
+     * contexts may still be read by the polling thread, so they are not
+     * written to again; such rows have timed out and are frozen anyway.
+     */
+    std::vector<bool> completion_pending;
+    /** Scratch space for put_with_completion: the rows written in the current call. */
+    std::vector<bool> posted_write_to;
+    /** Scratch space for put_with_completion: the rows whose writes in the current call completed. */
+    std::vector<bool> polled_successfully_from;
+
+    /** Whether SSTInit starts predicate evaluation threads; false for tables without predicates. */
+    const bool has_predicate_threads;
     /** Indicates whether the predicate evaluation thread should start after being
      * forked in the constructor. */
     bool thread_start;
@@ -231,6 +456,7 @@ public:
     SST(DerivedSST* derived_class_pointer, const SSTParams& params)
             : derived_this(derived_class_pointer),
               thread_shutdown(false),
+              predicates(derecho::getConfUInt32(CONF_DERECHO_SST_PREDICATE_THREADS)),
               poll_cq_timeout_ms(derecho::getConfUInt32(CONF_DERECHO_SST_POLL_CQ_TIMEOUT_MS)),
               members(params.members),
               num_members(members.size()),
@@ -239,7 +465,13 @@ public:
               row_is_frozen(num_members),
               failure_upcall(params.failure_upcall),
               res_vec(num_members),
+              completion_ctxts(num_members),
+              completion_pending(num_members, false),
+              posted_write_to(num_members, false),
+              polled_successfully_from(num_members, false),
+              has_predicate_threads(params.predicate_threads),
               thread_start(params.start_predicate_thread) {
+        assert(num_members <= (1u << completion_row_bits));
         //Figure out my SST index
         my_index = (uint)-1;
         for(uint32_t i = 0; i < num_members; ++i) {
@@ -266,6 +498,35 @@ public:
         for(unsigned int sst_index = 0; sst_index < num_members; ++sst_index) {
             members_by_id[members[sst_index]] = sst_index;
         }
+
+        for(uint32_t thread = 0; thread < predicates.num_partitions(); ++thread) {
+            // PollingPolicy is not movable, so construct it in place
+            predicate_polling.emplace_back(new derecho::PollingPolicy(
+                    derecho::PollingPolicy::from_config("sst")));
+        }
+        for(const std::string& cpu : derecho::split_string(
+                    derecho::getConfString(CONF_DERECHO_SST_PREDICATE_THREAD_CPUS))) {
+            if(!cpu.empty()) {
+                predicate_thread_cpus.emplace_back(std::stoi(cpu));
+            }
+        }
+    }
+
+    /**
+     * Like SSTInit, but also records the names of the fields for
+     * layout_to_string(). Called through SST_INIT_NAMED, which takes the
+     * names from the same argument list as the fields.
+     * @param names The fields' names, separated by commas
+     */
+    template <typename... Fields>
+    void SSTInitNamed(const char* names, Fields&... fields) {
+        SSTInit(fields...);
+        field_names.clear();
+        for(const std::string& name : derecho::split_string(names)) {
+            const std::size_t first = name.find_first_not_of(" \t\n");
+            const std::size_t last = name.find_last_not_of(" \t\n");
+            field_names.push_back(first == std::string::npos ? name : name.substr(first, last - first + 1));
+        }
     }
 
     template <typename... Fields>
@@ -296,8 +557,12 @@ public:
             }
         }
 
-        std::thread detector(&SST::detect, this);
-        background_threads.push_back(std::move(detector));
+        if(has_predicate_threads) {
+            for(uint32_t thread = 0; thread < predicates.num_partitions(); ++thread) {
+                std::thread detector(&SST::detect, this, thread);
+                background_threads.push_back(std::move(detector));
+            }
+        }
     }
 
     ~SST();
@@ -305,11 +570,33 @@ public:
     /** Starts the predicate evaluation loop. */
     void start_predicate_evaluation();
 
+    /**
+     * Wakes up the predicate evaluation threads if they are blocked waiting
+     * for work. Local threads should call this after changing state that a
+     * predicate depends on; it is only needed when the SST polling mode is
+     * spin_wait, and is cheap otherwise.
+     */
+    void notify_predicate_thread() {
+        for(auto& polling : predicate_polling) {
+            polling->notify();
+        }
+    }
+
+    /** Wakes up only the predicate evaluation thread for the given predicate partition. */
+    void notify_predicate_thread(uint32_t partition) {
+        predicate_polling[partition % predicate_polling.size()]->notify();
+    }
+
+    /** Returns the wakeup latencies observed by one of the predicate evaluation threads. */
+    const derecho::LatencyHistogram& get_predicate_wakeup_latencies(uint32_t thread_index = 0) const {
+        return predicate_polling.at(thread_index)->get_wakeup_latencies();
+    }
+
     /** Does a TCP sync with each member of the SST. */
     void sync_with_members() const;
 
     /** Syncs with a subset of the members */
-    void sync_with_members(std::vector<uint32_t> row_indices) const;
+    void sync_with_members(const std::vector<uint32_t>& row_indices) const;
 
     /** Marks a row as frozen, so it will no longer update, and its corresponding
      * node will not receive writes. */
@@ -321,6 +608,19 @@ public:
     /** Gets the index of the local row in the table. */
     unsigned int get_local_index() const { return my_index; }
 
+    /** Returns the length of each row in bytes, including padding. */
+    size_t get_row_length() const { return rowLen; }
+
+    /**
+     * Describes where each field was placed in the row: its offset, size,
+     * padding, access class, and the cache lines it spans. Intended for
+     * debugging the row layout.
+     * @param names Optional names for the fields, in the order they were
+     * passed to SSTInit; if empty, the names recorded by SST_INIT_NAMED are
+     * used. Unnamed fields are shown by their position.
+     */
+    std::string layout_to_string(const std::vector<std::string>& names = {}) const;
+
     const char* getBaseAddress() {
         return const_cast<char*>(rows);
     }
@@ -339,7 +639,7 @@ public:
         put(receiver_ranks, 0, rowLen);
     }
 
-    void put_with_completion(const std::vector<uint32_t> receiver_ranks) {
+    void put_with_completion(const std::vector<uint32_t>& receiver_ranks) {
         put_with_completion(receiver_ranks, 0, rowLen);
     }
 
@@ -397,29 +697,107 @@ public:
             sizeof(vec_field[0][0]) * vec_field.size());
     }
 
+    /**
+     * Combines the values of a field across some of the rows, for example to
+     * find the minimum over the members of a shard. Each row is read exactly
+     * once, so the result is consistent even if remote writes arrive during
+     * the reduction.
+     * @param field The field (column) to reduce
+     * @param row_indices The rows to reduce over; callers should compute this
+     * once (e.g. per view) rather than on every call. Must not be empty.
+     * @param op A binary operation such as reduce_min, reduce_max, or std::plus
+     * @return The combination of the field's values in the given rows
+     */
+    template <typename T, typename Op>
+    T reduce(const SSTField<T>& field, const std::vector<uint32_t>& row_indices, Op op) const {
+        return reduce_column<T>(field.base, field.rowLen, row_indices, op);
+    }
+
+    /** Combines a single element of a vector field across some of the rows; see the SSTField overload. */
+    template <typename T, typename Op>
+    T reduce(const SSTFieldVector<T>& vec_field, std::size_t index,
+             const std::vector<uint32_t>& row_indices, Op op) const {
+        assert(index < vec_field.size());
+        return reduce_column<T>(vec_field.base + index * sizeof(T), vec_field.rowLen, row_indices, op);
+    }
+
+    /** Returns an empty write batch for this SST. */
+    SSTWriteBatch make_write_batch() {
+        return SSTWriteBatch(getBaseAddress());
+    }
+
+    /** Writes all the ranges marked in a write batch to all remote nodes. */
+    void put(const SSTWriteBatch& batch) {
+        put(all_indices, batch);
+    }
+
+    /**
+     * Writes all the ranges marked in a write batch to some of the remote
+     * nodes, posting each node's writes as a single list.
+     */
+    void put(const std::vector<uint32_t>& receiver_ranks, const SSTWriteBatch& batch);
+
     /** Writes a contiguous subset of the local row to some of the remote nodes. */
     void put(const std::vector<uint32_t> receiver_ranks, size_t offset, size_t size);
 
-    void put_with_completion(const std::vector<uint32_t> receiver_ranks, size_t offset, size_t size);
+    /**
+     * Writes a contiguous subset of the local row to some of the remote nodes,
+     * and waits until each write completes or the completion timeout expires,
+     * freezing the rows of nodes whose writes failed. Calls on the same SST
+     * from different threads run one at a time. Does not allocate once the
+     * calling thread has had a write fail.
+     */
+    void put_with_completion(const std::vector<uint32_t>& receiver_ranks, size_t offset, size_t size);
 
 private:
     using char_p = volatile char*;
 
-    void compute_rowLen(size_t&) {}
+    /**
+     * Reduces the column of values of type T that starts at column and repeats
+     * every stride bytes. Rows are copied out of the SST a block at a time with
+     * independent loads, and each block is then combined from ordinary local
+     * memory, so neither the loads nor the combining step wait on each other.
+     */
+    template <typename T, typename Op>
+    static T reduce_column(const volatile char* column, const std::size_t stride,
+                           const std::vector<uint32_t>& row_indices, Op op) {
+        static_assert(std::is_arithmetic<T>::value, "SST::reduce only supports arithmetic fields");
+        assert(!row_indices.empty());
+        constexpr std::size_t block_size = 8;
+        T block[block_size];
+        const std::size_t num_rows = row_indices.size();
+        T result = *reinterpret_cast<const volatile T*>(column + row_indices[0] * stride);
+        for(std::size_t start = 1; start < num_rows; start += block_size) {
+            const std::size_t count = std::min(block_size, num_rows - start);
+            for(std::size_t i = 0; i < count; ++i) {
+                block[i] = *reinterpret_cast<const volatile T*>(column + row_indices[start + i] * stride);
+            }
+            for(std::size_t i = 0; i < count; ++i) {
+                result = op(result, block[i]);
+            }
+        }
+        return result;
+    }
+
+    void compute_rowLen(size_t&, bool&) {}
 
     template <typename Field, typename... Fields>
-    void compute_rowLen(size_t& rowLen, Field& f, Fields&... rest) {
-        rowLen += padded_len(f.field_len);
-        compute_rowLen(rowLen, rest...);
+    void compute_rowLen(size_t& rowLen, bool& has_hot_fields, Field& f, Fields&... rest) {
+        rowLen = f.layout_offset(rowLen) + f.layout_len();
+        has_hot_fields = has_hot_fields || f.access == FieldAccess::HOT;
+        compute_rowLen(rowLen, has_hot_fields, rest...);
     }
 
-    void set_bases_and_rowLens(char_p&, const size_t) {}
+    void set_bases_and_rowLens(size_t&, const size_t) {}
 
     template <typename Field, typename... Fields>
-    void set_bases_and_rowLens(char_p& base, const size_t rlen, Field& f, Fields&... rest) {
-        base += f.set_base(base);
+    void set_bases_and_rowLens(size_t& offset, const size_t rlen, Field& f, Fields&... rest) {
+        offset = f.layout_offset(offset);
+        f.set_base(rows + offset);
         f.set_rowLen(rlen);
-        set_bases_and_rowLens(base, rlen, rest...);
+        row_layout.push_back(field_layout{offset, f.field_len, f.layout_len(), f.access});
+        offset += f.layout_len();
+        set_bases_and_rowLens(offset, rlen, rest...);
     }
 
     // void take_snapshot() {
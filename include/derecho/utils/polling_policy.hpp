@@ -0,0 +1,113 @@
+#ifndef POLLING_POLICY_HPP
+#define POLLING_POLICY_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace derecho {
+
+/** The ways a polling thread can behave when it finds no work to do. */
+enum class PollingMode {
+    /** Never give up the core; lowest latency, always 100% CPU. */
+    SPIN,
+    /** Spin for a while, then call sched_yield() between polls. */
+    SPIN_YIELD,
+    /** Spin for a while, then sleep for exponentially increasing intervals, up to a maximum. */
+    BACKOFF,
+    /** Spin for a while, then sleep for the maximum interval between polls (the legacy behavior). */
+    SPIN_SLEEP,
+    /** Spin for a while, then block on a futex until notify() is called or the maximum interval expires. */
+    SPIN_WAIT
+};
+
+/**
+ * Parses the name of a polling mode as it appears in the configuration file
+ * ("spin", "spin_yield", "backoff", "spin_sleep", or "spin_wait").
+ * @throws std::invalid_argument if the name is not recognized
+ */
+PollingMode polling_mode_from_string(const std::string& name);
+
+/**
+ * A histogram of wakeup latencies with power-of-two nanosecond buckets.
+ * Bucket i counts samples in [2^i, 2^(i+1)) ns. Recording a sample is a
+ * single relaxed atomic increment, so it is cheap enough for polling loops,
+ * and other threads may read the counts while samples are being recorded.
+ */
+class LatencyHistogram {
+public:
+    static constexpr std::size_t NUM_BUCKETS = 40;
+
+    void record(uint64_t latency_ns);
+    uint64_t count() const;
+    /** Returns an upper bound (in ns) on the given percentile (0-100) of the recorded samples. */
+    uint64_t percentile_upper_bound(double percentile) const;
+    /** Renders the non-empty buckets as a human-readable string. */
+    std::string to_string() const;
+
+private:
+    std::array<std::atomic<uint64_t>, NUM_BUCKETS> buckets{};
+};
+
+/**
+ * Decides what a polling thread (such as the SST predicate thread or the P2P
+ * listener thread) does between polls. The owning thread calls on_progress()
+ * whenever a poll found work and on_idle() whenever it did not; other threads
+ * that produce work for the poller may call notify() to cut short a
+ * SPIN_WAIT block. After a notified wakeup the thread spins again for
+ * spin_us, since the notification means work is about to arrive. The policy
+ * also records, in a wakeup-latency histogram, how long a thread blocked in
+ * SPIN_WAIT took to return from the futex after notify() was called.
+ */
+class PollingPolicy {
+public:
+    /**
+     * @param mode What to do when there is no work
+     * @param spin_us How long to keep spinning after the last unit of work
+     * before yielding, sleeping, or blocking
+     * @param max_sleep_us The longest single sleep or block, which bounds the
+     * latency for work that cannot call notify() (e.g. remote RDMA writes)
+     */
+    PollingPolicy(PollingMode mode, uint64_t spin_us, uint64_t max_sleep_us);
+
+    /**
+     * Constructs a policy from the options DERECHO/<thread_name>_polling_mode,
+     * DERECHO/<thread_name>_polling_spin_us, and
+     * DERECHO/<thread_name>_polling_max_sleep_us.
+     */
+    static PollingPolicy from_config(const std::string& thread_name);
+
+    /** Called by the polling thread after a poll that found work. */
+    void on_progress();
+    /** Called by the polling thread after a poll that found nothing; may block. */
+    void on_idle();
+    /** Wakes the polling thread if it is blocked in SPIN_WAIT mode. Safe to call from any thread. */
+    void notify();
+
+    PollingMode get_mode() const { return mode; }
+    const LatencyHistogram& get_wakeup_latencies() const { return wakeup_latencies; }
+
+private:
+    const PollingMode mode;
+    const uint64_t spin_ns;
+    const uint64_t max_sleep_ns;
+    /** Time of the last poll that found work. */
+    uint64_t last_progress_time;
+    /** Length of the next sleep in BACKOFF mode. */
+    uint64_t next_sleep_ns;
+    /** Time of the most recent call to notify(), used to measure wakeup latencies. */
+    std::atomic<uint64_t> last_notify_time;
+    /** The futex word; incremented by every notify(). */
+    std::atomic<uint32_t> wake_sequence;
+    /** True while the polling thread is (about to be) blocked on the futex. */
+    std::atomic<bool> waiting;
+    LatencyHistogram wakeup_latencies;
+
+    /** Blocks on the futex for up to timeout_ns; returns true if notify() was called meanwhile. */
+    bool wait_for_notify(uint64_t timeout_ns);
+};
+
+}  // namespace derecho
+
+#endif  // POLLING_POLICY_HPP
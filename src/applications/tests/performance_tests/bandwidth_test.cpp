@@ -3,6 +3,8 @@
  * 1. the number of nodes 2. the number of senders (all sending, half nodes sending, one sending)
  * 3. message size 4. window size 5. number of messages sent per sender
  * 6. delivery mode (atomic multicast or unordered)
+ * 7. the number of RDMC messages each sender can have in flight (DERECHO/rdmc_max_in_flight),
+ *    which matters most for messages of a few RDMC blocks
  * The test waits for every node to join and then each sender starts sending messages continuously
  * in the only subgroup that consists of all the nodes
  * Upon completion, the results are appended to file data_derecho_bw on the leader
@@ -35,13 +37,14 @@ struct exp_result {
     unsigned int window_size;
     uint32_t num_messages;
     uint32_t delivery_mode;
+    uint32_t rdmc_max_in_flight;
     double bw;
 
     void print(std::ofstream& fout) {
         fout << num_nodes << " " << num_senders_selector << " "
              << max_msg_size << " " << window_size << " "
              << num_messages << " " << delivery_mode << " "
-             << bw << endl;
+             << rdmc_max_in_flight << " " << bw << endl;
     }
 };
 
@@ -181,7 +184,7 @@ int main(int argc, char* argv[]) {
     if(node_rank == 0) {
         log_results(exp_result{num_nodes, num_senders_selector, max_msg_size,
                                getConfUInt32(CONF_SUBGROUP_DEFAULT_WINDOW_SIZE), num_messages,
-                               delivery_mode, avg_bw},
+                               delivery_mode, getConfUInt32(CONF_DERECHO_RDMC_MAX_IN_FLIGHT), avg_bw},
                     "data_derecho_bw");
     }
 
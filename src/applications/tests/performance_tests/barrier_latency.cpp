@@ -0,0 +1,134 @@
+/*
+ * This test measures the latency of the two ways SST members synchronize with
+ * each other, for each group size from 2 up to the number of nodes:
+ * sync_with_members, which exchanges a message with every member over TCP,
+ * and put_with_completion, which writes the local row to every member and
+ * waits for all the writes to complete (as the GMS does before a view change).
+ * For group size k, nodes 0 to k-1 form an SST and every node runs each
+ * operation NUM_TRIALS times; the others wait for the next group size.
+ * Usage: barrier_latency <num_nodes> <my_rank> <ip_0> ... <ip_{num_nodes-1}>
+ * Node i listens on (sst_port + i), so all the nodes can also run on one host.
+ * Upon completion, the results are appended to file data_barrier_latency on node 0.
+ */
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include <derecho/conf/conf.hpp>
+#include <derecho/sst/sst.hpp>
+#include <derecho/utils/time.h>
+
+#include "log_results.hpp"
+
+using std::cout;
+using std::endl;
+using std::vector;
+
+struct exp_result {
+    std::string operation;
+    uint32_t num_nodes;
+    double latency;
+    double stddev;
+
+    void print(std::ofstream& fout) {
+        fout << operation << " " << num_nodes << " "
+             << latency << " " << stddev << endl;
+    }
+};
+
+class BarrierSST : public sst::SST<BarrierSST> {
+public:
+    sst::SSTField<uint64_t> round;
+
+    BarrierSST(const vector<uint32_t>& members, uint32_t my_id)
+            : SST(this, sst::SSTParams{members, my_id}) {
+        SSTInit(round);
+        for(uint32_t row = 0; row < get_num_rows(); ++row) {
+            round[row] = 0;
+        }
+    }
+};
+
+static const uint64_t NUM_TRIALS = 10000;
+
+/** Runs the operation NUM_TRIALS times and returns the mean and standard deviation of its latency, in microseconds. */
+template <typename Operation>
+std::pair<double, double> measure(Operation operation) {
+    vector<uint64_t> latencies_ns;
+    latencies_ns.reserve(NUM_TRIALS);
+    for(uint64_t trial = 1; trial <= NUM_TRIALS; ++trial) {
+        const uint64_t start_time = get_time();
+        operation(trial);
+        latencies_ns.push_back(get_time() - start_time);
+    }
+    const double mean_ns = std::accumulate(latencies_ns.begin(), latencies_ns.end(), 0.0) / latencies_ns.size();
+    double sum_of_squares = 0;
+    for(const uint64_t latency : latencies_ns) {
+        sum_of_squares += (latency - mean_ns) * (latency - mean_ns);
+    }
+    return {mean_ns / 1000.0, std::sqrt(sum_of_squares / latencies_ns.size()) / 1000.0};
+}
+
+int main(int argc, char* argv[]) {
+    if(argc < 3) {
+        cout << "Usage: " << argv[0] << " <num_nodes> <my_rank> <ip_0> ... <ip_{num_nodes-1}>" << endl;
+        return -1;
+    }
+    const uint32_t num_nodes = std::stoi(argv[1]);
+    const uint32_t my_rank = std::stoi(argv[2]);
+    if(static_cast<uint32_t>(argc) < 3 + num_nodes || num_nodes < 2) {
+        cout << "Usage: " << argv[0] << " <num_nodes> <my_rank> <ip_0> ... <ip_{num_nodes-1}>" << endl;
+        return -1;
+    }
+
+    const uint16_t base_port = derecho::getConfUInt16(CONF_DERECHO_SST_PORT);
+    std::map<uint32_t, std::pair<ip_addr_t, uint16_t>> ip_addrs_and_ports;
+    for(uint32_t i = 0; i < num_nodes; ++i) {
+        ip_addrs_and_ports[i] = {argv[3 + i], base_port + i};
+    }
+#ifdef USE_VERBS_API
+    sst::verbs_initialize(ip_addrs_and_ports, {}, my_rank);
+#else
+    sst::lf_initialize(ip_addrs_and_ports, {}, my_rank);
+#endif
+
+    for(uint32_t group_size = 2; group_size <= num_nodes; ++group_size) {
+        if(my_rank < group_size) {
+            vector<uint32_t> members(group_size);
+            std::iota(members.begin(), members.end(), 0);
+            BarrierSST sst(members, my_rank);
+            const uint32_t local = sst.get_local_index();
+            sst.sync_with_members();
+
+            std::map<std::string, std::pair<double, double>> results;
+            results["sync_with_members"] = measure([&](uint64_t) {
+                sst.sync_with_members();
+            });
+            results["put_with_completion"] = measure([&](uint64_t trial) {
+                sst.round[local] = trial;
+                sst.put_with_completion();
+            });
+            sst.sync_with_members();
+
+            if(my_rank == 0) {
+                for(const auto& [operation, latency] : results) {
+                    exp_result result{operation, group_size, latency.first, latency.second};
+                    cout << operation << " with " << group_size << " nodes: mean "
+                         << result.latency << " us, stddev " << result.stddev << " us" << endl;
+                    log_results(result, "data_barrier_latency");
+                }
+            }
+        }
+        // Keep the nodes in step between group sizes, including those not in this group
+        for(uint32_t node = 0; node < num_nodes; ++node) {
+            if(node != my_rank) {
+                sst::sync(node);
+            }
+        }
+    }
+    return 0;
+}
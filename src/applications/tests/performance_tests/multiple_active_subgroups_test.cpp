@@ -1,10 +1,16 @@
+#include <atomic>
+#include <filesystem>
 #include <fstream>
 #include <functional>
 #include <iostream>
 #include <map>
 #include <memory>
 #include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
 #include <time.h>
+#include <unistd.h>
 #include <vector>
 
 #include "aggregate_bandwidth.hpp"
@@ -35,6 +41,34 @@ struct exp_result {
     }
 };
 
+/**
+ * Returns the CPU time, in milliseconds, that the thread of this process with
+ * the given name has used so far, or 0 if there is no such thread.
+ */
+double thread_cpu_time_ms(const std::string& thread_name) {
+    for(const auto& task : std::filesystem::directory_iterator("/proc/self/task")) {
+        std::ifstream comm_file(task.path() / "comm");
+        std::string name;
+        std::getline(comm_file, name);
+        if(name != thread_name) {
+            continue;
+        }
+        std::ifstream stat_file(task.path() / "stat");
+        std::string stat_line;
+        std::getline(stat_file, stat_line);
+        // utime and stime are fields 14 and 15; skip past the name in field 2, which may contain spaces
+        std::istringstream fields(stat_line.substr(stat_line.rfind(')') + 2));
+        std::string field;
+        for(int i = 3; i < 14; ++i) {
+            fields >> field;
+        }
+        uint64_t user_ticks = 0, system_ticks = 0;
+        fields >> user_ticks >> system_ticks;
+        return (user_ticks + system_ticks) * 1000.0 / sysconf(_SC_CLK_TCK);
+    }
+    return 0;
+}
+
 int main(int argc, char* argv[]) {
     if(argc < 4 || (argc > 4 && strcmp("--", argv[argc - 4]))) {
         cout << "Invalid command line arguments." << endl;
@@ -54,19 +88,20 @@ int main(int argc, char* argv[]) {
     Conf::initialize(argc, argv);
 
     // variable 'done' tracks the end of the test
-    volatile bool done = false;
+    std::atomic<bool> done = false;
+    // each subgroup delivers on its own, so deliveries in different subgroups can run at the same time
+    std::atomic<uint64_t> num_delivered = 0;
     // callback into the application code at each message delivery
     auto stability_callback = [&num_messages,
                                &done,
                                &num_nodes,
                                &num_subgroups,
-                               num_delivered = 0u](uint32_t subgroup, uint32_t sender_id,
-                                                   long long int index,
-                                                   std::optional<std::pair<char*, long long int>> data,
-                                                   persistent::version_t ver) mutable {
+                               &num_delivered](uint32_t subgroup, uint32_t sender_id,
+                                               long long int index,
+                                               std::optional<std::pair<char*, long long int>> data,
+                                               persistent::version_t ver) {
         // increment the total number of messages delivered
-        ++num_delivered;
-        if(num_delivered == num_messages * num_subgroups * num_nodes) {
+        if(++num_delivered == static_cast<uint64_t>(num_messages) * num_subgroups * num_nodes) {
             done = true;
         }
     };
@@ -104,19 +139,25 @@ int main(int argc, char* argv[]) {
 
     long long unsigned int max_msg_size = getConfUInt64(CONF_SUBGROUP_DEFAULT_MAX_PAYLOAD_SIZE);
 
-    // this function sends all the messages
+    // this function sends all the messages, from one thread per subgroup so that
+    // the subgroups only contend with each other for the network
     auto send_in_all_subgroups = [&]() {
-        std::vector<std::reference_wrapper<Replicated<RawObject>>> raw_subgroups;
-        for(uint i = 0; i < num_subgroups; ++i) {
-            raw_subgroups.emplace_back(group.get_subgroup<RawObject>(i));
+        std::vector<std::thread> sender_threads;
+        for(uint j = 0; j < num_subgroups; ++j) {
+            sender_threads.emplace_back([&, j]() {
+                Replicated<RawObject>& raw_subgroup = group.get_subgroup<RawObject>(j);
+                for(uint i = 0; i < num_messages; ++i) {
+                    raw_subgroup.send(max_msg_size, [](char* buf) {});
+                }
+            });
         }
-        for(uint i = 0; i < num_messages; ++i) {
-            for(uint j = 0; j < num_subgroups; ++j) {
-                raw_subgroups[j].get().send(max_msg_size, [](char* buf) {});
-            }
+        for(auto& sender_thread : sender_threads) {
+            sender_thread.join();
         }
     };
 
+    // the sender thread's CPU time shows the cost of checking whether each subgroup can send
+    const double sender_thread_start_ms = thread_cpu_time_ms("sender_thread");
     struct timespec start_time;
     // start timer
     clock_gettime(CLOCK_REALTIME, &start_time);
@@ -128,6 +169,9 @@ int main(int argc, char* argv[]) {
     struct timespec end_time;
     clock_gettime(CLOCK_REALTIME, &end_time);
     long long int nanoseconds_elapsed = (end_time.tv_sec - start_time.tv_sec) * (long long int)1e9 + (end_time.tv_nsec - start_time.tv_nsec);
+    const double sender_thread_ms = thread_cpu_time_ms("sender_thread") - sender_thread_start_ms;
+    cout << "Sender thread used " << sender_thread_ms << " ms of CPU time, "
+         << 100.0 * sender_thread_ms * 1e6 / nanoseconds_elapsed << "% of the run" << endl;
     // calculate bandwidth measured locally
     double bw;
     bw = (max_msg_size * num_messages * num_subgroups * num_nodes + 0.0) / nanoseconds_elapsed;
@@ -135,6 +179,9 @@ int main(int argc, char* argv[]) {
     double avg_bw = aggregate_bandwidth(members_order, members_order[node_rank], bw);
     // log the result at the leader node
     if(node_rank == 0) {
+        // with no contention between subgroups, the bandwidth of each subgroup stays the same as subgroups are added
+        cout << "Aggregate bandwidth " << avg_bw << " GB/s, " << avg_bw / num_subgroups
+             << " GB/s per subgroup with " << num_subgroups << " subgroups" << endl;
         log_results(exp_result{num_nodes, max_msg_size,
                                getConfUInt32(CONF_SUBGROUP_DEFAULT_WINDOW_SIZE),
                                num_messages,
@@ -0,0 +1,329 @@
+/*
+ * This program simulates an RDMC multicast offline, without RDMA, to compare
+ * send schedules and tune block sizes. It drives get_outgoing_transfer and
+ * get_incoming_transfer of every member's schedule the way polling_group
+ * does: each member sends one block at a time, in send-step order, once it
+ * has the block and the receiver is ready for it, and receives one block at
+ * a time, in receive-step order. A transfer of a block takes
+ * latency + block_size / bandwidth, with a lower bandwidth between racks if
+ * a topology is given.
+ * While it runs, it checks that senders and receivers agree on every
+ * transfer, that members only forward blocks they have, that each member's
+ * first incoming transfer is the one get_first_block names, and that every
+ * member receives every block exactly once; it reports a deadlock if the
+ * transfers stop before every member is done. For each schedule it then
+ * prints the simulated completion time, the resulting bandwidth, and the
+ * load on the busiest link and across racks.
+ * Usage: rdmc_schedule_simulator <algorithm> <num_members> <num_blocks>
+ *            [block_size (bytes)] [bandwidth (Gb/s)] [latency (us)]
+ *            [racks] [cross_rack_bandwidth (Gb/s)]
+ * algorithm is binomial, chain, sequential, tree, hybrid or all; racks is a
+ * comma-separated list of the rack of each member, e.g. 0,0,1,1. The program
+ * exits with a non-zero status if any schedule fails a check.
+ * rdmc_schedule_simulator check-binomial [max_members] [max_blocks] instead
+ * checks that binomial_schedule's cached transfer tables agree with the
+ * static functions they are built from on every step, for every group of 2
+ * to max_members (default 40) members and every message of 1 to max_blocks
+ * (default 64) blocks, looking sizes up in an order that evicts and revisits
+ * cached tables.
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <queue>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <derecho/conf/conf.hpp>
+#include <derecho/rdmc/detail/schedule.hpp>
+
+using std::cout;
+using std::endl;
+using std::vector;
+
+struct link_parameters {
+    double bandwidth_gbps;
+    double latency_us;
+    vector<uint32_t> member_racks;
+    double cross_rack_bandwidth_gbps;
+};
+
+struct simulation_result {
+    std::string algorithm;
+    uint32_t num_members;
+    size_t num_blocks;
+    /** Why the simulation failed, or empty if every check passed */
+    std::string error;
+    double completion_time_us = 0;
+    uint64_t max_link_bytes = 0;
+    size_t links_used = 0;
+    uint64_t cross_rack_bytes = 0;
+};
+
+std::unique_ptr<schedule> make_schedule(const std::string& algorithm, uint32_t num_members,
+                                        uint32_t member, const vector<uint32_t>& member_racks) {
+    if(algorithm == "binomial") {
+        return std::make_unique<binomial_schedule>(num_members, member);
+    } else if(algorithm == "chain") {
+        return std::make_unique<chain_schedule>(num_members, member);
+    } else if(algorithm == "sequential") {
+        return std::make_unique<sequential_schedule>(num_members, member);
+    } else if(algorithm == "tree") {
+        return std::make_unique<tree_schedule>(num_members, member);
+    } else if(algorithm == "hybrid") {
+        return std::make_unique<hybrid_schedule>(num_members, member, member_racks);
+    }
+    return nullptr;
+}
+
+simulation_result simulate(const std::string& algorithm, uint32_t num_members, size_t num_blocks,
+                           uint64_t block_size, const link_parameters& links) {
+    simulation_result result{algorithm, num_members, num_blocks};
+    vector<std::unique_ptr<schedule>> schedules;
+    for(uint32_t member = 0; member < num_members; ++member) {
+        schedules.push_back(make_schedule(algorithm, num_members, member, links.member_racks));
+    }
+    const size_t total_steps = schedules[0]->get_total_steps(num_blocks);
+
+    // group_send posts the first receive before it knows the block count, using
+    // get_first_block, so that block must be the member's first incoming transfer
+    for(uint32_t member = 1; member < num_members && result.error.empty(); ++member) {
+        auto first_block = schedules[member]->get_first_block(num_blocks);
+        auto any_size_first_block = schedules[member]->get_first_block(1);
+        std::optional<schedule::block_transfer> first_transfer;
+        for(size_t step = 0; step < total_steps && !first_transfer; ++step) {
+            first_transfer = schedules[member]->get_incoming_transfer(num_blocks, step);
+        }
+        if(!first_block || !first_transfer || !any_size_first_block
+           || first_block->target != first_transfer->target
+           || any_size_first_block->target != first_transfer->target
+           || std::min(first_block->block_number, num_blocks - 1) != first_transfer->block_number) {
+            result.error = "member " + std::to_string(member)
+                           + "'s first incoming transfer does not match get_first_block";
+        }
+    }
+
+    vector<size_t> send_steps(num_members, 0);
+    vector<size_t> receive_steps(num_members, 0);
+    vector<bool> sending(num_members, false);
+    vector<bool> receiving(num_members, false);
+    vector<vector<bool>> has_block(num_members, vector<bool>(num_blocks, false));
+    vector<size_t> num_received(num_members, 0);
+    has_block[0].assign(num_blocks, true);
+    num_received[0] = num_blocks;
+    std::map<std::pair<uint32_t, uint32_t>, uint64_t> link_bytes;
+
+    // Moves past the steps on which a member has nothing to do
+    auto next_outgoing = [&](uint32_t member) -> std::optional<schedule::block_transfer> {
+        for(; send_steps[member] < total_steps; ++send_steps[member]) {
+            auto transfer = schedules[member]->get_outgoing_transfer(num_blocks, send_steps[member]);
+            if(transfer) return transfer;
+        }
+        return std::nullopt;
+    };
+    auto next_incoming = [&](uint32_t member) -> std::optional<schedule::block_transfer> {
+        for(; receive_steps[member] < total_steps; ++receive_steps[member]) {
+            auto transfer = schedules[member]->get_incoming_transfer(num_blocks, receive_steps[member]);
+            if(transfer) return transfer;
+        }
+        return std::nullopt;
+    };
+    auto transfer_time_us = [&](uint32_t sender, uint32_t receiver) {
+        double bandwidth_gbps = links.bandwidth_gbps;
+        if(!links.member_racks.empty() && links.member_racks[sender] != links.member_racks[receiver]) {
+            bandwidth_gbps = links.cross_rack_bandwidth_gbps;
+        }
+        return links.latency_us + block_size * 8 / (bandwidth_gbps * 1000);
+    };
+
+    // Transfers in flight, by completion time: (time, sender, receiver, block)
+    using event = std::tuple<double, uint32_t, uint32_t, size_t>;
+    std::priority_queue<event, vector<event>, std::greater<event>> in_flight;
+    // Starts the sender's next transfer if the receiver is ready for it
+    auto try_send = [&](uint32_t sender, double now) {
+        if(sending[sender]) return;
+        auto transfer = next_outgoing(sender);
+        if(!transfer || !has_block[sender][transfer->block_number]) return;
+        const uint32_t receiver = transfer->target;
+        if(receiver >= num_members || receiving[receiver]) return;
+        auto expected = next_incoming(receiver);
+        if(!expected || expected->target != sender) return;
+        if(expected->block_number != transfer->block_number) {
+            result.error = "member " + std::to_string(sender) + " sends block "
+                           + std::to_string(transfer->block_number) + " to member "
+                           + std::to_string(receiver) + ", which expects block "
+                           + std::to_string(expected->block_number);
+            return;
+        }
+        sending[sender] = true;
+        receiving[receiver] = true;
+        in_flight.emplace(now + transfer_time_us(sender, receiver), sender, receiver, transfer->block_number);
+    };
+
+    for(uint32_t member = 0; member < num_members; ++member) {
+        try_send(member, 0);
+    }
+    while(!in_flight.empty() && result.error.empty()) {
+        auto [now, sender, receiver, block] = in_flight.top();
+        in_flight.pop();
+        if(has_block[receiver][block]) {
+            result.error = "member " + std::to_string(receiver) + " receives block "
+                           + std::to_string(block) + " twice";
+            break;
+        }
+        has_block[receiver][block] = true;
+        ++num_received[receiver];
+        sending[sender] = false;
+        receiving[receiver] = false;
+        ++send_steps[sender];
+        ++receive_steps[receiver];
+        link_bytes[{sender, receiver}] += block_size;
+        result.completion_time_us = now;
+        // The freed sender and receiver may each unblock a transfer from another member
+        for(uint32_t member = 0; member < num_members; ++member) {
+            try_send(member, now);
+        }
+    }
+    if(result.error.empty()) {
+        for(uint32_t member = 0; member < num_members; ++member) {
+            if(num_received[member] != num_blocks || next_outgoing(member) || next_incoming(member)) {
+                result.error = "deadlock: member " + std::to_string(member) + " has "
+                               + std::to_string(num_received[member]) + " of "
+                               + std::to_string(num_blocks) + " blocks and is stuck on send step "
+                               + std::to_string(send_steps[member]) + ", receive step "
+                               + std::to_string(receive_steps[member]);
+                break;
+            }
+        }
+    }
+    for(const auto& [link, bytes] : link_bytes) {
+        result.max_link_bytes = std::max(result.max_link_bytes, bytes);
+        if(!links.member_racks.empty() && links.member_racks[link.first] != links.member_racks[link.second]) {
+            result.cross_rack_bytes += bytes;
+        }
+    }
+    result.links_used = link_bytes.size();
+    return result;
+}
+
+/** Compares one binomial_schedule's lookups for a message of num_blocks blocks with the static functions */
+bool check_binomial_lookups(const binomial_schedule& schedule, uint32_t num_members, uint32_t member,
+                            size_t num_blocks) {
+    const unsigned int log2_num_members = std::floor(std::log2(num_members));
+    const size_t total_steps = schedule.get_total_steps(num_blocks);
+    // Also look past the last step, which should have no transfers
+    for(size_t step = 0; step <= total_steps; ++step) {
+        auto outgoing = schedule.get_outgoing_transfer(num_blocks, step);
+        auto incoming = schedule.get_incoming_transfer(num_blocks, step);
+        std::optional<schedule::block_transfer> expected_outgoing;
+        std::optional<schedule::block_transfer> expected_incoming;
+        if(step < total_steps) {
+            expected_outgoing = binomial_schedule::get_outgoing_transfer(member, step, num_members, log2_num_members,
+                                                                         num_blocks, total_steps);
+            expected_incoming = binomial_schedule::get_incoming_transfer(member, step, num_members, log2_num_members,
+                                                                         num_blocks, total_steps);
+        }
+        auto same = [](const std::optional<schedule::block_transfer>& a, const std::optional<schedule::block_transfer>& b) {
+            return a.has_value() == b.has_value() && (!a || (a->target == b->target && a->block_number == b->block_number));
+        };
+        if(!same(outgoing, expected_outgoing) || !same(incoming, expected_incoming)) {
+            cout << "binomial: FAILED: member " << member << " of " << num_members << ", " << num_blocks
+                 << " blocks, step " << step << ": the table lookup does not match the static functions" << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool check_binomial_tables(uint32_t max_members, size_t max_blocks) {
+    for(uint32_t num_members = 2; num_members <= max_members; ++num_members) {
+        for(uint32_t member = 0; member < num_members; ++member) {
+            binomial_schedule schedule(num_members, member);
+            for(size_t num_blocks = 1; num_blocks <= max_blocks; ++num_blocks) {
+                // Mixing rising, falling and revisited sizes makes lookups hit, miss, and
+                // evict both larger and smaller tables than the ones they build
+                for(size_t blocks : {num_blocks, num_blocks, max_blocks + 1 - num_blocks,
+                                     1 + num_blocks / 2, 1 + num_blocks / 3, 1 + num_blocks / 7}) {
+                    if(!check_binomial_lookups(schedule, num_members, member, blocks)) {
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+    cout << "binomial: table lookups match the static functions for 2 to " << max_members
+         << " members and 1 to " << max_blocks << " blocks" << endl;
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    if(argc > 1 && std::string(argv[1]) == "check-binomial") {
+        const uint32_t max_members = argc > 2 ? std::stoi(argv[2]) : 40;
+        const size_t max_blocks = argc > 3 ? std::stoul(argv[3]) : 64;
+        return check_binomial_tables(max_members, max_blocks) ? 0 : 1;
+    }
+    if(argc < 4) {
+        cout << "Usage: " << argv[0] << " <algorithm> <num_members> <num_blocks> [block_size (bytes)]"
+             << " [bandwidth (Gb/s)] [latency (us)] [racks] [cross_rack_bandwidth (Gb/s)]" << endl;
+        cout << "algorithm is binomial, chain, sequential, tree, hybrid or all" << endl;
+        cout << "   or: " << argv[0] << " check-binomial [max_members] [max_blocks]" << endl;
+        return -1;
+    }
+    const std::string algorithm = argv[1];
+    const uint32_t num_members = std::stoi(argv[2]);
+    const size_t num_blocks = std::stoul(argv[3]);
+    const uint64_t block_size = argc > 4 ? std::stoull(argv[4]) : 1 << 20;
+    link_parameters links{argc > 5 ? std::stod(argv[5]) : 100.0,
+                          argc > 6 ? std::stod(argv[6]) : 2.0,
+                          {},
+                          0};
+    if(argc > 7) {
+        for(const std::string& rack : derecho::split_string(argv[7])) {
+            links.member_racks.push_back(std::stoul(rack));
+        }
+    }
+    links.cross_rack_bandwidth_gbps = argc > 8 ? std::stod(argv[8]) : links.bandwidth_gbps;
+    if(num_members < 2 || num_blocks < 1) {
+        cout << "There must be at least 2 members and 1 block" << endl;
+        return -1;
+    }
+    if(!links.member_racks.empty() && links.member_racks.size() != num_members) {
+        cout << "racks must list one rack for each of the " << num_members << " members" << endl;
+        return -1;
+    }
+    if(links.member_racks.empty()) {
+        // Without a topology, the hybrid schedule sees one rack
+        links.member_racks.assign(num_members, 0);
+        links.cross_rack_bandwidth_gbps = links.bandwidth_gbps;
+    }
+
+    vector<std::string> algorithms{algorithm};
+    if(algorithm == "all") {
+        algorithms = {"binomial", "chain", "sequential", "tree", "hybrid"};
+    } else if(!make_schedule(algorithm, num_members, 0, links.member_racks)) {
+        cout << "Unknown algorithm " << algorithm << endl;
+        return -1;
+    }
+
+    bool all_passed = true;
+    cout << "algorithm, members, blocks, time (us), bandwidth (Gb/s), busiest link (MB), links used, cross-rack (MB)" << endl;
+    for(const std::string& name : algorithms) {
+        simulation_result result = simulate(name, num_members, num_blocks, block_size, links);
+        if(!result.error.empty()) {
+            cout << name << ": FAILED: " << result.error << endl;
+            all_passed = false;
+            continue;
+        }
+        cout << name << ", " << num_members << ", " << num_blocks << ", "
+             << result.completion_time_us << ", "
+             << block_size * num_blocks * 8 / (result.completion_time_us * 1000) << ", "
+             << result.max_link_bytes / 1e6 << ", " << result.links_used << ", "
+             << result.cross_rack_bytes / 1e6 << endl;
+    }
+    return all_passed ? 0 : 1;
+}
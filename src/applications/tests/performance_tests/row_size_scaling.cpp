@@ -0,0 +1,157 @@
+/*
+ * This test measures how the latency of an SST round trip scales with the
+ * SST row size, and compares the packed row layout with the cache-line aware
+ * layout (in which frequently written fields are declared HOT).
+ * In each trial, node 0 increments a counter and pushes its entire row, and
+ * every other node echoes the counter back by pushing its own entire row; the
+ * trial ends when node 0 sees the new counter value in every row. Meanwhile,
+ * a local thread on every node keeps writing another counter in the same row,
+ * standing in for the persistence and delivery threads. In the packed layout
+ * that counter shares a cache line with the round counter; in the aligned
+ * layout it does not.
+ * Usage: row_size_scaling <packed|aligned> <num_nodes> <my_rank> <ip_0> ... <ip_{num_nodes-1}>
+ * Node i listens on (sst_port + i), so all the nodes can also run on one host.
+ * Upon completion, the results are appended to file data_row_size_scaling on node 0.
+ */
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <derecho/conf/conf.hpp>
+#include <derecho/sst/sst.hpp>
+#include <derecho/utils/time.h>
+
+#include "log_results.hpp"
+
+using std::cout;
+using std::endl;
+using std::vector;
+
+struct exp_result {
+    std::string layout;
+    uint32_t num_nodes;
+    size_t row_length;
+    double latency;
+    double stddev;
+
+    void print(std::ofstream& fout) {
+        fout << layout << " " << num_nodes << " "
+             << row_length << " " << latency << " "
+             << stddev << endl;
+    }
+};
+
+class RowScalingSST : public sst::SST<RowScalingSST> {
+public:
+    /** The trial number, written once per trial by every node. */
+    sst::SSTField<uint64_t> round;
+    /** Written continuously by a local thread. */
+    sst::SSTField<uint64_t> local_counter;
+    /** Cold data that makes up the rest of the row. */
+    sst::SSTFieldVector<char> payload;
+
+    RowScalingSST(const vector<uint32_t>& members, uint32_t my_id, size_t payload_size, sst::FieldAccess counter_access)
+            : SST(this, sst::SSTParams{members, my_id}),
+              round(counter_access),
+              local_counter(counter_access),
+              payload(payload_size) {
+        SSTInit(round, local_counter, payload);
+        for(uint32_t row = 0; row < get_num_rows(); ++row) {
+            round[row] = 0;
+            local_counter[row] = 0;
+        }
+    }
+};
+
+static const uint64_t NUM_TRIALS = 10000;
+
+int main(int argc, char* argv[]) {
+    if(argc < 4) {
+        cout << "Usage: " << argv[0] << " <packed|aligned> <num_nodes> <my_rank> <ip_0> ... <ip_{num_nodes-1}>" << endl;
+        return -1;
+    }
+    const std::string layout = argv[1];
+    const uint32_t num_nodes = std::stoi(argv[2]);
+    const uint32_t my_rank = std::stoi(argv[3]);
+    if(static_cast<uint32_t>(argc) < 4 + num_nodes || (layout != "packed" && layout != "aligned")) {
+        cout << "Usage: " << argv[0] << " <packed|aligned> <num_nodes> <my_rank> <ip_0> ... <ip_{num_nodes-1}>" << endl;
+        return -1;
+    }
+    const sst::FieldAccess counter_access = (layout == "aligned") ? sst::FieldAccess::HOT : sst::FieldAccess::COLD;
+
+    const uint16_t base_port = derecho::getConfUInt16(CONF_DERECHO_SST_PORT);
+    std::map<uint32_t, std::pair<ip_addr_t, uint16_t>> ip_addrs_and_ports;
+    for(uint32_t i = 0; i < num_nodes; ++i) {
+        ip_addrs_and_ports[i] = {argv[4 + i], base_port + i};
+    }
+#ifdef USE_VERBS_API
+    sst::verbs_initialize(ip_addrs_and_ports, {}, my_rank);
+#else
+    sst::lf_initialize(ip_addrs_and_ports, {}, my_rank);
+#endif
+
+    vector<uint32_t> members(num_nodes);
+    std::iota(members.begin(), members.end(), 0);
+
+    for(size_t payload_size = 64; payload_size <= 64 * 1024; payload_size *= 4) {
+        RowScalingSST sst(members, my_rank, payload_size, counter_access);
+        const uint32_t local = sst.get_local_index();
+        if(my_rank == 0) {
+            cout << sst.layout_to_string({"round", "local_counter", "payload"});
+        }
+        sst.put();
+        sst.sync_with_members();
+
+        std::atomic<bool> stop_writer = false;
+        std::thread local_writer([&]() {
+            while(!stop_writer) {
+                sst.local_counter[local] = sst.local_counter[local] + 1;
+            }
+        });
+
+        vector<uint64_t> latencies_ns;
+        latencies_ns.reserve(NUM_TRIALS);
+        for(uint64_t trial = 1; trial <= NUM_TRIALS; ++trial) {
+            if(my_rank == 0) {
+                const uint64_t start_time = get_time();
+                sst.round[local] = trial;
+                sst.put();
+                for(uint32_t row = 0; row < num_nodes; ++row) {
+                    while(sst.round[row] < trial) {
+                    }
+                }
+                latencies_ns.push_back(get_time() - start_time);
+            } else {
+                while(sst.round[0] < trial) {
+                }
+                sst.round[local] = trial;
+                sst.put();
+            }
+        }
+
+        stop_writer = true;
+        local_writer.join();
+        sst.sync_with_members();
+
+        if(my_rank == 0) {
+            const double mean_ns = std::accumulate(latencies_ns.begin(), latencies_ns.end(), 0.0) / latencies_ns.size();
+            double sum_of_squares = 0;
+            for(const uint64_t latency : latencies_ns) {
+                sum_of_squares += (latency - mean_ns) * (latency - mean_ns);
+            }
+            exp_result result{layout, num_nodes, sst.get_row_length(),
+                              mean_ns / 1000.0, std::sqrt(sum_of_squares / latencies_ns.size()) / 1000.0};
+            cout << layout << " layout, row length " << sst.get_row_length() << " bytes: mean round trip "
+                 << result.latency << " us, stddev " << result.stddev << " us" << endl;
+            log_results(result, "data_row_size_scaling");
+        }
+    }
+    return 0;
+}
@@ -50,6 +50,27 @@ struct option Conf::long_options[] = {
         MAKE_LONG_OPT_ENTRY(CONF_DERECHO_MAX_P2P_REQUEST_PAYLOAD_SIZE),
         MAKE_LONG_OPT_ENTRY(CONF_DERECHO_MAX_P2P_REPLY_PAYLOAD_SIZE),
         MAKE_LONG_OPT_ENTRY(CONF_DERECHO_P2P_WINDOW_SIZE),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_SST_POLLING_MODE),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_SST_POLLING_SPIN_US),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_SST_POLLING_MAX_SLEEP_US),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_P2P_POLLING_MODE),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_P2P_POLLING_SPIN_US),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_P2P_POLLING_MAX_SLEEP_US),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_SST_PREDICATE_THREADS),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_SST_PREDICATE_THREAD_CPUS),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_SST_PER_SHARD_SMC),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_SHM_TRANSPORT),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_SMC_PACKING),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_SMC_RING_SIZE),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_RDMC_MAX_IN_FLIGHT),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_RDMC_RACKS),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_RDMC_ADAPTIVE_BLOCK_SIZE),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_RDMC_MIN_BLOCK_SIZE),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_MAX_REGISTERED_SEND_BUFFERS),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_MESSAGE_BUFFER_SLAB_SIZE),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_MAX_MESSAGE_BUFFER_BYTES),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_BATCHED_RPC_DELIVERY),
+        MAKE_LONG_OPT_ENTRY(CONF_DERECHO_DELIVERY_THREADS),
         MAKE_LONG_OPT_ENTRY(CONF_DERECHO_MAX_NODE_ID),
         // [SUBGROUP/<subgroup name>]
         MAKE_LONG_OPT_ENTRY(CONF_SUBGROUP_DEFAULT_RDMC_SEND_ALGORITHM),
@@ -176,7 +197,7 @@ std::vector<std::string> split_string(const std::string& str, const std::string&
     std::size_t lastpos = 0;
     std::size_t nextpos = 0;
     while((nextpos = str.find(delimiter, lastpos)) != std::string::npos) {
-        result.emplace_back(str.substr(lastpos, nextpos));
+        result.emplace_back(str.substr(lastpos, nextpos - lastpos));
         lastpos = nextpos + delimiter.length();
     }
     result.emplace_back(str.substr(lastpos));
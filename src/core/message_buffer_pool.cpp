@@ -0,0 +1,108 @@
+#include <derecho/core/detail/message_buffer_pool.hpp>
+#include <derecho/utils/logger.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+
+namespace derecho {
+
+MessageBufferPool::MessageBufferPool(std::size_t slab_size, std::size_t max_registered_bytes,
+                                     std::size_t min_buffer_size)
+        : min_buffer_size(min_buffer_size),
+          slab_size(std::max(slab_size, min_buffer_size)),
+          max_registered_bytes(max_registered_bytes) {}
+
+uint32_t MessageBufferPool::get_size_class(std::size_t size) const {
+    uint32_t size_class = 0;
+    while(get_buffer_size(size_class) < size) {
+        size_class++;
+    }
+    return size_class;
+}
+
+bool MessageBufferPool::has_free_buffer(uint32_t size_class) const {
+    return size_class < free_buffers.size() && !free_buffers[size_class].empty();
+}
+
+bool MessageBufferPool::add_slab(uint32_t size_class, bool allow_over_limit) {
+    const std::size_t buffer_size = get_buffer_size(size_class);
+    const std::size_t region_size = get_slab_size(size_class);
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        if(registered_bytes + region_size > max_registered_bytes) {
+            if(!allow_over_limit) {
+                return false;
+            }
+            dbg_default_warn("Registering {} more bytes for message buffers, over the limit of {} bytes",
+                             region_size, max_registered_bytes);
+        }
+        // Count the slab before registering it, so that concurrent callers see it against the limit
+        num_slabs++;
+        registered_bytes += region_size;
+    }
+    // Registration is slow, so other threads can take and return buffers meanwhile
+    auto mr = std::make_shared<rdma::memory_region>(region_size);
+    std::vector<MessageBuffer> slab_buffers;
+    for(std::size_t offset = 0; offset + buffer_size <= region_size; offset += buffer_size) {
+        slab_buffers.emplace_back(mr, mr->buffer + offset, buffer_size);
+    }
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    if(free_buffers.size() <= size_class) {
+        free_buffers.resize(size_class + 1);
+    }
+    std::move(slab_buffers.begin(), slab_buffers.end(), std::back_inserter(free_buffers[size_class]));
+    return true;
+}
+
+void MessageBufferPool::set_max_registered_bytes(std::size_t max_bytes) {
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    max_registered_bytes = max_bytes;
+}
+
+bool MessageBufferPool::reserve(uint32_t size_class) {
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        if(has_free_buffer(size_class)) {
+            return true;
+        }
+    }
+    return add_slab(size_class, false);
+}
+
+MessageBuffer MessageBufferPool::allocate(std::size_t size, bool allow_over_limit) {
+    const uint32_t size_class = get_size_class(size);
+    // Another thread may take the new slab's buffers before this one does
+    while(true) {
+        {
+            std::lock_guard<std::mutex> lock(pool_mutex);
+            if(has_free_buffer(size_class)) {
+                MessageBuffer message_buffer = std::move(free_buffers[size_class].back());
+                free_buffers[size_class].pop_back();
+                return message_buffer;
+            }
+        }
+        if(!add_slab(size_class, allow_over_limit)) {
+            return MessageBuffer();
+        }
+    }
+}
+
+void MessageBufferPool::release(MessageBuffer&& message_buffer) {
+    assert(!message_buffer.is_lent());
+    const uint32_t size_class = get_size_class(message_buffer.size);
+    assert(get_buffer_size(size_class) == message_buffer.size);
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    free_buffers[size_class].push_back(std::move(message_buffer));
+}
+
+std::vector<std::size_t> MessageBufferPool::get_num_free_buffers() const {
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    std::vector<std::size_t> num_free_buffers;
+    for(const auto& buffers : free_buffers) {
+        num_free_buffers.push_back(buffers.size());
+    }
+    return num_free_buffers;
+}
+
+}  // namespace derecho
@@ -1,7 +1,10 @@
 #include <algorithm>
 #include <cassert>
 #include <chrono>
+#include <cstring>
 #include <limits>
+#include <numeric>
+#include <set>
 #include <thread>
 
 #include <derecho/core/detail/derecho_internal.hpp>
@@ -45,34 +48,90 @@ MulticastGroup::MulticastGroup(
           subgroup_settings_map(subgroup_settings_by_id),
           received_intervals(sst->num_received.size(), {-1, -1}),
           rdmc_group_num_offset(0),
+          rdmc_max_in_flight(std::max(getConfUInt32(CONF_DERECHO_RDMC_MAX_IN_FLIGHT), 1u)),
+          buffer_pool(std::make_unique<MessageBufferPool>(getConfUInt64(CONF_DERECHO_MESSAGE_BUFFER_SLAB_SIZE), 0)),
+          max_registered_send_buffers(getConfUInt32(CONF_DERECHO_MAX_REGISTERED_SEND_BUFFERS)),
           future_message_indices(total_num_subgroups, 0),
           next_sends(total_num_subgroups),
           committed_sst_index(total_num_subgroups, -1),
+          closed_sst_index(total_num_subgroups, -1),
           num_nulls_queued(total_num_subgroups, 0),
           first_null_index(total_num_subgroups, -1),
+          smc_unfinished_writes(total_num_subgroups),
+          smc_num_positions(total_num_subgroups, 0),
+          last_sst_send_position(total_num_subgroups, 0),
+          smc_packing(getConfBoolean(CONF_DERECHO_SMC_PACKING) && !getConfUInt64(CONF_DERECHO_SMC_RING_SIZE)),
+          open_smc_slots(total_num_subgroups),
+          smc_slots_taken(total_num_subgroups, 0),
+          smc_slot_last_message(total_num_subgroups),
+          smc_ring_size(getConfUInt64(CONF_DERECHO_SMC_RING_SIZE)),
+          smc_ring_entry_messages(total_num_subgroups),
+          smc_ring_read_positions(total_num_subgroups),
+          send_readiness(total_num_subgroups),
           pending_sends(total_num_subgroups),
           current_sends(total_num_subgroups),
+          current_receives(total_num_subgroups),
+          locally_stable_rdmc_messages(total_num_subgroups),
+          locally_stable_sst_messages(total_num_subgroups),
+          pending_message_timestamps(total_num_subgroups),
+          pending_persistence(total_num_subgroups),
+          non_persistent_messages(total_num_subgroups),
+          non_persistent_sst_messages(total_num_subgroups),
           next_message_to_deliver(total_num_subgroups),
           minimum_persisted_version(total_num_subgroups, persistent::INVALID_VERSION),
           minimum_verified_version(total_num_subgroups, persistent::INVALID_VERSION),
+          msg_state_mtxs(std::make_unique<std::recursive_mutex[]>(total_num_subgroups)),
           sender_timeout(sender_timeout),
           sst(sst),
           sst_multicast_group_ptrs(total_num_subgroups),
+          per_shard_smc(getConfBoolean(CONF_DERECHO_SST_PER_SHARD_SMC)),
+          smc_columns(total_num_subgroups),
+          smc_shard_ssts(total_num_subgroups),
           last_transfer_medium(total_num_subgroups),
+          batched_rpc_delivery(getConfBoolean(CONF_DERECHO_BATCHED_RPC_DELIVERY) && this->internal_callbacks.rpc_batch_callback),
+          rpc_batch_messages(total_num_subgroups),
+          rpc_batches(total_num_subgroups),
+          delivery_workers(total_num_subgroups),
           persistence_manager(persistence_manager_ref) {
     for(uint i = 0; i < num_members; ++i) {
         node_id_to_sst_index[members[i]] = i;
     }
-
-    for(const auto p : subgroup_settings_by_id) {
-        subgroup_id_t id = p.first;
-        const SubgroupSettings& settings = p.second;
-        auto num_shard_members = settings.members.size();
-        while(free_message_buffers[id].size() < settings.profile.window_size * num_shard_members) {
-            free_message_buffers[id].emplace_back(settings.profile.max_msg_size);
+    shard_sst_indices_by_subgroup.resize(total_num_subgroups);
+    for(const auto& p : subgroup_settings_by_id) {
+        std::vector<uint32_t>& shard_sst_indices = shard_sst_indices_by_subgroup[p.first];
+        for(const node_id_t shard_member : p.second.members) {
+            shard_sst_indices.push_back(node_id_to_sst_index.at(shard_member));
+        }
+        smc_slot_last_message[p.first].assign(p.second.profile.window_size, -1);
+        smc_ring_read_positions[p.first].assign(get_num_senders(p.second.senders), 0);
+        // Every ring entry takes at least as much of the ring as a null
+        smc_num_positions[p.first] = smc_ring_size ? smc_ring_size / sst::ring_entry_size(sizeof(header))
+                                                   : p.second.profile.window_size;
+        smc_unfinished_writes[p.first] = std::make_unique<std::atomic<uint32_t>[]>(smc_num_positions[p.first]);
+        // A subgroup's undelivered messages span at most one window of each sender's messages
+        const uint32_t num_shard_senders = get_num_senders(p.second.senders);
+        const std::size_t window_span = p.second.profile.window_size * num_shard_senders;
+        locally_stable_rdmc_messages[p.first].reserve(window_span);
+        locally_stable_sst_messages[p.first].reserve(window_span);
+        pending_persistence[p.first].reserve(window_span);
+        current_sends[p.first].reserve(get_num_rdmc_lanes(p.first) + 1);
+        current_receives[p.first].resize(num_shard_senders * get_num_rdmc_lanes(p.first));
+        SendReadiness& readiness = send_readiness[p.first];
+        readiness.is_sender = p.second.sender_rank >= 0;
+        readiness.ordered = p.second.mode != Mode::UNORDERED;
+        readiness.num_shard_senders = num_shard_senders;
+        readiness.sender_rank = p.second.sender_rank;
+        readiness.num_received_column = p.second.num_received_offset + std::max(p.second.sender_rank, 0);
+        readiness.num_rdmc_lanes = get_num_rdmc_lanes(p.first);
+        readiness.window_size = p.second.profile.window_size;
+        readiness.shard_sst_indices = shard_sst_indices;
+        if(getConfBoolean(CONF_DERECHO_DELIVERY_THREADS) && p.second.mode != Mode::UNORDERED) {
+            delivery_workers[p.first] = std::make_unique<DeliveryWorker>(window_span);
         }
     }
 
+    prepare_buffer_pool();
+    initialize_smc_columns(already_failed);
     initialize_sst_row();
     bool no_member_failed = true;
     if(already_failed.size()) {
@@ -87,6 +146,11 @@ MulticastGroup::MulticastGroup(
         // if groups are created successfully, rdmc_sst_groups_created will be set to true
         rdmc_sst_groups_created = create_rdmc_sst_groups();
     }
+    for(subgroup_id_t subgroup_num = 0; subgroup_num < total_num_subgroups; ++subgroup_num) {
+        if(delivery_workers[subgroup_num]) {
+            delivery_workers[subgroup_num]->thread = std::thread(&MulticastGroup::delivery_loop, this, subgroup_num);
+        }
+    }
     register_predicates();
     sender_thread = std::thread(&MulticastGroup::send_loop, this);
     timeout_thread = std::thread(&MulticastGroup::check_failures_loop, this);
@@ -108,20 +172,49 @@ MulticastGroup::MulticastGroup(
           subgroup_settings_map(subgroup_settings_by_id),
           received_intervals(sst->num_received.size(), {-1, -1}),
           rdmc_group_num_offset(old_group.rdmc_group_num_offset + old_group.num_members),
+          rdmc_max_in_flight(old_group.rdmc_max_in_flight),
+          max_registered_send_buffers(old_group.max_registered_send_buffers),
           future_message_indices(total_num_subgroups, 0),
           next_sends(total_num_subgroups),
           committed_sst_index(total_num_subgroups, -1),
+          closed_sst_index(total_num_subgroups, -1),
           num_nulls_queued(total_num_subgroups, 0),
           first_null_index(total_num_subgroups, -1),
+          smc_unfinished_writes(total_num_subgroups),
+          smc_num_positions(total_num_subgroups, 0),
+          last_sst_send_position(total_num_subgroups, 0),
+          smc_packing(getConfBoolean(CONF_DERECHO_SMC_PACKING) && !getConfUInt64(CONF_DERECHO_SMC_RING_SIZE)),
+          open_smc_slots(total_num_subgroups),
+          smc_slots_taken(total_num_subgroups, 0),
+          smc_slot_last_message(total_num_subgroups),
+          smc_ring_size(getConfUInt64(CONF_DERECHO_SMC_RING_SIZE)),
+          smc_ring_entry_messages(total_num_subgroups),
+          smc_ring_read_positions(total_num_subgroups),
+          send_readiness(total_num_subgroups),
           pending_sends(total_num_subgroups),
           current_sends(total_num_subgroups),
+          current_receives(total_num_subgroups),
+          locally_stable_rdmc_messages(total_num_subgroups),
+          locally_stable_sst_messages(total_num_subgroups),
+          pending_message_timestamps(total_num_subgroups),
+          pending_persistence(total_num_subgroups),
+          non_persistent_messages(total_num_subgroups),
+          non_persistent_sst_messages(total_num_subgroups),
           next_message_to_deliver(total_num_subgroups),
           minimum_persisted_version(total_num_subgroups, persistent::INVALID_VERSION),
           minimum_verified_version(total_num_subgroups, persistent::INVALID_VERSION),
+          msg_state_mtxs(std::make_unique<std::recursive_mutex[]>(total_num_subgroups)),
           sender_timeout(old_group.sender_timeout),
           sst(sst),
           sst_multicast_group_ptrs(total_num_subgroups),
+          per_shard_smc(getConfBoolean(CONF_DERECHO_SST_PER_SHARD_SMC)),
+          smc_columns(total_num_subgroups),
+          smc_shard_ssts(total_num_subgroups),
           last_transfer_medium(total_num_subgroups),
+          batched_rpc_delivery(getConfBoolean(CONF_DERECHO_BATCHED_RPC_DELIVERY) && this->internal_callbacks.rpc_batch_callback),
+          rpc_batch_messages(total_num_subgroups),
+          rpc_batches(total_num_subgroups),
+          delivery_workers(total_num_subgroups),
           persistence_manager(old_group.persistence_manager) {
     // Make sure rdmc_group_num_offset didn't overflow.
     assert(old_group.rdmc_group_num_offset <= std::numeric_limits<uint16_t>::max() - old_group.num_members - num_members);
@@ -132,6 +225,39 @@ MulticastGroup::MulticastGroup(
     for(uint i = 0; i < num_members; ++i) {
         node_id_to_sst_index[members[i]] = i;
     }
+    shard_sst_indices_by_subgroup.resize(total_num_subgroups);
+    for(const auto& p : subgroup_settings_by_id) {
+        std::vector<uint32_t>& shard_sst_indices = shard_sst_indices_by_subgroup[p.first];
+        for(const node_id_t shard_member : p.second.members) {
+            shard_sst_indices.push_back(node_id_to_sst_index.at(shard_member));
+        }
+        smc_slot_last_message[p.first].assign(p.second.profile.window_size, -1);
+        smc_ring_read_positions[p.first].assign(get_num_senders(p.second.senders), 0);
+        // Every ring entry takes at least as much of the ring as a null
+        smc_num_positions[p.first] = smc_ring_size ? smc_ring_size / sst::ring_entry_size(sizeof(header))
+                                                   : p.second.profile.window_size;
+        smc_unfinished_writes[p.first] = std::make_unique<std::atomic<uint32_t>[]>(smc_num_positions[p.first]);
+        // A subgroup's undelivered messages span at most one window of each sender's messages
+        const uint32_t num_shard_senders = get_num_senders(p.second.senders);
+        const std::size_t window_span = p.second.profile.window_size * num_shard_senders;
+        locally_stable_rdmc_messages[p.first].reserve(window_span);
+        locally_stable_sst_messages[p.first].reserve(window_span);
+        pending_persistence[p.first].reserve(window_span);
+        current_sends[p.first].reserve(get_num_rdmc_lanes(p.first) + 1);
+        current_receives[p.first].resize(num_shard_senders * get_num_rdmc_lanes(p.first));
+        SendReadiness& readiness = send_readiness[p.first];
+        readiness.is_sender = p.second.sender_rank >= 0;
+        readiness.ordered = p.second.mode != Mode::UNORDERED;
+        readiness.num_shard_senders = num_shard_senders;
+        readiness.sender_rank = p.second.sender_rank;
+        readiness.num_received_column = p.second.num_received_offset + std::max(p.second.sender_rank, 0);
+        readiness.num_rdmc_lanes = get_num_rdmc_lanes(p.first);
+        readiness.window_size = p.second.profile.window_size;
+        readiness.shard_sst_indices = shard_sst_indices;
+        if(getConfBoolean(CONF_DERECHO_DELIVERY_THREADS) && p.second.mode != Mode::UNORDERED) {
+            delivery_workers[p.first] = std::make_unique<DeliveryWorker>(window_span);
+        }
+    }
 
     // Convience function that takes a msg from the old group and
     // produces one suitable for this group.
@@ -149,68 +275,56 @@ MulticastGroup::MulticastGroup(
         return std::move(msg);
     };
 
-    for(const auto p : subgroup_settings_by_id) {
-        subgroup_id_t id = p.first;
-        const SubgroupSettings& settings = p.second;
-        auto num_shard_members = settings.members.size();
-        while(free_message_buffers[id].size() < settings.profile.window_size * num_shard_members) {
-            free_message_buffers[id].emplace_back(settings.profile.max_msg_size);
-        }
+    // Keep the application's send buffers registered across views
+    {
+        std::lock_guard<std::mutex> cache_lock(old_group.registration_cache_mtx);
+        registered_send_buffers.swap(old_group.registered_send_buffers);
+        registration_cache_clock = old_group.registration_cache_clock;
     }
 
-    // Reclaim RDMCMessageBuffers from the old group, and supplement them with
-    // additional if the group has grown.
-    std::lock_guard<std::recursive_mutex> lock(old_group.msg_state_mtx);
-    for(const auto p : subgroup_settings_by_id) {
-        const subgroup_id_t subgroup_num = p.first;
-        const SubgroupSettings& settings = p.second;
-        auto num_shard_members = settings.members.size();
-        // for later: don't move extra message buffers
-        free_message_buffers[subgroup_num].swap(old_group.free_message_buffers[subgroup_num]);
-        while(free_message_buffers[subgroup_num].size() < settings.profile.window_size * num_shard_members) {
-            free_message_buffers[subgroup_num].emplace_back(settings.profile.max_msg_size);
-        }
+    // Taking over the old group's message state touches every subgroup
+    std::vector<std::unique_lock<std::recursive_mutex>> old_group_locks;
+    for(subgroup_id_t subgroup_num = 0; subgroup_num < old_group.total_num_subgroups; ++subgroup_num) {
+        old_group_locks.emplace_back(old_group.msg_state_mtxs[subgroup_num]);
     }
+    // Reclaim the message buffers from the old group, along with the slabs they come from
+    buffer_pool = std::move(old_group.buffer_pool);
 
-    for(auto& msg : old_group.current_receives) {
-        free_message_buffers[msg.first.first].push_back(std::move(msg.second.message_buffer));
+    for(auto& subgroup_receives : old_group.current_receives) {
+        for(auto& msg : subgroup_receives) {
+            if(msg.message_buffer.mr) {
+                buffer_pool->release(std::move(msg.message_buffer));
+            }
+        }
+        subgroup_receives.clear();
     }
-    old_group.current_receives.clear();
 
     // Assume that any locally stable messages failed. If we were the sender
     // than re-attempt, otherwise discard. TODO: Presumably the ragged edge
     // cleanup will want the chance to deliver some of these.
-    for(auto& p : old_group.locally_stable_rdmc_messages) {
-        if(p.second.size() == 0) {
-            continue;
-        }
-
-        for(auto& q : p.second) {
-            if(q.second.sender_id == members[member_index]) {
-                pending_sends[p.first].push(convert_msg(q.second, p.first));
+    for(subgroup_id_t subgroup_num = 0; subgroup_num < old_group.locally_stable_rdmc_messages.size(); ++subgroup_num) {
+        old_group.locally_stable_rdmc_messages[subgroup_num].for_each([&](message_id_t, RDMCMessage& msg) {
+            if(msg.sender_id == members[member_index]) {
+                pending_sends[subgroup_num].push(convert_msg(msg, subgroup_num));
             } else {
-                free_message_buffers[p.first].push_back(std::move(q.second.message_buffer));
+                buffer_pool->release(std::move(msg.message_buffer));
             }
-        }
+        });
+        old_group.locally_stable_rdmc_messages[subgroup_num].clear();
     }
-    old_group.locally_stable_rdmc_messages.clear();
 
-    for(const auto p : subgroup_settings_by_id) {
-        subgroup_id_t id = p.first;
-        const SubgroupSettings& settings = p.second;
-        auto num_shard_members = settings.members.size();
-        while(free_message_buffers[id].size() < settings.profile.window_size * num_shard_members) {
-            free_message_buffers[id].emplace_back(settings.profile.max_msg_size);
-        }
+    for(auto& subgroup_messages : old_group.locally_stable_sst_messages) {
+        subgroup_messages.clear();
     }
 
-    old_group.locally_stable_sst_messages.clear();
-
     // Any messages that were being sent should be re-attempted.
     for(const auto& p : subgroup_settings_by_id) {
         auto subgroup_num = p.first;
-        if(old_group.current_sends.size() > subgroup_num && old_group.current_sends[subgroup_num]) {
-            pending_sends[subgroup_num].push(convert_msg(*old_group.current_sends[subgroup_num], subgroup_num));
+        if(old_group.current_sends.size() > subgroup_num) {
+            old_group.current_sends[subgroup_num].for_each([&](message_id_t, RDMCMessage& msg) {
+                pending_sends[subgroup_num].push(convert_msg(msg, subgroup_num));
+            });
+            old_group.current_sends[subgroup_num].clear();
         }
 
         if(old_group.pending_sends.size() > subgroup_num) {
@@ -224,18 +338,20 @@ MulticastGroup::MulticastGroup(
             next_sends[subgroup_num] = convert_msg(*old_group.next_sends[subgroup_num], subgroup_num);
         }
 
-        for(auto& entry : old_group.non_persistent_messages[subgroup_num]) {
-            non_persistent_messages[subgroup_num].emplace(entry.first,
-                                                          convert_msg(entry.second, subgroup_num));
+        if(old_group.non_persistent_messages.size() > subgroup_num) {
+            old_group.non_persistent_messages[subgroup_num].for_each([&](message_id_t seq_num, RDMCMessage& msg) {
+                non_persistent_messages[subgroup_num].emplace(seq_num, convert_msg(msg, subgroup_num));
+            });
+            old_group.non_persistent_messages[subgroup_num].clear();
+            old_group.non_persistent_sst_messages[subgroup_num].for_each([&](message_id_t seq_num, SSTMessage& msg) {
+                non_persistent_sst_messages[subgroup_num].emplace(seq_num, convert_sst_msg(msg, subgroup_num));
+            });
+            old_group.non_persistent_sst_messages[subgroup_num].clear();
         }
-        old_group.non_persistent_messages.clear();
-        for(auto& entry : old_group.non_persistent_sst_messages[subgroup_num]) {
-            non_persistent_sst_messages[subgroup_num].emplace(entry.first,
-                                                              convert_sst_msg(entry.second, subgroup_num));
-        }
-        old_group.non_persistent_sst_messages.clear();
     }
 
+    prepare_buffer_pool();
+    initialize_smc_columns(already_failed);
     initialize_sst_row();
     bool no_member_failed = true;
     if(already_failed.size()) {
@@ -250,6 +366,11 @@ MulticastGroup::MulticastGroup(
         // if groups are created successfully, rdmc_sst_groups_created will be set to true
         rdmc_sst_groups_created = create_rdmc_sst_groups();
     }
+    for(subgroup_id_t subgroup_num = 0; subgroup_num < total_num_subgroups; ++subgroup_num) {
+        if(delivery_workers[subgroup_num]) {
+            delivery_workers[subgroup_num]->thread = std::thread(&MulticastGroup::delivery_loop, this, subgroup_num);
+        }
+    }
     register_predicates();
     sender_thread = std::thread(&MulticastGroup::send_loop, this);
     timeout_thread = std::thread(&MulticastGroup::check_failures_loop, this);
@@ -265,9 +386,29 @@ bool MulticastGroup::create_rdmc_sst_groups() {
         uint32_t num_shard_senders = get_num_senders(shard_senders);
         auto shard_sst_indices = get_shard_sst_indices(subgroup_num);
 
-        sst_multicast_group_ptrs[subgroup_num] = std::make_unique<sst::multicast_group<DerechoSST>>(
-                sst, shard_sst_indices, subgroup_settings.profile.window_size, subgroup_settings.profile.sst_max_msg_size, subgroup_settings.senders,
-                subgroup_settings.num_received_offset, subgroup_settings.slot_offset, subgroup_settings.index_offset);
+        if(smc_ring_size) {
+            // Even right after wrapping, a ring that every member is done with must fit the largest message
+            if(2 * sst::ring_entry_size(subgroup_settings.profile.sst_max_msg_size) > smc_ring_size) {
+                throw derecho_exception("The SMC ring size (" + std::to_string(smc_ring_size)
+                                        + ") must be at least twice the maximum SMC message size");
+            }
+            if(smc_shard_ssts[subgroup_num]) {
+                sst_multicast_group_ptrs[subgroup_num] = std::make_unique<sst::multicast_ring<SMCShardSST>>(
+                        smc_shard_ssts[subgroup_num], smc_columns[subgroup_num].rows, smc_ring_size);
+            } else {
+                sst_multicast_group_ptrs[subgroup_num] = std::make_unique<sst::multicast_ring<DerechoSST>>(
+                        sst, shard_sst_indices, smc_ring_size,
+                        subgroup_settings.slot_offset, subgroup_settings.index_offset);
+            }
+        } else if(smc_shard_ssts[subgroup_num]) {
+            sst_multicast_group_ptrs[subgroup_num] = std::make_unique<sst::multicast_group<SMCShardSST>>(
+                    smc_shard_ssts[subgroup_num], smc_columns[subgroup_num].rows, subgroup_settings.profile.window_size,
+                    subgroup_settings.profile.sst_max_msg_size, subgroup_settings.senders);
+        } else {
+            sst_multicast_group_ptrs[subgroup_num] = std::make_unique<sst::multicast_group<DerechoSST>>(
+                    sst, shard_sst_indices, subgroup_settings.profile.window_size, subgroup_settings.profile.sst_max_msg_size, subgroup_settings.senders,
+                    subgroup_settings.num_received_offset, subgroup_settings.slot_offset, subgroup_settings.index_offset);
+        }
 
         if(subgroup_settings.profile.max_msg_size > subgroup_settings.profile.sst_max_msg_size) {
             for(uint shard_rank = 0, sender_rank = -1; shard_rank < num_shard_members; ++shard_rank) {
@@ -277,15 +418,16 @@ bool MulticastGroup::create_rdmc_sst_groups() {
                 }
                 sender_rank++;
                 node_id_t node_id = shard_members[shard_rank];
+                const uint32_t num_rdmc_lanes = get_num_rdmc_lanes(subgroup_num);
                 // When RDMC receives a message, it should store it in
                 // locally_stable_rdmc_messages and update the received count
                 rdmc::completion_callback_t rdmc_receive_handler;
                 rdmc_receive_handler = [this, subgroup_num, shard_rank, sender_rank,
                                         subgroup_settings, node_id,
-                                        num_shard_senders,
+                                        num_shard_senders, num_rdmc_lanes,
                                         shard_sst_indices](char* data, size_t size) {
                     assert(this->sst);
-                    std::lock_guard<std::recursive_mutex> lock(msg_state_mtx);
+                    std::lock_guard<std::recursive_mutex> lock(msg_state_mtxs[subgroup_num]);
                     header* h = (header*)data;
                     const int32_t index = h->index;
                     message_id_t sequence_number = index * num_shard_senders + sender_rank;
@@ -294,18 +436,18 @@ bool MulticastGroup::create_rdmc_sst_groups() {
                                       subgroup_num, shard_rank, index);
                     // Move message from current_receives to locally_stable_rdmc_messages.
                     if(node_id == members[member_index]) {
-                        assert(current_sends[subgroup_num]);
-                        locally_stable_rdmc_messages[subgroup_num][sequence_number] = std::move(*current_sends[subgroup_num]);
-                        current_sends[subgroup_num] = std::nullopt;
+                        RDMCMessage* sent_msg = current_sends[subgroup_num].find(index);
+                        assert(sent_msg);
+                        locally_stable_rdmc_messages[subgroup_num].emplace(sequence_number, std::move(*sent_msg));
+                        current_sends[subgroup_num].erase(index);
                     } else {
-                        auto it = current_receives.find({subgroup_num, node_id});
-                        assert(it != current_receives.end());
-                        auto& msg = it->second;
+                        auto& msg = current_receives[subgroup_num][sender_rank * num_rdmc_lanes + index % num_rdmc_lanes];
+                        assert(msg.message_buffer.mr);
                         msg.index = index;
                         // We set the size in this receive handler instead of in the incoming_message_handler
                         msg.size = size;
                         locally_stable_rdmc_messages[subgroup_num].emplace(sequence_number, std::move(msg));
-                        current_receives.erase(it);
+                        msg = RDMCMessage();
                     }
 
                     auto new_num_received = resolve_num_received(index, subgroup_settings.num_received_offset + sender_rank);
@@ -330,8 +472,8 @@ bool MulticastGroup::create_rdmc_sst_groups() {
                             i <= new_num_received; ++i) {
                             message_id_t seq_num = i * num_shard_senders + sender_rank;
                             if(!locally_stable_sst_messages[subgroup_num].empty()
-                               && locally_stable_sst_messages[subgroup_num].begin()->first == seq_num) {
-                                auto& msg = locally_stable_sst_messages[subgroup_num].begin()->second;
+                               && locally_stable_sst_messages[subgroup_num].front_id() == seq_num) {
+                                auto& msg = locally_stable_sst_messages[subgroup_num].front();
                                 char* buf = const_cast<char*>(msg.buf);
                                 header* h = (header*)(buf);
                                 // no delivery callback for a NULL message
@@ -344,13 +486,12 @@ bool MulticastGroup::create_rdmc_sst_groups() {
                                 if(node_id == members[member_index]) {
                                     pending_message_timestamps[subgroup_num].erase(h->timestamp);
                                 }
-                                locally_stable_sst_messages[subgroup_num].erase(locally_stable_sst_messages[subgroup_num].begin());
+                                locally_stable_sst_messages[subgroup_num].pop_front();
                             } else {
                                 assert(!locally_stable_rdmc_messages[subgroup_num].empty());
-                                auto it2 = locally_stable_rdmc_messages[subgroup_num].begin();
-                                assert(it2->first == seq_num);
-                                auto& msg = it2->second;
-                                char* buf = msg.message_buffer.buffer.get();
+                                assert(locally_stable_rdmc_messages[subgroup_num].front_id() == seq_num);
+                                auto& msg = locally_stable_rdmc_messages[subgroup_num].front();
+                                char* buf = msg.message_buffer.data();
                                 header* h = (header*)(buf);
                                 // no delivery for a NULL message
                                 if(msg.size > h->header_size && callbacks.global_stability_callback) {
@@ -359,11 +500,11 @@ bool MulticastGroup::create_rdmc_sst_groups() {
                                                                         {{buf + h->header_size, msg.size - h->header_size}},
                                                                         persistent::INVALID_VERSION);
                                 }
-                                free_message_buffers[subgroup_num].push_back(std::move(msg.message_buffer));
                                 if(node_id == members[member_index]) {
                                     pending_message_timestamps[subgroup_num].erase(h->timestamp);
                                 }
-                                locally_stable_rdmc_messages[subgroup_num].erase(it2);
+                                release_message_buffer(std::move(msg.message_buffer));
+                                locally_stable_rdmc_messages[subgroup_num].pop_front();
                             }
                         }
                     }
@@ -374,15 +515,16 @@ bool MulticastGroup::create_rdmc_sst_groups() {
                                                          &sst->num_received[member_index][subgroup_settings.num_received_offset + num_shard_senders]);
                         uint min_index = std::distance(&sst->num_received[member_index][subgroup_settings.num_received_offset], min_ptr);
                         auto new_seq_num = (*min_ptr + 1) * num_shard_senders + min_index - 1;
+                        sst::SSTWriteBatch batch = sst->make_write_batch();
                         if(static_cast<message_id_t>(new_seq_num) > sst->seq_num[member_index][subgroup_num]) {
                             dbg_default_trace("Updating seq_num for subgroup {} to {}", subgroup_num, new_seq_num);
                             sst->seq_num[member_index][subgroup_num] = new_seq_num;
-                            sst->put(shard_sst_indices,
-                                     sst->seq_num, subgroup_num);
+                            batch.add(sst->seq_num, subgroup_num);
+                            batch.fence();
                         }
-                        sst->put(shard_sst_indices,
-                                 sst->num_received,
-                                 subgroup_settings.num_received_offset + sender_rank);
+                        batch.add(sst->num_received,
+                                  subgroup_settings.num_received_offset + sender_rank);
+                        sst->put(shard_sst_indices, batch);
                     }
                 };
                 // Capture rdmc_receive_handler by copy! The reference to it won't be valid after this constructor ends!
@@ -390,7 +532,7 @@ bool MulticastGroup::create_rdmc_sst_groups() {
                         [this, rdmc_receive_handler](char* data, size_t size) {
                             rdmc_receive_handler(data, size);
                             // signal background writer thread
-                            sender_cv.notify_all();
+                            wake_sender();
                         };
 
                 // Create a "rotated" vector of members in which the currently selected shard member (shard_rank) is first
@@ -405,45 +547,50 @@ bool MulticastGroup::create_rdmc_sst_groups() {
                     continue;
                 }
 
-                if(node_id == members[member_index]) {
-                    //Create a group in which this node is the sender, and only self-receives happen
-                    if(!rdmc::create_group(
-                               rdmc_group_num_offset, rotated_shard_members, subgroup_settings.profile.block_size, subgroup_settings.profile.rdmc_send_algorithm,
-                               [](size_t length) -> rdmc::receive_destination {
-                                   assert_always(false);
-                                   return {nullptr, 0};
-                               },
-                               receive_handler_plus_notify,
-                               [](std::optional<uint32_t>) {})) {
-                        return false;
-                    }
-                    subgroup_to_rdmc_group[subgroup_num] = rdmc_group_num_offset;
-                    rdmc_group_num_offset++;
-                } else {
-                    if(!rdmc::create_group(
-                               rdmc_group_num_offset, rotated_shard_members, subgroup_settings.profile.block_size, subgroup_settings.profile.rdmc_send_algorithm,
-                               [this, subgroup_num, node_id](size_t length) {
-                                   std::lock_guard<std::recursive_mutex> lock(msg_state_mtx);
-                                   assert(!free_message_buffers[subgroup_num].empty());
-                                   //Create a Message struct to receive the data into.
-                                   RDMCMessage msg;
-                                   msg.sender_id = node_id;
-                                   // The length variable is not the exact size of the msg,
-                                   // but it is the nearest multiple of the block size greater then the size
-                                   // so we will set the size in the receive handler
-                                   msg.message_buffer = std::move(free_message_buffers[subgroup_num].back());
-                                   free_message_buffers[subgroup_num].pop_back();
-
-                                   rdmc::receive_destination ret{msg.message_buffer.mr, 0};
-                                   current_receives[{subgroup_num, node_id}] = std::move(msg);
-
-                                   assert(ret.mr->buffer != nullptr);
-                                   return ret;
-                               },
-                               rdmc_receive_handler, [](std::optional<uint32_t>) {})) {
-                        return false;
+                // Each sender sends its messages to num_rdmc_lanes groups in turn
+                for(uint32_t lane = 0; lane < num_rdmc_lanes; ++lane) {
+                    if(node_id == members[member_index]) {
+                        //Create a group in which this node is the sender, and only self-receives happen
+                        if(!rdmc::create_group(
+                                   rdmc_group_num_offset, rotated_shard_members, subgroup_settings.profile.block_size, subgroup_settings.profile.rdmc_send_algorithm,
+                                   [](size_t length) -> rdmc::receive_destination {
+                                       assert_always(false);
+                                       return {nullptr, 0};
+                                   },
+                                   receive_handler_plus_notify,
+                                   [](std::optional<uint32_t>) {})) {
+                            return false;
+                        }
+                        if(lane == 0) {
+                            subgroup_to_rdmc_group[subgroup_num] = rdmc_group_num_offset;
+                        }
+                        rdmc_group_num_offset++;
+                    } else {
+                        if(!rdmc::create_group(
+                                   rdmc_group_num_offset, rotated_shard_members, subgroup_settings.profile.block_size, subgroup_settings.profile.rdmc_send_algorithm,
+                                   [this, subgroup_num, node_id, receive_slot = sender_rank * num_rdmc_lanes + lane](size_t length) {
+                                       std::lock_guard<std::recursive_mutex> lock(msg_state_mtxs[subgroup_num]);
+                                       //Create a Message struct to receive the data into.
+                                       RDMCMessage msg;
+                                       msg.sender_id = node_id;
+                                       // The length variable is not the exact size of the msg,
+                                       // but it is the nearest multiple of the block size greater then the size
+                                       // so we will set the size in the receive handler
+                                       // An incoming message cannot be refused; with the default limit,
+                                       // the window keeps the buffers for it within the limit
+                                       msg.message_buffer = buffer_pool->allocate(length, true);
+
+                                       rdmc::receive_destination ret{msg.message_buffer.mr, msg.message_buffer.offset()};
+                                       current_receives[subgroup_num][receive_slot] = std::move(msg);
+
+                                       assert(ret.mr->buffer != nullptr);
+                                       return ret;
+                                   },
+                                   rdmc_receive_handler, [](std::optional<uint32_t>) {})) {
+                            return false;
+                        }
+                        rdmc_group_num_offset++;
                     }
-                    rdmc_group_num_offset++;
                 }
             }
         }
@@ -465,12 +612,75 @@ void MulticastGroup::initialize_sst_row() {
         sst->verified_num[member_index][j] = -1;
     }
     memset(const_cast<unsigned char*>(sst->signatures[member_index]), 0, sst->signatures.size());
-    for(uint j = 0; j < total_num_subgroups; j++) {
+    for(uint j = 0; j < sst->index.size(); j++) {
         sst->index[member_index][j] = -1;
     }
     // No put(), no sync(). The caller will issue them later.
 }
 
+void MulticastGroup::initialize_smc_columns(const std::vector<char>& already_failed) {
+    for(const auto& p : subgroup_settings_map) {
+        const subgroup_id_t subgroup_num = p.first;
+        const SubgroupSettings& subgroup_settings = p.second;
+        SMCColumns& columns = smc_columns[subgroup_num];
+        if(!per_shard_smc) {
+            columns.slots = &sst->slots;
+            columns.num_received_sst = &sst->num_received_sst;
+            columns.index = &sst->index;
+            columns.slot_offset = subgroup_settings.slot_offset;
+            columns.num_received_offset = subgroup_settings.num_received_offset;
+            columns.index_offset = subgroup_settings.index_offset;
+            columns.rows = get_shard_sst_indices(subgroup_num);
+            columns.my_row = member_index;
+            continue;
+        }
+        const std::vector<node_id_t>& shard_members = subgroup_settings.members;
+        std::vector<char> shard_failed;
+        if(!already_failed.empty()) {
+            for(const node_id_t shard_member : shard_members) {
+                shard_failed.push_back(already_failed[node_id_to_sst_index.at(shard_member)]);
+            }
+        }
+        const DerechoParams& profile = subgroup_settings.profile;
+        const uint64_t slot_size = profile.smc_region_size();
+        // The shard SST has no predicates of its own, so it needs no predicate
+        // threads: the SMC predicates stay in the top-level SST and read these
+        // columns through smc_columns. A failure it detects is reported by
+        // freezing the member's row in the top-level SST.
+        auto shard_sst = std::make_shared<SMCShardSST>(
+                sst::SSTParams(shard_members, members[member_index],
+                               [this](const uint32_t node_id) { sst->freeze(node_id_to_sst_index.at(node_id)); },
+                               shard_failed, false, false),
+                slot_size, get_num_senders(subgroup_settings.senders));
+        // Wait until every shard member has initialized its copy of the table,
+        // so that no member's first SMC push can be overwritten by that initialization
+        shard_sst->sync_with_members();
+        dbg_default_debug("Created SMC SST for subgroup {} with {} rows of {} bytes",
+                          subgroup_num, shard_members.size(), shard_sst->get_row_length());
+
+        columns.slots = &shard_sst->slots;
+        columns.num_received_sst = &shard_sst->num_received_sst;
+        columns.index = &shard_sst->index;
+        columns.rows.resize(shard_members.size());
+        std::iota(columns.rows.begin(), columns.rows.end(), 0);
+        columns.my_row = subgroup_settings.shard_rank;
+        smc_shard_ssts[subgroup_num] = std::move(shard_sst);
+    }
+}
+
+void MulticastGroup::freeze_shard_sst_rows(node_id_t failed_node) {
+    for(const auto& p : subgroup_settings_map) {
+        if(!smc_shard_ssts[p.first]) {
+            continue;
+        }
+        const std::vector<node_id_t>& shard_members = p.second.members;
+        auto member_it = std::find(shard_members.begin(), shard_members.end(), failed_node);
+        if(member_it != shard_members.end()) {
+            smc_shard_ssts[p.first]->freeze(member_it - shard_members.begin());
+        }
+    }
+}
+
 void MulticastGroup::deliver_message(RDMCMessage& msg, const subgroup_id_t& subgroup_num,
                                      const persistent::version_t& version,
                                      const uint64_t& msg_ts_us) {
@@ -478,7 +688,7 @@ void MulticastGroup::deliver_message(RDMCMessage& msg, const subgroup_id_t& subg
         return;
     }
 
-    char* buf = msg.message_buffer.buffer.get();
+    char* buf = msg.message_buffer.data();
     header* h = (header*)(buf);
     // cooked send
     if(h->cooked_send) {
@@ -524,16 +734,16 @@ void MulticastGroup::deliver_message(SSTMessage& msg, const subgroup_id_t& subgr
     }
 }
 
-bool MulticastGroup::version_message(RDMCMessage& msg, const subgroup_id_t& subgroup_num,
+bool MulticastGroup::version_message(RDMCMessage& msg, const subgroup_id_t& subgroup_num, message_id_t seq_num,
                                      const persistent::version_t& version, const uint64_t& msg_timestamp) {
-    char* buf = msg.message_buffer.buffer.get();
+    char* buf = msg.message_buffer.data();
     header* h = (header*)(buf);
     // null message filter
     if(msg.size == h->header_size) {
         return false;
     }
     if(msg.sender_id == members[member_index]) {
-        pending_persistence[subgroup_num][locally_stable_rdmc_messages[subgroup_num].begin()->first] = msg_timestamp;
+        pending_persistence[subgroup_num].emplace(seq_num, msg_timestamp);
     }
     // make a version for persistent<t>/volatile<t>
     uint64_t msg_ts_us = msg_timestamp / 1e3;
@@ -546,7 +756,7 @@ bool MulticastGroup::version_message(RDMCMessage& msg, const subgroup_id_t& subg
     return true;
 }
 
-bool MulticastGroup::version_message(SSTMessage& msg, const subgroup_id_t& subgroup_num,
+bool MulticastGroup::version_message(SSTMessage& msg, const subgroup_id_t& subgroup_num, message_id_t seq_num,
                                      const persistent::version_t& version, const uint64_t& msg_timestamp) {
     char* buf = const_cast<char*>(msg.buf);
     header* h = (header*)(buf);
@@ -555,7 +765,7 @@ bool MulticastGroup::version_message(SSTMessage& msg, const subgroup_id_t& subgr
         return false;
     }
     if(msg.sender_id == members[member_index]) {
-        pending_persistence[subgroup_num][locally_stable_sst_messages[subgroup_num].begin()->first] = msg_timestamp;
+        pending_persistence[subgroup_num].emplace(seq_num, msg_timestamp);
     }
     // make a version for persistent<t>/volatile<t>
     uint64_t msg_ts_us = msg_timestamp / 1e3;
@@ -568,13 +778,59 @@ bool MulticastGroup::version_message(SSTMessage& msg, const subgroup_id_t& subgr
     return true;
 }
 
+void MulticastGroup::deliver_rpc_batch(subgroup_id_t subgroup_num) {
+    std::vector<StableMessage>& batched_messages = rpc_batch_messages[subgroup_num];
+    if(batched_messages.empty()) {
+        return;
+    }
+    std::vector<rpc_message_t>& batch = rpc_batches[subgroup_num];
+    batch.clear();
+    for(StableMessage& batched : batched_messages) {
+        char* buf = batched.is_rdmc ? batched.rdmc_message.message_buffer.data() : const_cast<char*>(batched.sst_message.buf);
+        header* h = (header*)(buf);
+        const long long unsigned int msg_size = batched.is_rdmc ? batched.rdmc_message.size : batched.sst_message.size;
+        batch.push_back({batched.is_rdmc ? batched.rdmc_message.sender_id : batched.sst_message.sender_id,
+                         batched.version, batched.msg_timestamp / 1000,
+                         buf + h->header_size, static_cast<uint32_t>(msg_size - h->header_size)});
+    }
+    // Finishes delivering a message once its RPC function has run, and posts the next message's version
+    auto message_delivered = [&](std::size_t position) {
+        StableMessage& batched = batched_messages[position];
+        const rpc_message_t& message = batch[position];
+        if(callbacks.global_stability_callback) {
+            callbacks.global_stability_callback(subgroup_num, message.sender_id,
+                                                batched.is_rdmc ? batched.rdmc_message.index : batched.sst_message.index,
+                                                {}, message.version);
+        }
+        {
+            std::lock_guard<std::recursive_mutex> lock(msg_state_mtxs[subgroup_num]);
+            if(batched.is_rdmc) {
+                version_message(batched.rdmc_message, subgroup_num, batched.seq_num, message.version, batched.msg_timestamp);
+            } else {
+                version_message(batched.sst_message, subgroup_num, batched.seq_num, message.version, batched.msg_timestamp);
+            }
+            sst->delivered_num[member_index][subgroup_num] = batched.seq_num;
+        }
+        if(batched.is_rdmc) {
+            release_message_buffer(std::move(batched.rdmc_message.message_buffer));
+        }
+        if(position + 1 < batch.size()) {
+            internal_callbacks.post_next_version_callback(subgroup_num, batch[position + 1].version,
+                                                          batch[position + 1].timestamp);
+        }
+    };
+    internal_callbacks.post_next_version_callback(subgroup_num, batch.front().version, batch.front().timestamp);
+    internal_callbacks.rpc_batch_callback(subgroup_num, batch, message_delivered);
+    batched_messages.clear();
+}
+
 void MulticastGroup::deliver_messages_upto(
         const std::vector<int32_t>& max_indices_for_senders,
         subgroup_id_t subgroup_num, uint32_t num_shard_senders) {
     bool non_null_msgs_delivered = false;
     assert(max_indices_for_senders.size() == (size_t)num_shard_senders);
     {
-        std::lock_guard<std::recursive_mutex> lock(msg_state_mtx);
+        std::unique_lock<std::recursive_mutex> lock(msg_state_mtxs[subgroup_num]);
         int32_t curr_seq_num = sst->delivered_num[member_index][subgroup_num];
         int32_t max_seq_num = curr_seq_num;
         for(uint sender = 0; sender < num_shard_senders; sender++) {
@@ -582,6 +838,7 @@ void MulticastGroup::deliver_messages_upto(
                                    static_cast<int32_t>(max_indices_for_senders[sender] * num_shard_senders + sender));
         }
         persistent::version_t assigned_version = persistent::INVALID_VERSION;
+        StableMessage stable;
         for(int32_t seq_num = curr_seq_num + 1; seq_num <= max_seq_num; seq_num++) {
             //determine if this sequence number should actually be skipped
             int32_t index = seq_num / num_shard_senders;
@@ -589,28 +846,37 @@ void MulticastGroup::deliver_messages_upto(
             if(index > max_indices_for_senders[sender_rank]) {
                 continue;
             }
-            auto rdmc_msg_ptr = locally_stable_rdmc_messages[subgroup_num].find(seq_num);
+            RDMCMessage* rdmc_msg_ptr = locally_stable_rdmc_messages[subgroup_num].find(seq_num);
             assigned_version = persistent::combine_int32s(sst->vid[member_index], seq_num);
-            if(rdmc_msg_ptr != locally_stable_rdmc_messages[subgroup_num].end()) {
-                auto& msg = rdmc_msg_ptr->second;
-                char* buf = msg.message_buffer.buffer.get();
-                uint64_t msg_ts = ((header*)buf)->timestamp;
-                //Note: deliver_message frees the RDMC buffer in msg, which is why the timestamp must be saved before calling this
-                deliver_message(msg, subgroup_num, assigned_version, msg_ts / 1000);
-                non_null_msgs_delivered |= version_message(msg, subgroup_num, assigned_version, msg_ts);
-                // free the message buffer only after it version_message has been called
-                free_message_buffers[subgroup_num].push_back(std::move(msg.message_buffer));
-                locally_stable_rdmc_messages[subgroup_num].erase(rdmc_msg_ptr);
+            stable = StableMessage{seq_num, assigned_version, 0, rdmc_msg_ptr != nullptr, RDMCMessage(), SSTMessage()};
+            if(rdmc_msg_ptr) {
+                stable.rdmc_message = std::move(*rdmc_msg_ptr);
+                stable.msg_timestamp = ((header*)stable.rdmc_message.message_buffer.data())->timestamp;
+                locally_stable_rdmc_messages[subgroup_num].erase(seq_num);
             } else {
                 dbg_default_trace("Subgroup {}, deliver_messages_upto delivering an SST message with seq_num = {}",
                                   subgroup_num, seq_num);
-                auto& msg = locally_stable_sst_messages[subgroup_num].at(seq_num);
-                char* buf = (char*)msg.buf;
-                uint64_t msg_ts = ((header*)buf)->timestamp;
-                deliver_message(msg, subgroup_num, assigned_version, msg_ts / 1000);
-                non_null_msgs_delivered |= version_message(msg, subgroup_num, assigned_version, msg_ts);
+                SSTMessage* sst_msg_ptr = locally_stable_sst_messages[subgroup_num].find(seq_num);
+                assert(sst_msg_ptr);
+                stable.sst_message = *sst_msg_ptr;
+                stable.msg_timestamp = ((header*)stable.sst_message.buf)->timestamp;
                 locally_stable_sst_messages[subgroup_num].erase(seq_num);
             }
+            // As in delivery_trigger, the upcall runs without the subgroup's lock
+            lock.unlock();
+            if(stable.is_rdmc) {
+                deliver_message(stable.rdmc_message, subgroup_num, assigned_version, stable.msg_timestamp / 1000);
+            } else {
+                deliver_message(stable.sst_message, subgroup_num, assigned_version, stable.msg_timestamp / 1000);
+            }
+            lock.lock();
+            if(stable.is_rdmc) {
+                non_null_msgs_delivered |= version_message(stable.rdmc_message, subgroup_num, seq_num, assigned_version, stable.msg_timestamp);
+                // free the message buffer only after it version_message has been called
+                release_message_buffer(std::move(stable.rdmc_message.message_buffer));
+            } else {
+                non_null_msgs_delivered |= version_message(stable.sst_message, subgroup_num, seq_num, assigned_version, stable.msg_timestamp);
+            }
         }
         gmssst::set(sst->delivered_num[member_index][subgroup_num], max_seq_num);
         if(non_null_msgs_delivered) {
@@ -656,13 +922,14 @@ int32_t MulticastGroup::resolve_num_received(int32_t index, uint32_t num_receive
     return *std::next(received_intervals[num_received_entry].begin());
 }
 
-bool MulticastGroup::receiver_predicate(const SubgroupSettings& subgroup_settings,
+bool MulticastGroup::receiver_predicate(subgroup_id_t subgroup_num, const SubgroupSettings& subgroup_settings,
                                         const std::map<uint32_t, uint32_t>& shard_ranks_by_sender_rank,
                                         uint32_t num_shard_senders, const DerechoSST& sst) {
+    const SMCColumns& smc = smc_columns[subgroup_num];
     for(uint sender_count = 0; sender_count < num_shard_senders; ++sender_count) {
         // Equivalent to read_seq_num[sender_count] > last_seq_num[sender_count]
-        if((message_id_t)sst.index[node_id_to_sst_index.at(subgroup_settings.members[shard_ranks_by_sender_rank.at(sender_count)])][subgroup_settings.index_offset]
-           > sst.num_received_sst[member_index][subgroup_settings.num_received_offset + sender_count]) {
+        if((message_id_t)(*smc.index)[smc.rows[shard_ranks_by_sender_rank.at(sender_count)]][smc.index_offset]
+           > (*smc.num_received_sst)[smc.my_row][smc.num_received_offset + sender_count]) {
             return true;
         }
     }
@@ -684,7 +951,7 @@ void MulticastGroup::sst_receive_handler(subgroup_id_t subgroup_num, const Subgr
         message_id_t sequence_number = index * num_shard_senders + sender_rank;
         node_id_t node_id = subgroup_settings.members[shard_ranks_by_sender_rank.at(sender_rank)];
 
-        locally_stable_sst_messages[subgroup_num][sequence_number] = {node_id, index, size, data};
+        locally_stable_sst_messages[subgroup_num].emplace(sequence_number, SSTMessage{node_id, index, size, data});
 
         auto new_num_received = resolve_num_received(index, subgroup_settings.num_received_offset + sender_rank);
 
@@ -707,8 +974,8 @@ void MulticastGroup::sst_receive_handler(subgroup_id_t subgroup_num, const Subgr
             for(int i = sst->num_received[member_index][subgroup_settings.num_received_offset + sender_rank] + 1; i <= new_num_received; ++i) {
                 message_id_t seq_num = i * num_shard_senders + sender_rank;
                 if(!locally_stable_sst_messages[subgroup_num].empty()
-                   && locally_stable_sst_messages[subgroup_num].begin()->first == seq_num) {
-                    auto& msg = locally_stable_sst_messages[subgroup_num].begin()->second;
+                   && locally_stable_sst_messages[subgroup_num].front_id() == seq_num) {
+                    auto& msg = locally_stable_sst_messages[subgroup_num].front();
                     char* buf = const_cast<char*>(msg.buf);
                     header* h = (header*)(buf);
                     if(msg.size > h->header_size && callbacks.global_stability_callback) {
@@ -720,13 +987,12 @@ void MulticastGroup::sst_receive_handler(subgroup_id_t subgroup_num, const Subgr
                     if(node_id == members[member_index]) {
                         pending_message_timestamps[subgroup_num].erase(h->timestamp);
                     }
-                    locally_stable_sst_messages[subgroup_num].erase(locally_stable_sst_messages[subgroup_num].begin());
+                    locally_stable_sst_messages[subgroup_num].pop_front();
                 } else {
                     assert(!locally_stable_rdmc_messages[subgroup_num].empty());
-                    auto it2 = locally_stable_rdmc_messages[subgroup_num].begin();
-                    assert(it2->first == seq_num);
-                    auto& msg = it2->second;
-                    char* buf = msg.message_buffer.buffer.get();
+                    assert(locally_stable_rdmc_messages[subgroup_num].front_id() == seq_num);
+                    auto& msg = locally_stable_rdmc_messages[subgroup_num].front();
+                    char* buf = msg.message_buffer.data();
                     header* h = (header*)(buf);
                     if(msg.size > h->header_size && callbacks.global_stability_callback) {
                         callbacks.global_stability_callback(subgroup_num, msg.sender_id,
@@ -734,11 +1000,11 @@ void MulticastGroup::sst_receive_handler(subgroup_id_t subgroup_num, const Subgr
                                                             {{buf + h->header_size, msg.size - h->header_size}},
                                                             persistent::INVALID_VERSION);
                     }
-                    free_message_buffers[subgroup_num].push_back(std::move(msg.message_buffer));
                     if(node_id == members[member_index]) {
                         pending_message_timestamps[subgroup_num].erase(h->timestamp);
                     }
-                    locally_stable_rdmc_messages[subgroup_num].erase(it2);
+                    release_message_buffer(std::move(msg.message_buffer));
+                    locally_stable_rdmc_messages[subgroup_num].pop_front();
                 }
             }
         }
@@ -754,31 +1020,56 @@ void MulticastGroup::receiver_function(subgroup_id_t subgroup_num, const Subgrou
     DerechoParams profile = subgroup_settings.profile;
     const uint64_t slot_width = profile.sst_max_msg_size + sizeof(uint64_t);
 
+    const SMCColumns& smc = smc_columns[subgroup_num];
     bool put_new_seq_num = false;
     {
-        std::lock_guard<std::recursive_mutex> lock(msg_state_mtx);
+        std::lock_guard<std::recursive_mutex> lock(msg_state_mtxs[subgroup_num]);
         for(uint sender_count = 0; sender_count < num_shard_senders; ++sender_count) {
-            const uint32_t sender_sst_index = node_id_to_sst_index.at(subgroup_settings.members[shard_ranks_by_sender_rank.at(sender_count)]);
+            const uint32_t sender_sst_index = smc.rows[shard_ranks_by_sender_rank.at(sender_count)];
             uint32_t slot;
-            message_id_t old_index = sst.num_received_sst[member_index][subgroup_settings.num_received_offset + sender_count];
-            const message_id_t received_index = sst.index[sender_sst_index][subgroup_settings.index_offset];
+            message_id_t old_index = (*smc.num_received_sst)[smc.my_row][smc.num_received_offset + sender_count];
+            const message_id_t received_index = (*smc.index)[sender_sst_index][smc.index_offset];
             while(received_index > old_index) {
                 old_index++;
+                if(smc_ring_size) {
+                    // Every entry holds one message, nulls included
+                    uint32_t size;
+                    volatile char* msg = sst::read_ring_entry(&(*smc.slots)[sender_sst_index][smc.slot_offset], smc_ring_size,
+                                                              smc_ring_read_positions[subgroup_num][sender_count], size);
+                    sst_receive_handler_lambda(sender_count, msg, size);
+                    (*smc.num_received_sst)[smc.my_row][smc.num_received_offset + sender_count] = old_index;
+                    continue;
+                }
                 slot = old_index % profile.window_size;
                 dbg_default_trace("receiver_trig calling sst_receive_handler_lambda. next_seq = {}, num_received = {}, sender rank = {}. Reading from SST row {}, slot {}",
-                                  received_index, old_index, sender_count, sender_sst_index, subgroup_settings.slot_offset + slot_width * slot);
-                sst_receive_handler_lambda(sender_count,
-                                           &sst.slots[sender_sst_index]
-                                                     [subgroup_settings.slot_offset + slot_width * slot],
-                                           (uint64_t&)sst.slots[sender_sst_index]
-                                                               [subgroup_settings.slot_offset + slot_width * (slot + 1) - sizeof(uint64_t)]);
+                                  received_index, old_index, sender_count, sender_sst_index, smc.slot_offset + slot_width * slot);
+                volatile char* slot_buf = &(*smc.slots)[sender_sst_index][smc.slot_offset + slot_width * slot];
+                header* h;
+                if(smc_packing) {
+                    // Hand over the slot's messages in order, stopping at the end marker or at a null
+                    uint64_t offset = 0;
+                    do {
+                        const uint32_t size = ((packed_message_header*)(slot_buf + offset))->size;
+                        if(size == 0) {
+                            break;
+                        }
+                        h = (header*)(slot_buf + offset + sizeof(packed_message_header));
+                        sst_receive_handler_lambda(sender_count, slot_buf + offset + sizeof(packed_message_header), size);
+                        offset += sizeof(packed_message_header) + size;
+                    } while(h->num_nulls == 0 && offset + sizeof(packed_message_header) <= profile.sst_max_msg_size);
+                    h = (header*)(slot_buf + sizeof(packed_message_header));
+                } else {
+                    sst_receive_handler_lambda(sender_count, slot_buf,
+                                               (uint64_t&)(*smc.slots)[sender_sst_index]
+                                                                      [smc.slot_offset + slot_width * (slot + 1) - sizeof(uint64_t)]);
+                    h = (header*)slot_buf;
+                }
 
                 // I pretend I received all the nulls, when actually I have received only the first one
-                header* h = (header*)&sst.slots[sender_sst_index][subgroup_settings.slot_offset + slot_width * slot];
                 if(h->num_nulls > 0) {
                     old_index += h->num_nulls - 1;
                 }
-                sst.num_received_sst[member_index][subgroup_settings.num_received_offset + sender_count] = old_index;
+                (*smc.num_received_sst)[smc.my_row][smc.num_received_offset + sender_count] = old_index;
             }
             // std::atomic_signal_fence(std::memory_order_acq_rel);
             auto* min_ptr = std::min_element(&sst.num_received[member_index][subgroup_settings.num_received_offset],
@@ -793,130 +1084,238 @@ void MulticastGroup::receiver_function(subgroup_id_t subgroup_num, const Subgrou
         }
     }
     // lock released: puts can happen.
-    sst.put((char*)std::addressof(sst.num_received_sst[0][subgroup_settings.num_received_offset]) - sst.getBaseAddress(),
-            sizeof(decltype(sst.num_received_sst)::value_type) * num_shard_senders);
+    // Push all three fields, in order, as one batch of writes per member
+    // (num_received_sst goes separately to the shard's own SMC SST, if it has one)
+    sst::SSTWriteBatch batch = sst.make_write_batch();
+    if(smc_shard_ssts[subgroup_num]) {
+        smc_shard_ssts[subgroup_num]->put(smc_shard_ssts[subgroup_num]->num_received_sst);
+    } else {
+        batch.add(sst.num_received_sst, subgroup_settings.num_received_offset, num_shard_senders);
+        batch.fence();
+    }
     if(put_new_seq_num) {
-        sst.put(sst.seq_num, subgroup_num);
+        batch.add(sst.seq_num, subgroup_num);
+        batch.fence();
     }
-    sst.put((char*)std::addressof(sst.num_received[0][subgroup_settings.num_received_offset]) - sst.getBaseAddress(),
-            sizeof(decltype(sst.num_received)::value_type) * num_shard_senders);
+    batch.add(sst.num_received, subgroup_settings.num_received_offset, num_shard_senders);
+    sst.put(batch);
 }
 
 void MulticastGroup::delivery_trigger(subgroup_id_t subgroup_num, const SubgroupSettings& subgroup_settings,
-                                      const uint32_t num_shard_members, DerechoSST& sst) {
+                                      DerechoSST& sst) {
+    if(delivery_workers[subgroup_num]) {
+        queue_stable_messages(subgroup_num, sst);
+        return;
+    }
     bool update_sst = false;
+    bool non_null_msgs_delivered = false;
+    persistent::version_t assigned_version = persistent::INVALID_VERSION;
+    std::unique_lock<std::recursive_mutex> lock(msg_state_mtxs[subgroup_num]);
+    // compute the min of the seq_num
+    const message_id_t min_stable_num
+            = sst.reduce(sst.seq_num, subgroup_num, get_shard_sst_indices(subgroup_num), sst::reduce_min());
+    StableMessage stable;
+    while(take_stable_message(subgroup_num, min_stable_num, stable)) {
+        update_sst = true;
+        assigned_version = stable.version;
+        // An upcall may send in another subgroup, whose own upcalls may send in this one
+        lock.unlock();
+        non_null_msgs_delivered |= deliver_stable_message(subgroup_num, stable);
+        lock.lock();
+    }
+    lock.unlock();
+    deliver_rpc_batch(subgroup_num);
+    if(update_sst) {
+        // post persistence request for ordered mode.
+        if(non_null_msgs_delivered) {
+            persistence_manager.post_persist_request(subgroup_num, assigned_version);
+        }
+        sst.put(get_shard_sst_indices(subgroup_num),
+                sst.delivered_num, subgroup_num);
+    }
+}
+
+bool MulticastGroup::take_stable_message(subgroup_id_t subgroup_num, message_id_t min_stable_num,
+                                         StableMessage& stable) {
+    MessageWindow<RDMCMessage>& rdmc_messages = locally_stable_rdmc_messages[subgroup_num];
+    MessageWindow<SSTMessage>& sst_messages = locally_stable_sst_messages[subgroup_num];
+    if(rdmc_messages.empty() && sst_messages.empty()) {
+        return false;
+    }
+    const message_id_t rdmc_seq_num = rdmc_messages.empty() ? std::numeric_limits<message_id_t>::max()
+                                                            : rdmc_messages.front_id();
+    const message_id_t sst_seq_num = sst_messages.empty() ? std::numeric_limits<message_id_t>::max()
+                                                          : sst_messages.front_id();
+    const message_id_t seq_num = std::min(rdmc_seq_num, sst_seq_num);
+    if(seq_num > min_stable_num) {
+        return false;
+    }
+    dbg_default_trace("Subgroup {}, can deliver a locally stable {} message: min_stable_num={} and seq_num={}",
+                      subgroup_num, rdmc_seq_num < sst_seq_num ? "RDMC" : "SST", min_stable_num, seq_num);
+    stable = StableMessage{seq_num, persistent::combine_int32s(sst->vid[member_index], seq_num), 0,
+                           rdmc_seq_num < sst_seq_num, RDMCMessage(), SSTMessage()};
+    // The RDMC buffer or SMC slot holding the message stays in use until it has been delivered
+    if(stable.is_rdmc) {
+        stable.rdmc_message = std::move(rdmc_messages.front());
+        stable.msg_timestamp = ((header*)stable.rdmc_message.message_buffer.data())->timestamp;
+        rdmc_messages.pop_front();
+    } else {
+        stable.sst_message = sst_messages.front();
+        stable.msg_timestamp = ((header*)stable.sst_message.buf)->timestamp;
+        sst_messages.pop_front();
+    }
+    return true;
+}
+
+bool MulticastGroup::deliver_stable_message(subgroup_id_t subgroup_num, StableMessage& stable) {
+    char* buf = stable.is_rdmc ? stable.rdmc_message.message_buffer.data() : const_cast<char*>(stable.sst_message.buf);
+    const long long unsigned int msg_size = stable.is_rdmc ? stable.rdmc_message.size : stable.sst_message.size;
+    if(batched_rpc_delivery && ((header*)buf)->cooked_send && msg_size > sizeof(header)) {
+        // Held for the batch; it is delivered, versioned and released in deliver_rpc_batch
+        rpc_batch_messages[subgroup_num].push_back(std::move(stable));
+        return true;
+    }
+    // Messages that are not batched must not overtake the batch
+    deliver_rpc_batch(subgroup_num);
+    if(stable.is_rdmc) {
+        deliver_message(stable.rdmc_message, subgroup_num, stable.version, stable.msg_timestamp / 1000);
+    } else {
+        deliver_message(stable.sst_message, subgroup_num, stable.version, stable.msg_timestamp / 1000);
+    }
+    bool non_null_msg = false;
     {
-        std::lock_guard<std::recursive_mutex> lock(msg_state_mtx);
-        // compute the min of the seq_num
-        message_id_t min_stable_num
-                = sst.seq_num[node_id_to_sst_index.at(subgroup_settings.members[0])][subgroup_num];
-        for(uint i = 0; i < num_shard_members; ++i) {
-            // to avoid a race condition, do not read the same SST entry twice
-            message_id_t stable_num_copy = sst.seq_num[node_id_to_sst_index.at(subgroup_settings.members[i])][subgroup_num];
-            min_stable_num = std::min(min_stable_num, stable_num_copy);
+        std::lock_guard<std::recursive_mutex> lock(msg_state_mtxs[subgroup_num]);
+        if(stable.is_rdmc) {
+            non_null_msg = version_message(stable.rdmc_message, subgroup_num, stable.seq_num,
+                                           stable.version, stable.msg_timestamp);
+        } else {
+            non_null_msg = version_message(stable.sst_message, subgroup_num, stable.seq_num,
+                                           stable.version, stable.msg_timestamp);
         }
-        bool non_null_msgs_delivered = false;
-        persistent::version_t assigned_version = persistent::INVALID_VERSION;
-        while(true) {
-            if(locally_stable_rdmc_messages[subgroup_num].empty() && locally_stable_sst_messages[subgroup_num].empty()) {
-                break;
-            }
-            int32_t least_undelivered_rdmc_seq_num, least_undelivered_sst_seq_num;
-            least_undelivered_rdmc_seq_num = least_undelivered_sst_seq_num = std::numeric_limits<int32_t>::max();
-            if(!locally_stable_rdmc_messages[subgroup_num].empty()) {
-                least_undelivered_rdmc_seq_num = locally_stable_rdmc_messages[subgroup_num].begin()->first;
-            }
-            if(!locally_stable_sst_messages[subgroup_num].empty()) {
-                least_undelivered_sst_seq_num = locally_stable_sst_messages[subgroup_num].begin()->first;
-            }
-            if(least_undelivered_rdmc_seq_num < least_undelivered_sst_seq_num && least_undelivered_rdmc_seq_num <= min_stable_num) {
-                update_sst = true;
-                dbg_default_trace("Subgroup {}, can deliver a locally stable RDMC message: min_stable_num={} and least_undelivered_seq_num={}",
-                                  subgroup_num, min_stable_num, least_undelivered_rdmc_seq_num);
-                RDMCMessage& msg = locally_stable_rdmc_messages[subgroup_num].begin()->second;
-                char* buf = msg.message_buffer.buffer.get();
-                uint64_t msg_ts = ((header*)buf)->timestamp;
-                //Note: deliver_message frees the RDMC buffer in msg, which is why the timestamp must be saved before calling this
-                assigned_version = persistent::combine_int32s(sst.vid[member_index], least_undelivered_rdmc_seq_num);
-                deliver_message(msg, subgroup_num, assigned_version, msg_ts / 1000);
-                non_null_msgs_delivered |= version_message(msg, subgroup_num, assigned_version, msg_ts);
-                // free the message buffer only after version_message has been called
-                free_message_buffers[subgroup_num].push_back(std::move(msg.message_buffer));
-                sst.delivered_num[member_index][subgroup_num] = least_undelivered_rdmc_seq_num;
-                locally_stable_rdmc_messages[subgroup_num].erase(locally_stable_rdmc_messages[subgroup_num].begin());
-            } else if(least_undelivered_sst_seq_num < least_undelivered_rdmc_seq_num && least_undelivered_sst_seq_num <= min_stable_num) {
-                update_sst = true;
-                dbg_default_trace("Subgroup {}, can deliver a locally stable SST message: min_stable_num={} and least_undelivered_seq_num={}",
-                                  subgroup_num, min_stable_num, least_undelivered_sst_seq_num);
-                SSTMessage& msg = locally_stable_sst_messages[subgroup_num].begin()->second;
-                char* buf = (char*)msg.buf;
-                uint64_t msg_ts = ((header*)buf)->timestamp;
-                assigned_version = persistent::combine_int32s(sst.vid[member_index], least_undelivered_sst_seq_num);
-                deliver_message(msg, subgroup_num, assigned_version, msg_ts / 1000);
-                non_null_msgs_delivered |= version_message(msg, subgroup_num, assigned_version, msg_ts);
-                sst.delivered_num[member_index][subgroup_num] = least_undelivered_sst_seq_num;
-                locally_stable_sst_messages[subgroup_num].erase(locally_stable_sst_messages[subgroup_num].begin());
-            } else {
+        sst->delivered_num[member_index][subgroup_num] = stable.seq_num;
+    }
+    if(stable.is_rdmc) {
+        // free the message buffer only after version_message has been called
+        release_message_buffer(std::move(stable.rdmc_message.message_buffer));
+    }
+    return non_null_msg;
+}
+
+void MulticastGroup::queue_stable_messages(subgroup_id_t subgroup_num, DerechoSST& sst) {
+    DeliveryWorker& worker = *delivery_workers[subgroup_num];
+    bool queued = false;
+    {
+        std::lock_guard<std::recursive_mutex> lock(msg_state_mtxs[subgroup_num]);
+        if(worker.shutdown) {
+            // The group is wedged; what is still locally stable is left to the ragged edge cleanup
+            return;
+        }
+        const message_id_t min_stable_num
+                = sst.reduce(sst.seq_num, subgroup_num, get_shard_sst_indices(subgroup_num), sst::reduce_min());
+        StableMessage stable;
+        // A full queue means the delivery thread is behind; the rest are queued on a later pass
+        while(!worker.queue.full() && take_stable_message(subgroup_num, min_stable_num, stable)) {
+            worker.queue.try_push(std::move(stable));
+            queued = true;
+        }
+    }
+    if(queued) {
+        // Taking the lock makes sure the thread is either waiting or will see the messages before it waits
+        { std::lock_guard<std::mutex> lock(worker.mtx); }
+        worker.cv.notify_one();
+    }
+}
+
+void MulticastGroup::delivery_loop(subgroup_id_t subgroup_num) {
+    pthread_setname_np(pthread_self(), "delivery_thread");
+    DeliveryWorker& worker = *delivery_workers[subgroup_num];
+    StableMessage stable;
+    while(true) {
+        {
+            std::unique_lock<std::mutex> lock(worker.mtx);
+            worker.cv.wait(lock, [&]() { return worker.shutdown || !worker.queue.empty(); });
+            // After a wedge, the messages already queued are still delivered, before the ragged edge cleanup
+            if(worker.shutdown && worker.queue.empty()) {
                 break;
             }
         }
-        if(update_sst) {
-            // post persistence request for ordered mode.
-            if(non_null_msgs_delivered) {
-                persistence_manager.post_persist_request(subgroup_num, assigned_version);
-            }
+        bool non_null_msgs_delivered = false;
+        persistent::version_t assigned_version = persistent::INVALID_VERSION;
+        while(worker.queue.try_pop(stable)) {
+            assigned_version = stable.version;
+            non_null_msgs_delivered |= deliver_stable_message(subgroup_num, stable);
         }
-    }
-    if(update_sst) {
-        sst.put(get_shard_sst_indices(subgroup_num),
-                sst.delivered_num, subgroup_num);
+        deliver_rpc_batch(subgroup_num);
+        if(non_null_msgs_delivered) {
+            persistence_manager.post_persist_request(subgroup_num, assigned_version);
+        }
+        sst->put(get_shard_sst_indices(subgroup_num),
+                 sst->delivered_num, subgroup_num);
     }
 }
 
 void MulticastGroup::sst_send_trigger(subgroup_id_t subgroup_num, const SubgroupSettings& subgroup_settings,
-                                      const uint32_t num_shard_members, DerechoSST& sst) {
+                                      DerechoSST& sst) {
     int32_t current_committed_index;
     int32_t to_be_sent;
     int32_t current_first_null_index;
     uint32_t current_num_nulls_queued;
+    const SMCColumns& smc = smc_columns[subgroup_num];
     {
-        std::unique_lock<std::recursive_mutex> lock(msg_state_mtx);
-        to_be_sent = committed_sst_index[subgroup_num] - sst.index[member_index][subgroup_settings.index_offset];
+        std::unique_lock<std::recursive_mutex> lock(msg_state_mtxs[subgroup_num]);
+        if(smc_packing) {
+            // Send whatever has been packed since the last time this ran
+            close_open_smc_slot(subgroup_num);
+        }
+        // Commit, in order, the closed slots whose messages have all been written
+        const std::atomic<uint32_t>* unfinished_writes = smc_unfinished_writes[subgroup_num].get();
+        while(committed_sst_index[subgroup_num] != closed_sst_index[subgroup_num]
+              && unfinished_writes[(committed_sst_index[subgroup_num] + 1) % smc_num_positions[subgroup_num]]
+                                 .load(std::memory_order_acquire)
+                         == 0) {
+            committed_sst_index[subgroup_num]++;
+        }
+        int32_t last_to_send = committed_sst_index[subgroup_num];
+        bool send_nulls = num_nulls_queued[subgroup_num] > 0;
+        if(send_nulls && last_to_send < first_null_index[subgroup_num] + static_cast<int32_t>(num_nulls_queued[subgroup_num]) - 1) {
+            // A run of nulls goes out in one piece, once the messages before it are written
+            last_to_send = first_null_index[subgroup_num] - 1;
+            send_nulls = false;
+        }
+        to_be_sent = last_to_send - (*smc.index)[smc.my_row][smc.index_offset];
         if(to_be_sent > 0) {
             current_committed_index = sst_multicast_group_ptrs[subgroup_num]->commit_send(to_be_sent);
             // Save current values and reset null-related counters.
-            current_first_null_index = first_null_index[subgroup_num];
-            current_num_nulls_queued = num_nulls_queued[subgroup_num];
-            first_null_index[subgroup_num] = -1;
-            num_nulls_queued[subgroup_num] = 0;
+            current_first_null_index = send_nulls ? first_null_index[subgroup_num] : -1;
+            current_num_nulls_queued = send_nulls ? num_nulls_queued[subgroup_num] : 0;
+            if(send_nulls) {
+                first_null_index[subgroup_num] = -1;
+                num_nulls_queued[subgroup_num] = 0;
+            }
         }
     }
     // Here lock is released
     if(to_be_sent > 0) {
+        const size_t sub_header_size = smc_packing ? sizeof(packed_message_header) : 0;
         if(current_num_nulls_queued > 0) {
             DerechoParams profile = subgroup_settings.profile;
             const uint64_t slot_width = profile.sst_max_msg_size + sizeof(uint64_t);
             auto null_slot = current_first_null_index % profile.window_size;
-            header* h = (header*)&sst.slots[member_index][subgroup_settings.slot_offset + slot_width * null_slot];
+            header* h = (header*)&(*smc.slots)[smc.my_row][smc.slot_offset + slot_width * null_slot + sub_header_size];
             h->num_nulls = current_num_nulls_queued;
         }
 
         sst_multicast_group_ptrs[subgroup_num]->send(current_committed_index, to_be_sent, current_num_nulls_queued,
-                                                     current_first_null_index, sizeof(header));
+                                                     current_first_null_index, sub_header_size + sizeof(header));
     }
 }
 
 void MulticastGroup::update_min_persisted_num(subgroup_id_t subgroup_num, const SubgroupSettings& subgroup_settings,
-                                              uint32_t num_shard_members, DerechoSST& sst) {
-    std::lock_guard<std::recursive_mutex> lock(msg_state_mtx);
+                                              DerechoSST& sst) {
+    std::lock_guard<std::recursive_mutex> lock(msg_state_mtxs[subgroup_num]);
     // compute the min of the persisted_num
-    persistent::version_t min_persisted_num
-            = sst.persisted_num[node_id_to_sst_index.at(subgroup_settings.members[0])][subgroup_num];
-    for(uint32_t i = 1; i < num_shard_members; ++i) {
-        persistent::version_t persisted_num_copy = sst.persisted_num[node_id_to_sst_index.at(subgroup_settings.members[i])]
-                                                                    [subgroup_num];
-        min_persisted_num = std::min(min_persisted_num, persisted_num_copy);
-    }
+    const persistent::version_t min_persisted_num
+            = sst.reduce(sst.persisted_num, subgroup_num, get_shard_sst_indices(subgroup_num), sst::reduce_min());
     // callbacks
     if(min_persisted_num > minimum_persisted_version[subgroup_num]) {
         if(callbacks.global_persistence_callback) {
@@ -931,15 +1330,10 @@ void MulticastGroup::update_min_persisted_num(subgroup_id_t subgroup_num, const
 }
 
 void MulticastGroup::update_min_verified_num(subgroup_id_t subgroup_num, const SubgroupSettings& subgroup_settings,
-                                             uint32_t num_shard_members, DerechoSST& sst) {
+                                             DerechoSST& sst) {
     //Do I need msg_state_mtx here? What does it guard?
-    persistent::version_t min_verified_num
-            = sst.verified_num[node_id_to_sst_index.at(subgroup_settings.members[0])][subgroup_num];
-    for(uint32_t i = 1; i < num_shard_members; ++i) {
-        persistent::version_t member_verified_num = sst.verified_num[node_id_to_sst_index.at(subgroup_settings.members[i])]
-                                                                    [subgroup_num];
-        min_verified_num = std::min(min_verified_num, member_verified_num);
-    }
+    const persistent::version_t min_verified_num
+            = sst.reduce(sst.verified_num, subgroup_num, get_shard_sst_indices(subgroup_num), sst::reduce_min());
     if(min_verified_num > minimum_verified_version[subgroup_num]) {
         if(callbacks.global_verified_callback) {
             callbacks.global_verified_callback(subgroup_num, min_verified_num);
@@ -951,9 +1345,18 @@ void MulticastGroup::update_min_verified_num(subgroup_id_t subgroup_num, const S
     }
 }
 
+uint32_t MulticastGroup::predicate_partition_for(subgroup_id_t subgroup_num) const {
+    // Partition 0 is left to the membership predicates whenever there is more than one
+    const uint32_t num_partitions = sst->predicates.num_partitions();
+    return num_partitions == 1 ? 0 : 1 + subgroup_num % (num_partitions - 1);
+}
+
 void MulticastGroup::register_predicates() {
     for(const auto& p : subgroup_settings_map) {
         subgroup_id_t subgroup_num = p.first;
+        // All of a subgroup's predicates share one evaluation thread, so its
+        // receive, delivery, and send triggers still run in order
+        const uint32_t partition = predicate_partition_for(subgroup_num);
         const SubgroupSettings& subgroup_settings = p.second;
         auto num_shard_members = subgroup_settings.members.size();
         std::vector<int> shard_senders = subgroup_settings.senders;
@@ -965,9 +1368,11 @@ void MulticastGroup::register_predicates() {
                 l++;
             }
         }
+        // Lives as long as this MulticastGroup, so predicates can refer to it
+        const std::vector<uint32_t>& shard_sst_indices = get_shard_sst_indices(subgroup_num);
 
         auto receiver_pred = [=](const DerechoSST& sst) {
-            return receiver_predicate(subgroup_settings,
+            return receiver_predicate(subgroup_num, subgroup_settings,
                                       shard_ranks_by_sender_rank, num_shard_senders, sst);
         };
         auto sst_receive_handler_lambda = [=](uint32_t sender_rank, volatile char* data, uint64_t size) {
@@ -981,27 +1386,27 @@ void MulticastGroup::register_predicates() {
                               sst_receive_handler_lambda);
         };
         receiver_pred_handles.emplace_back(sst->predicates.insert(receiver_pred, receiver_trig,
-                                                                  sst::PredicateType::RECURRENT));
+                                                                  sst::PredicateType::RECURRENT, partition));
 
         auto sst_send_pred = [](const DerechoSST& sst) {
             return true;
         };
-        auto sst_send_trig = [this, subgroup_num, subgroup_settings, num_shard_members](DerechoSST& sst) mutable {
-            sst_send_trigger(subgroup_num, subgroup_settings, num_shard_members, sst);
+        auto sst_send_trig = [this, subgroup_num, subgroup_settings](DerechoSST& sst) mutable {
+            sst_send_trigger(subgroup_num, subgroup_settings, sst);
         };
         receiver_pred_handles.emplace_back(sst->predicates.insert(sst_send_pred, sst_send_trig,
-                                                                  sst::PredicateType::RECURRENT));
+                                                                  sst::PredicateType::RECURRENT, partition));
 
         if(subgroup_settings.mode != Mode::UNORDERED) {
             auto delivery_pred = [](const DerechoSST& sst) {
                 return true;
             };
             auto delivery_trig = [=](DerechoSST& sst) mutable {
-                delivery_trigger(subgroup_num, subgroup_settings, num_shard_members, sst);
+                delivery_trigger(subgroup_num, subgroup_settings, sst);
             };
 
             delivery_pred_handles.emplace_back(sst->predicates.insert(delivery_pred, delivery_trig,
-                                                                      sst::PredicateType::RECURRENT));
+                                                                      sst::PredicateType::RECURRENT, partition));
 
             //This predicate should be "current min over persisted_num is greater than the last
             //observed minimum persisted_num," but computing the current min in the predicate is
@@ -1011,56 +1416,47 @@ void MulticastGroup::register_predicates() {
                 return true;
             };
             auto persistence_trig = [=](DerechoSST& sst) mutable {
-                update_min_persisted_num(subgroup_num, subgroup_settings, num_shard_members, sst);
+                update_min_persisted_num(subgroup_num, subgroup_settings, sst);
             };
 
-            persistence_pred_handles.emplace_back(sst->predicates.insert(persistence_pred, persistence_trig, sst::PredicateType::RECURRENT));
+            persistence_pred_handles.emplace_back(sst->predicates.insert(persistence_pred, persistence_trig, sst::PredicateType::RECURRENT, partition));
 
             //In case there are persistent objects with signatures, add a similar predicate to check/update the minimum verified_num
             auto verified_pred = [](const DerechoSST& sst) {
                 return true;
             };
             auto verified_trig = [=](DerechoSST& sst) {
-                update_min_verified_num(subgroup_num, subgroup_settings, num_shard_members, sst);
+                update_min_verified_num(subgroup_num, subgroup_settings, sst);
             };
 
-            persistence_pred_handles.emplace_back(sst->predicates.insert(verified_pred, verified_trig, sst::PredicateType::RECURRENT));
+            persistence_pred_handles.emplace_back(sst->predicates.insert(verified_pred, verified_trig, sst::PredicateType::RECURRENT, partition));
 
             if(subgroup_settings.sender_rank >= 0) {
-                auto sender_pred = [=](const DerechoSST& sst) {
+                auto sender_pred = [=, &shard_sst_indices](const DerechoSST& sst) {
                     message_id_t seq_num = next_message_to_deliver[subgroup_num] * num_shard_senders + subgroup_settings.sender_rank;
-                    for(uint i = 0; i < num_shard_members; ++i) {
-                        if(sst.delivered_num[node_id_to_sst_index.at(subgroup_settings.members[i])][subgroup_num] < seq_num) {
-                            return false;
-                        }
-                    }
-                    return true;
+                    return sst.reduce(sst.delivered_num, subgroup_num, shard_sst_indices, sst::reduce_min()) >= seq_num;
                 };
                 auto sender_trig = [=](DerechoSST& sst) {
-                    sender_cv.notify_all();
+                    wake_sender();
                     next_message_to_deliver[subgroup_num]++;
                 };
                 sender_pred_handles.emplace_back(sst->predicates.insert(sender_pred, sender_trig,
-                                                                        sst::PredicateType::RECURRENT));
+                                                                        sst::PredicateType::RECURRENT, partition));
             }
         } else {
             //This subgroup is in UNORDERED mode
             if(subgroup_settings.sender_rank >= 0) {
-                auto sender_pred = [=](const DerechoSST& sst) {
-                    for(uint i = 0; i < num_shard_members; ++i) {
-                        uint32_t num_received_offset = subgroup_settings.num_received_offset;
-                        if(sst.num_received[node_id_to_sst_index.at(subgroup_settings.members[i])][num_received_offset + subgroup_settings.sender_rank]
-                           < static_cast<int32_t>(future_message_indices[subgroup_num] - 1 - subgroup_settings.profile.window_size)) {
-                            return false;
-                        }
-                    }
-                    return true;
+                auto sender_pred = [=, &shard_sst_indices](const DerechoSST& sst) {
+                    const uint32_t num_received_offset = subgroup_settings.num_received_offset;
+                    return sst.reduce(sst.num_received, num_received_offset + subgroup_settings.sender_rank,
+                                      shard_sst_indices, sst::reduce_min())
+                           >= static_cast<int32_t>(future_message_indices[subgroup_num] - 1 - subgroup_settings.profile.window_size);
                 };
                 auto sender_trig = [this](DerechoSST& sst) {
-                    sender_cv.notify_all();
+                    wake_sender();
                 };
                 sender_pred_handles.emplace_back(sst->predicates.insert(sender_pred, sender_trig,
-                                                                        sst::PredicateType::RECURRENT));
+                                                                        sst::PredicateType::RECURRENT, partition));
             }
         }
     }
@@ -1097,11 +1493,30 @@ void MulticastGroup::wedge() {
         handle_iter = persistence_pred_handles.erase(handle_iter);
     }
 
+    // Let the delivery threads finish the messages already queued, so that
+    // delivered_num is final before the ragged edge cleanup reads it
+    for(subgroup_id_t subgroup_num = 0; subgroup_num < delivery_workers.size(); ++subgroup_num) {
+        if(delivery_workers[subgroup_num]) {
+            DeliveryWorker& worker = *delivery_workers[subgroup_num];
+            {
+                std::lock_guard<std::recursive_mutex> lock(msg_state_mtxs[subgroup_num]);
+                std::lock_guard<std::mutex> worker_lock(worker.mtx);
+                worker.shutdown = true;
+            }
+            worker.cv.notify_one();
+        }
+    }
+    for(auto& worker : delivery_workers) {
+        if(worker && worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+
     for(uint i = 0; i < num_members; ++i) {
         rdmc::destroy_group(i + rdmc_group_num_offset);
     }
 
-    sender_cv.notify_all();
+    wake_sender();
     if(sender_thread.joinable()) {
         sender_thread.join();
     }
@@ -1109,7 +1524,6 @@ void MulticastGroup::wedge() {
 
 void MulticastGroup::send_loop() {
     pthread_setname_np(pthread_self(), "sender_thread");
-    subgroup_id_t subgroup_to_send = 0;
     auto should_send_to_subgroup = [&](subgroup_id_t subgroup_num) {
         if(!rdmc_sst_groups_created) {
             return false;
@@ -1117,32 +1531,29 @@ void MulticastGroup::send_loop() {
         if(pending_sends[subgroup_num].empty()) {
             return false;
         }
-        RDMCMessage& msg = pending_sends[subgroup_num].front();
-        const SubgroupSettings& subgroup_settings = subgroup_settings_map.at(subgroup_num);
+        const SendReadiness& readiness = send_readiness[subgroup_num];
+        assert(readiness.is_sender);
+        const message_id_t index = pending_sends[subgroup_num].front().index;
 
-        int shard_sender_index = subgroup_settings.sender_rank;
-        std::vector<int> shard_senders = subgroup_settings.senders;
-        uint32_t num_shard_senders = get_num_senders(shard_senders);
-        assert(shard_sender_index >= 0);
-
-        if(sst->num_received[member_index][subgroup_settings.num_received_offset + shard_sender_index] < msg.index - 1) {
+        // The previous message sent in the same RDMC group must have finished
+        if(sst->num_received[member_index][readiness.num_received_column] < index - readiness.num_rdmc_lanes) {
             return false;
         }
 
-        std::vector<node_id_t> shard_members = subgroup_settings.members;
-        auto num_shard_members = shard_members.size();
-        assert(num_shard_members >= 1);
-        if(subgroup_settings.mode != Mode::UNORDERED) {
-            for(uint i = 0; i < num_shard_members; ++i) {
-                if(sst->delivered_num[node_id_to_sst_index.at(shard_members[i])][subgroup_num] < static_cast<message_id_t>((msg.index - subgroup_settings.profile.window_size) * num_shard_senders + shard_sender_index)) {
+        assert(!readiness.shard_sst_indices.empty());
+        if(readiness.ordered) {
+            // Every member must have delivered the message sent one window earlier
+            const message_id_t min_delivered_num
+                    = (index - readiness.window_size) * static_cast<int32_t>(readiness.num_shard_senders) + readiness.sender_rank;
+            for(const uint32_t sst_index : readiness.shard_sst_indices) {
+                if(sst->delivered_num[sst_index][subgroup_num] < min_delivered_num) {
                     return false;
                 }
             }
         } else {
-            for(uint i = 0; i < num_shard_members; ++i) {
-                auto num_received_offset = subgroup_settings.num_received_offset;
-                if(sst->num_received[node_id_to_sst_index.at(shard_members[i])][num_received_offset + shard_sender_index]
-                   < static_cast<int32_t>(future_message_indices[subgroup_num] - 1 - subgroup_settings.profile.window_size)) {
+            const int32_t min_num_received = future_message_indices[subgroup_num] - 1 - readiness.window_size;
+            for(const uint32_t sst_index : readiness.shard_sst_indices) {
+                if(sst->num_received[sst_index][readiness.num_received_column] < min_num_received) {
                     return false;
                 }
             }
@@ -1150,49 +1561,58 @@ void MulticastGroup::send_loop() {
 
         return true;
     };
-    auto should_send = [&]() {
-        for(uint i = 1; i <= total_num_subgroups; ++i) {
-            auto subgroup_num = (subgroup_to_send + i) % total_num_subgroups;
-            if(should_send_to_subgroup(subgroup_num)) {
-                subgroup_to_send = subgroup_num;
-                return true;
+    // Sends the next pending message of a subgroup if it is ready to go; the subgroup's lock must be held
+    auto send_to_subgroup = [&](subgroup_id_t subgroup_num) {
+        if(!should_send_to_subgroup(subgroup_num)) {
+            return false;
+        }
+        const int32_t index = pending_sends[subgroup_num].front().index;
+        RDMCMessage& msg = current_sends[subgroup_num].emplace(index, std::move(pending_sends[subgroup_num].front()));
+        dbg_default_trace("Calling send in subgroup {} on message {} from sender {}",
+                          subgroup_num, msg.index, msg.sender_id);
+        // make sure there are > 1 members before issuing RDMC send
+        if(send_readiness[subgroup_num].shard_sst_indices.size() > 1) {
+            if(!rdmc::send(subgroup_to_rdmc_group.at(subgroup_num) + index % send_readiness[subgroup_num].num_rdmc_lanes,
+                           msg.message_buffer.mr, msg.message_buffer.offset(), msg.size)) {
+                throw std::runtime_error("rdmc::send returned false");
             }
+        } else {
+            // receive the message right here; this removes it from current_sends
+            singleton_shard_receive_handlers.at(subgroup_num)(
+                    msg.message_buffer.data(), msg.size);
         }
-        return false;
+        pending_sends[subgroup_num].pop();
+        return true;
     };
-    auto should_wake = [&]() { return thread_shutdown || should_send(); };
-    std::unique_lock<std::recursive_mutex> lock(msg_state_mtx);
     while(!thread_shutdown) {
-        sender_cv.wait(lock, should_wake);
-        if(!thread_shutdown) {
-            current_sends[subgroup_to_send] = std::move(pending_sends[subgroup_to_send].front());
-            dbg_default_trace("Calling send in subgroup {} on message {} from sender {}",
-                              subgroup_to_send, current_sends[subgroup_to_send]->index, current_sends[subgroup_to_send]->sender_id);
-            // make sure there are > 1 members before issuing RDMC send
-            if(subgroup_settings_map.at(subgroup_to_send).members.size() > 1) {
-                if(!rdmc::send(subgroup_to_rdmc_group.at(subgroup_to_send),
-                               current_sends[subgroup_to_send]->message_buffer.mr, 0,
-                               current_sends[subgroup_to_send]->size)) {
-                    throw std::runtime_error("rdmc::send returned false");
-                }
-            } else {
-                // receive the message right here
-                singleton_shard_receive_handlers.at(subgroup_to_send)(
-                        current_sends[subgroup_to_send]->message_buffer.buffer.get(), current_sends[subgroup_to_send]->size);
+        {
+            std::unique_lock<std::mutex> wake_lock(sender_mtx);
+            sender_cv.wait(wake_lock, [&]() { return thread_shutdown || sender_woken; });
+            sender_woken = false;
+        }
+        // Take turns among the subgroups, one message each per pass, locking
+        // only the subgroup being sent in so the others can keep going
+        bool sent_any = true;
+        while(sent_any && !thread_shutdown) {
+            sent_any = false;
+            for(subgroup_id_t subgroup_num = 0; subgroup_num < total_num_subgroups && !thread_shutdown; ++subgroup_num) {
+                std::lock_guard<std::recursive_mutex> lock(msg_state_mtxs[subgroup_num]);
+                sent_any |= send_to_subgroup(subgroup_num);
             }
-            pending_sends[subgroup_to_send].pop();
         }
     }
 }
 
-const uint64_t MulticastGroup::compute_global_stability_frontier(uint32_t subgroup_num) {
-    uint64_t global_stability_frontier = sst->local_stability_frontier[member_index][subgroup_num];
-    auto shard_sst_indices = get_shard_sst_indices(subgroup_num);
-    for(auto index : shard_sst_indices) {
-        uint64_t local_stability_frontier_copy = sst->local_stability_frontier[index][subgroup_num];
-        global_stability_frontier = std::min(global_stability_frontier, local_stability_frontier_copy);
+void MulticastGroup::wake_sender() {
+    {
+        std::lock_guard<std::mutex> lock(sender_mtx);
+        sender_woken = true;
     }
-    return global_stability_frontier;
+    sender_cv.notify_all();
+}
+
+const uint64_t MulticastGroup::compute_global_stability_frontier(uint32_t subgroup_num) {
+    return sst->reduce(sst->local_stability_frontier, subgroup_num, get_shard_sst_indices(subgroup_num), sst::reduce_min());
 }
 
 void MulticastGroup::check_failures_loop() {
@@ -1201,21 +1621,18 @@ void MulticastGroup::check_failures_loop() {
         std::this_thread::sleep_for(std::chrono::milliseconds(sender_timeout));
         if(sst) {
             {
-                std::unique_lock<std::recursive_mutex> lock(msg_state_mtx);
                 auto current_time = get_walltime();
                 for(auto p : subgroup_settings_map) {
                     auto subgroup_num = p.first;
+                    std::unique_lock<std::recursive_mutex> lock(msg_state_mtxs[subgroup_num]);
                     auto members = p.second.members;
-                    auto sst_indices = get_shard_sst_indices(subgroup_num);
+                    const std::vector<uint32_t>& sst_indices = get_shard_sst_indices(subgroup_num);
                     // clean up timestamps of persisted messages
-                    auto min_persisted_num = sst->persisted_num[member_index][subgroup_num];
-                    for(auto i : sst_indices) {
-                        persistent::version_t persisted_num_copy = sst->persisted_num[i][subgroup_num];
-                        min_persisted_num = std::min(min_persisted_num, persisted_num_copy);
-                    }
-                    while(!pending_persistence[subgroup_num].empty() && pending_persistence[subgroup_num].begin()->first <= min_persisted_num) {
-                        auto timestamp = pending_persistence[subgroup_num].begin()->second;
-                        pending_persistence[subgroup_num].erase(pending_persistence[subgroup_num].begin());
+                    const persistent::version_t min_persisted_num
+                            = sst->reduce(sst->persisted_num, subgroup_num, sst_indices, sst::reduce_min());
+                    while(!pending_persistence[subgroup_num].empty() && pending_persistence[subgroup_num].front_id() <= min_persisted_num) {
+                        auto timestamp = pending_persistence[subgroup_num].front();
+                        pending_persistence[subgroup_num].pop_front();
                         pending_message_timestamps[subgroup_num].erase(timestamp);
                     }
                     if(pending_message_timestamps[subgroup_num].empty()) {
@@ -1232,7 +1649,7 @@ void MulticastGroup::check_failures_loop() {
     }
 }
 
-// we already hold the lock on msg_state_mtx when we call this
+// we already hold the subgroup's lock in msg_state_mtxs when we call this
 void MulticastGroup::get_buffer_and_send_auto_null(subgroup_id_t subgroup_num) {
     // short-circuits most of the normal checks because
     // we know that we received a message and are sending a null
@@ -1246,14 +1663,14 @@ void MulticastGroup::get_buffer_and_send_auto_null(subgroup_id_t subgroup_num) {
         msg.sender_id = members[member_index];
         msg.index = future_message_indices[subgroup_num];
         msg.size = msg_size;
-        msg.message_buffer = std::move(free_message_buffers[subgroup_num].back());
-        free_message_buffers[subgroup_num].pop_back();
+        // Nulls are sent from the receive path, which cannot wait for a buffer to be freed
+        msg.message_buffer = buffer_pool->allocate(msg_size, true);
 
         auto current_time = get_walltime();
         pending_message_timestamps[subgroup_num].insert(current_time);
 
         // Fill header
-        char* buf = msg.message_buffer.buffer.get();
+        char* buf = msg.message_buffer.data();
         ((header*)buf)->header_size = sizeof(header);
         ((header*)buf)->index = msg.index;
         ((header*)buf)->timestamp = current_time;
@@ -1261,9 +1678,23 @@ void MulticastGroup::get_buffer_and_send_auto_null(subgroup_id_t subgroup_num) {
 
         future_message_indices[subgroup_num]++;
         pending_sends[subgroup_num].push(std::move(msg));
-        sender_cv.notify_all();
+        wake_sender();
     } else {
-        char* buf = (char*)sst_multicast_group_ptrs[subgroup_num]->get_buffer(msg_size);
+        char* buf;
+        if(smc_packing) {
+            // A null gets a slot of its own, after any messages packed so far
+            close_open_smc_slot(subgroup_num);
+            buf = (char*)sst_multicast_group_ptrs[subgroup_num]->get_buffer(sizeof(packed_message_header) + msg_size);
+            assert(buf);
+            ((packed_message_header*)buf)->size = msg_size;
+            buf += sizeof(packed_message_header);
+            smc_slot_last_message[subgroup_num][smc_slots_taken[subgroup_num]++ % profile.window_size]
+                    = future_message_indices[subgroup_num];
+        } else if(smc_ring_size) {
+            buf = get_ring_buffer(subgroup_num, msg_size);
+        } else {
+            buf = (char*)sst_multicast_group_ptrs[subgroup_num]->get_buffer(msg_size);
+        }
 
         assert(buf);
 
@@ -1277,18 +1708,108 @@ void MulticastGroup::get_buffer_and_send_auto_null(subgroup_id_t subgroup_num) {
         ((header*)buf)->cooked_send = false;
 
         future_message_indices[subgroup_num]++;
-        committed_sst_index[subgroup_num]++;
+        closed_sst_index[subgroup_num]++;
 
+        // A ring has no slots for a run of nulls to skip over, so each null is sent as it is
+        if(smc_ring_size) {
+            return;
+        }
         if(first_null_index[subgroup_num] < 0) {
-            first_null_index[subgroup_num] = committed_sst_index[subgroup_num];
+            first_null_index[subgroup_num] = closed_sst_index[subgroup_num];
         }
         num_nulls_queued[subgroup_num]++;
     }
 }
 
+char* MulticastGroup::get_packed_buffer(subgroup_id_t subgroup_num, uint64_t msg_size) {
+    const SubgroupSettings& subgroup_settings = subgroup_settings_map.at(subgroup_num);
+    const DerechoParams& profile = subgroup_settings.profile;
+    OpenSMCSlot& open_slot = open_smc_slots[subgroup_num];
+    const uint64_t packed_size = sizeof(packed_message_header) + msg_size;
+    if(open_slot.buf && open_slot.used + packed_size > profile.sst_max_msg_size) {
+        close_open_smc_slot(subgroup_num);
+    }
+    if(!open_slot.buf) {
+        // A run of nulls waiting to be sent must occupy consecutive slots
+        if(num_nulls_queued[subgroup_num] > 0) {
+            return nullptr;
+        }
+        // The position can be reused once every member is done with the last message sent from it
+        const message_id_t last_message
+                = smc_slot_last_message[subgroup_num][smc_slots_taken[subgroup_num] % profile.window_size];
+        if(last_message > last_released_message(subgroup_num)) {
+            return nullptr;
+        }
+        char* buf = (char*)sst_multicast_group_ptrs[subgroup_num]->get_buffer(profile.sst_max_msg_size);
+        if(!buf) {
+            return nullptr;
+        }
+        open_slot.buf = buf;
+        open_slot.used = 0;
+        smc_slots_taken[subgroup_num]++;
+    }
+    char* buf = open_slot.buf + open_slot.used;
+    ((packed_message_header*)buf)->size = msg_size;
+    open_slot.used += packed_size;
+    smc_slot_last_message[subgroup_num][(smc_slots_taken[subgroup_num] - 1) % profile.window_size]
+            = future_message_indices[subgroup_num];
+    return buf + sizeof(packed_message_header);
+}
+
+char* MulticastGroup::get_ring_buffer(subgroup_id_t subgroup_num, uint64_t msg_size) {
+    std::deque<message_id_t>& entry_messages = smc_ring_entry_messages[subgroup_num];
+    if(!entry_messages.empty()) {
+        const message_id_t last_released = last_released_message(subgroup_num);
+        uint32_t num_released = 0;
+        while(!entry_messages.empty() && entry_messages.front() <= last_released) {
+            entry_messages.pop_front();
+            num_released++;
+        }
+        sst_multicast_group_ptrs[subgroup_num]->release(num_released);
+    }
+    char* buf = (char*)sst_multicast_group_ptrs[subgroup_num]->get_buffer(msg_size);
+    if(buf) {
+        entry_messages.push_back(future_message_indices[subgroup_num]);
+    }
+    return buf;
+}
+
+message_id_t MulticastGroup::last_released_message(subgroup_id_t subgroup_num) {
+    const SubgroupSettings& subgroup_settings = subgroup_settings_map.at(subgroup_num);
+    const std::vector<uint32_t>& shard_sst_indices = get_shard_sst_indices(subgroup_num);
+    if(subgroup_settings.mode == Mode::UNORDERED) {
+        return sst->reduce(sst->num_received, subgroup_settings.num_received_offset + subgroup_settings.sender_rank,
+                           shard_sst_indices, sst::reduce_min());
+    }
+    // Convert the delivered sequence number to an index of this node's messages
+    const message_id_t min_delivered = sst->reduce(sst->delivered_num, subgroup_num, shard_sst_indices, sst::reduce_min());
+    if(min_delivered < subgroup_settings.sender_rank) {
+        return -1;
+    }
+    return (min_delivered - subgroup_settings.sender_rank) / get_num_senders(subgroup_settings.senders);
+}
+
+void MulticastGroup::close_open_smc_slot(subgroup_id_t subgroup_num) {
+    OpenSMCSlot& open_slot = open_smc_slots[subgroup_num];
+    if(!open_slot.buf) {
+        return;
+    }
+    uint64_t push_size = open_slot.used;
+    // Mark the end of the messages, unless they fill the slot
+    if(open_slot.used + sizeof(packed_message_header) <= subgroup_settings_map.at(subgroup_num).profile.sst_max_msg_size) {
+        ((packed_message_header*)(open_slot.buf + open_slot.used))->size = 0;
+        push_size += sizeof(packed_message_header);
+    }
+    sst_multicast_group_ptrs[subgroup_num]->set_push_size(push_size);
+    closed_sst_index[subgroup_num]++;
+    open_slot.buf = nullptr;
+    open_slot.used = 0;
+}
+
 char* MulticastGroup::get_sendbuffer_ptr(subgroup_id_t subgroup_num,
                                          long long unsigned int payload_size,
-                                         bool cooked_send) {
+                                         bool cooked_send,
+                                         MessageBuffer* lent_buffer) {
     long long unsigned int msg_size = payload_size + sizeof(header);
     const SubgroupSettings& subgroup_settings = subgroup_settings_map.at(subgroup_num);
     if(msg_size > subgroup_settings.profile.max_msg_size) {
@@ -1306,33 +1827,35 @@ char* MulticastGroup::get_sendbuffer_ptr(subgroup_id_t subgroup_num,
     num_shard_senders = get_num_senders(shard_senders);
     assert(shard_sender_index >= 0);
 
-    if(subgroup_settings.mode != Mode::UNORDERED) {
-        for(uint i = 0; i < num_shard_members; ++i) {
-            if(sst->delivered_num[node_id_to_sst_index.at(shard_members[i])][subgroup_num]
-               < static_cast<int32_t>((future_message_indices[subgroup_num] - subgroup_settings.profile.window_size) * num_shard_senders + shard_sender_index)) {
-                return nullptr;
+    // Packed and ring SMC messages are flow-controlled by the space they take
+    // instead, in get_packed_buffer and get_ring_buffer
+    const uint64_t sub_header_size = smc_packing ? sizeof(packed_message_header) : 0;
+    const bool use_rdmc = lent_buffer || msg_size + sub_header_size > subgroup_settings.profile.sst_max_msg_size;
+    if(use_rdmc || !(smc_packing || smc_ring_size)) {
+        if(subgroup_settings.mode != Mode::UNORDERED) {
+            for(uint i = 0; i < num_shard_members; ++i) {
+                if(sst->delivered_num[node_id_to_sst_index.at(shard_members[i])][subgroup_num]
+                   < static_cast<int32_t>((future_message_indices[subgroup_num] - subgroup_settings.profile.window_size) * num_shard_senders + shard_sender_index)) {
+                    return nullptr;
+                }
             }
-        }
-    } else {
-        for(uint i = 0; i < num_shard_members; ++i) {
-            auto num_received_offset = subgroup_settings.num_received_offset;
-            if(sst->num_received[node_id_to_sst_index.at(shard_members[i])][num_received_offset + shard_sender_index]
-               < static_cast<int32_t>(future_message_indices[subgroup_num] - subgroup_settings.profile.window_size)) {
-                return nullptr;
+        } else {
+            for(uint i = 0; i < num_shard_members; ++i) {
+                auto num_received_offset = subgroup_settings.num_received_offset;
+                if(sst->num_received[node_id_to_sst_index.at(shard_members[i])][num_received_offset + shard_sender_index]
+                   < static_cast<int32_t>(future_message_indices[subgroup_num] - subgroup_settings.profile.window_size)) {
+                    return nullptr;
+                }
             }
         }
     }
 
-    if(msg_size > subgroup_settings.profile.sst_max_msg_size) {
+    if(use_rdmc) {
         if(thread_shutdown) {
             return nullptr;
         }
 
-        if(free_message_buffers[subgroup_num].empty()) {
-            return nullptr;
-        }
-
-        if(pending_sst_sends[subgroup_num] || next_sends[subgroup_num]) {
+        if(next_sends[subgroup_num]) {
             return nullptr;
         }
 
@@ -1341,14 +1864,21 @@ char* MulticastGroup::get_sendbuffer_ptr(subgroup_id_t subgroup_num,
         msg.sender_id = members[member_index];
         msg.index = future_message_indices[subgroup_num];
         msg.size = msg_size;
-        msg.message_buffer = std::move(free_message_buffers[subgroup_num].back());
-        free_message_buffers[subgroup_num].pop_back();
+        if(lent_buffer) {
+            msg.message_buffer = std::move(*lent_buffer);
+        } else {
+            msg.message_buffer = buffer_pool->allocate(msg_size);
+            // The pool is at its limit on registered memory; wait for a buffer to be freed
+            if(!msg.message_buffer.mr) {
+                return nullptr;
+            }
+        }
 
         auto current_time = get_walltime();
         pending_message_timestamps[subgroup_num].insert(current_time);
 
         // Fill header
-        char* buf = msg.message_buffer.buffer.get();
+        char* buf = msg.message_buffer.data();
         ((header*)buf)->header_size = sizeof(header);
         ((header*)buf)->index = msg.index;
         ((header*)buf)->timestamp = current_time;
@@ -1360,20 +1890,30 @@ char* MulticastGroup::get_sendbuffer_ptr(subgroup_id_t subgroup_num,
         last_transfer_medium[subgroup_num] = true;
         return buf + sizeof(header);
     } else {
-        if(pending_sst_sends[subgroup_num] || next_sends[subgroup_num]) {
+        if(thread_shutdown) {
             return nullptr;
         }
-
-        pending_sst_sends[subgroup_num] = true;
-        if(thread_shutdown) {
-            pending_sst_sends[subgroup_num] = false;
+        // A run of nulls waiting to be sent must occupy consecutive slots
+        if(num_nulls_queued[subgroup_num] > 0) {
             return nullptr;
         }
-        char* buf = (char*)sst_multicast_group_ptrs[subgroup_num]->get_buffer(msg_size);
+        char* buf;
+        if(smc_packing) {
+            buf = get_packed_buffer(subgroup_num, msg_size);
+        } else if(smc_ring_size) {
+            buf = get_ring_buffer(subgroup_num, msg_size);
+        } else {
+            buf = (char*)sst_multicast_group_ptrs[subgroup_num]->get_buffer(msg_size);
+        }
         if(!buf) {
-            pending_sst_sends[subgroup_num] = false;
             return nullptr;
         }
+        // A packed message goes in the open slot, which is the one after the last closed slot
+        last_sst_send_position[subgroup_num] = closed_sst_index[subgroup_num] + 1;
+        if(!smc_packing) {
+            closed_sst_index[subgroup_num]++;
+        }
+        smc_unfinished_writes[subgroup_num][last_sst_send_position[subgroup_num] % smc_num_positions[subgroup_num]]++;
         auto current_time = get_walltime();
         pending_message_timestamps[subgroup_num].insert(current_time);
 
@@ -1396,7 +1936,7 @@ bool MulticastGroup::send(subgroup_id_t subgroup_num, long long unsigned int pay
     if(!rdmc_sst_groups_created) {
         return false;
     }
-    std::unique_lock<std::recursive_mutex> lock(msg_state_mtx);
+    std::unique_lock<std::recursive_mutex> lock(msg_state_mtxs[subgroup_num]);
     char* buf = get_sendbuffer_ptr(subgroup_num, payload_size, cooked_send);
     while(!buf) {
         // Don't want any deadlocks. For example, this thread cannot get a buffer because delivery is lagging
@@ -1410,35 +1950,162 @@ bool MulticastGroup::send(subgroup_id_t subgroup_num, long long unsigned int pay
         lock.lock();
         buf = get_sendbuffer_ptr(subgroup_num, payload_size, cooked_send);
     }
-    // call to the user supplied message generator
-    msg_generator(buf);
-
     if(last_transfer_medium[subgroup_num]) {
+        // next_sends is handed over to the next view's MulticastGroup, so it stays locked
+        msg_generator(buf);
         assert(next_sends[subgroup_num]);
         pending_sends[subgroup_num].push(std::move(*next_sends[subgroup_num]));
         next_sends[subgroup_num] = std::nullopt;
-        sender_cv.notify_all();
+        wake_sender();
         return true;
     } else {
-        committed_sst_index[subgroup_num]++;
-        pending_sst_sends[subgroup_num] = false;
+        // The slot is reserved for this message, so other threads can take
+        // slots in the same subgroup while the user supplied message generator fills it
+        const uint32_t sst_send_position = last_sst_send_position[subgroup_num];
+        lock.unlock();
+        msg_generator(buf);
+        // sst_send_trigger commits the slot once every message in it has been written
+        smc_unfinished_writes[subgroup_num][sst_send_position % smc_num_positions[subgroup_num]].fetch_sub(
+                1, std::memory_order_release);
+        // sst_send_trigger runs on the predicate thread, which may be waiting for work
+        sst->notify_predicate_thread(predicate_partition_for(subgroup_num));
         return true;
     }
 }
 
-bool MulticastGroup::check_pending_sst_sends(subgroup_id_t subgroup_num) {
-    std::lock_guard<std::recursive_mutex> lock(msg_state_mtx);
-    return pending_sst_sends[subgroup_num];
+bool MulticastGroup::send_registered(subgroup_id_t subgroup_num, char* buffer, long long unsigned int size,
+                                     const registered_buffer_callback_t& release_callback) {
+    if(!rdmc_sst_groups_created) {
+        return false;
+    }
+    if(size < sizeof(header)) {
+        throw derecho_exception("A registered send buffer must begin with room for the message header");
+    }
+    const long long unsigned int payload_size = size - sizeof(header);
+    const uint64_t sub_header_size = smc_packing ? sizeof(packed_message_header) : 0;
+    if(size + sub_header_size <= subgroup_settings_map.at(subgroup_num).profile.sst_max_msg_size) {
+        // SMC copies every message into its slots, so there is nothing to gain from registering the buffer
+        if(!send(subgroup_num, payload_size, [&](char* buf) {
+                memcpy(buf, buffer + sizeof(header), payload_size);
+            }, false)) {
+            return false;
+        }
+        release_callback(buffer);
+        return true;
+    }
+    // Registering a large buffer takes a while, so do it before taking the subgroup's lock
+    MessageBuffer lent_buffer(get_registered_region(buffer, size), buffer, size, release_callback);
+    std::unique_lock<std::recursive_mutex> lock(msg_state_mtxs[subgroup_num]);
+    char* buf = get_sendbuffer_ptr(subgroup_num, payload_size, false, &lent_buffer);
+    while(!buf) {
+        lock.unlock();
+        if(thread_shutdown) {
+            return false;
+        }
+        lock.lock();
+        buf = get_sendbuffer_ptr(subgroup_num, payload_size, false, &lent_buffer);
+    }
+    pending_sends[subgroup_num].push(std::move(*next_sends[subgroup_num]));
+    next_sends[subgroup_num] = std::nullopt;
+    wake_sender();
+    return true;
 }
 
-std::vector<uint32_t> MulticastGroup::get_shard_sst_indices(subgroup_id_t subgroup_num) {
-    std::vector<node_id_t> shard_members = subgroup_settings_map.at(subgroup_num).members;
+void MulticastGroup::release_message_buffer(MessageBuffer&& message_buffer) {
+    if(message_buffer.is_lent()) {
+        char* lent_buffer = message_buffer.data();
+        registered_buffer_callback_t release_callback = std::move(message_buffer.release_callback);
+        message_buffer = MessageBuffer();
+        release_callback(lent_buffer);
+    } else {
+        buffer_pool->release(std::move(message_buffer));
+    }
+}
 
-    std::vector<uint32_t> shard_sst_indices;
-    for(auto m : shard_members) {
-        shard_sst_indices.push_back(node_id_to_sst_index.at(m));
+void MulticastGroup::prepare_buffer_pool() {
+    std::set<uint32_t> size_classes;
+    // What one buffer of the largest message size per window slot of each shard member would take
+    std::size_t window_bytes = 0;
+    for(const auto& p : subgroup_settings_map) {
+        const DerechoParams& profile = p.second.profile;
+        // Only messages that do not fit in an SST multicast slot go through RDMC
+        if(profile.max_msg_size <= profile.sst_max_msg_size) {
+            continue;
+        }
+        const uint32_t largest_size_class = buffer_pool->get_size_class(profile.max_msg_size);
+        for(uint32_t size_class = buffer_pool->get_size_class(profile.sst_max_msg_size + 1);
+            size_class <= largest_size_class; ++size_class) {
+            size_classes.insert(size_class);
+        }
+        window_bytes += profile.window_size * p.second.members.size() * buffer_pool->get_buffer_size(largest_size_class);
+    }
+    std::size_t reserved_bytes = 0;
+    for(const uint32_t size_class : size_classes) {
+        reserved_bytes += buffer_pool->get_slab_size(size_class);
+    }
+    std::size_t max_bytes = getConfUInt64(CONF_DERECHO_MAX_MESSAGE_BUFFER_BYTES);
+    if(max_bytes == 0) {
+        max_bytes = window_bytes + reserved_bytes;
+    } else if(max_bytes < reserved_bytes) {
+        // Each size class needs a slab, or sends of that size would wait forever
+        dbg_default_warn("{} is {} bytes, but the subgroups' message sizes need at least {} bytes",
+                         CONF_DERECHO_MAX_MESSAGE_BUFFER_BYTES, max_bytes, reserved_bytes);
+        max_bytes = reserved_bytes;
+    }
+    buffer_pool->set_max_registered_bytes(max_bytes);
+    for(const uint32_t size_class : size_classes) {
+        if(!buffer_pool->reserve(size_class)) {
+            dbg_default_warn("Could not register message buffers of {} bytes within {}",
+                             buffer_pool->get_buffer_size(size_class), CONF_DERECHO_MAX_MESSAGE_BUFFER_BYTES);
+        }
     }
-    return shard_sst_indices;
+}
+
+std::shared_ptr<rdma::memory_region> MulticastGroup::get_registered_region(char* buffer, size_t size) {
+    std::lock_guard<std::mutex> lock(registration_cache_mtx);
+    // The region that starts closest before the buffer is the only one that can cover it
+    auto region = registered_send_buffers.upper_bound(buffer);
+    if(region != registered_send_buffers.begin()) {
+        --region;
+        const std::shared_ptr<rdma::memory_region>& mr = region->second.first;
+        if(buffer + size <= mr->buffer + mr->size) {
+            region->second.second = ++registration_cache_clock;
+            return mr;
+        }
+    }
+    auto mr = std::make_shared<rdma::memory_region>(buffer, size);
+    registered_send_buffers[buffer] = {mr, ++registration_cache_clock};
+    // Messages still being sent from an evicted region keep it registered until they are done
+    while(registered_send_buffers.size() > max_registered_send_buffers) {
+        registered_send_buffers.erase(std::min_element(
+                registered_send_buffers.begin(), registered_send_buffers.end(),
+                [](const auto& a, const auto& b) { return a.second.second < b.second.second; }));
+    }
+    return mr;
+}
+
+void MulticastGroup::unregister_send_buffer(char* buffer, std::size_t size) {
+    std::lock_guard<std::mutex> lock(registration_cache_mtx);
+    for(auto region = registered_send_buffers.begin(); region != registered_send_buffers.end();) {
+        const std::shared_ptr<rdma::memory_region>& mr = region->second.first;
+        if(mr->buffer < buffer + size && buffer < mr->buffer + mr->size) {
+            region = registered_send_buffers.erase(region);
+        } else {
+            ++region;
+        }
+    }
+}
+
+bool MulticastGroup::check_pending_sst_sends(subgroup_id_t subgroup_num) {
+    std::lock_guard<std::recursive_mutex> lock(msg_state_mtxs[subgroup_num]);
+    // Messages are pending from when their slot is taken until they have been written
+    const int32_t last_taken = closed_sst_index[subgroup_num] + (open_smc_slots[subgroup_num].buf ? 1 : 0);
+    for(int32_t position = static_cast<int32_t>(committed_sst_index[subgroup_num]) + 1; position <= last_taken; ++position) {
+        if(smc_unfinished_writes[subgroup_num][position % smc_num_positions[subgroup_num]].load() > 0) {
+            return true;
+        }
+    }
+    return false;
 }
 
 void MulticastGroup::debug_print() {
@@ -1469,9 +2136,13 @@ void MulticastGroup::debug_print() {
         cout << endl;
     }
 
-    std::cout << "Printing memory usage of free_message_buffers" << std::endl;
-    for(const auto& p : free_message_buffers) {
-        std::cout << "Subgroup " << p.first << ", Number of free buffers " << p.second.size() << std::endl;
+    std::cout << "Printing memory usage of the message buffer pool" << std::endl;
+    std::cout << "Registered " << buffer_pool->get_registered_bytes() << " bytes in "
+              << buffer_pool->get_num_slabs() << " slabs" << std::endl;
+    const std::vector<std::size_t> num_free_buffers = buffer_pool->get_num_free_buffers();
+    for(uint32_t size_class = 0; size_class < num_free_buffers.size(); ++size_class) {
+        std::cout << "Buffer size " << buffer_pool->get_buffer_size(size_class)
+                  << ", Number of free buffers " << num_free_buffers[size_class] << std::endl;
     }
 }
 
@@ -12,7 +12,7 @@
 namespace sst {
 P2PConnection::P2PConnection(uint32_t my_node_id, uint32_t remote_id, uint64_t p2p_buf_size, const RequestParams& request_params)
         : my_node_id(my_node_id), remote_id(remote_id), request_params(request_params) {
-    incoming_p2p_buffer = std::make_unique<volatile char[]>(p2p_buf_size);
+    incoming_p2p_buffer.reset(shm_allocate(p2p_buf_size));
     outgoing_p2p_buffer = std::make_unique<volatile char[]>(p2p_buf_size);
 
     for(auto type : p2p_request_types) {
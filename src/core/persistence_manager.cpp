@@ -118,17 +118,18 @@ void PersistenceManager::handle_persist_request(subgroup_id_t subgroup_id, persi
         SharedLockedReference<View> view_and_lock = view_manager->get_current_view();
         // update the signature and persisted_num in SST
         View& Vc = view_and_lock.get();
+        // The signature must reach the other members before persisted_num does;
+        // the fence keeps them in separate writes, in that order, in a single post per member
+        sst::SSTWriteBatch batch = Vc.gmsSST->make_write_batch();
         if(object_has_signature) {
             gmssst::set(&(Vc.gmsSST->signatures[Vc.gmsSST->get_local_index()][subgroup_id * signature_size]),
                         signature, signature_size);
-            Vc.gmsSST->put(Vc.multicast_group->get_shard_sst_indices(subgroup_id),
-                           (char*)(&Vc.gmsSST->signatures[0][subgroup_id * signature_size]) - Vc.gmsSST->getBaseAddress(),
-                           signature_size);
+            batch.add(Vc.gmsSST->signatures, subgroup_id * signature_size, signature_size);
+            batch.fence();
         }
         gmssst::set(Vc.gmsSST->persisted_num[Vc.gmsSST->get_local_index()][subgroup_id], persisted_version);
-        Vc.gmsSST->put(Vc.multicast_group->get_shard_sst_indices(subgroup_id),
-                       Vc.gmsSST->persisted_num,
-                       subgroup_id);
+        batch.add(Vc.gmsSST->persisted_num, subgroup_id);
+        Vc.gmsSST->put(Vc.multicast_group->get_shard_sst_indices(subgroup_id), batch);
         last_persisted_version[subgroup_id] = persisted_version;
     } catch(uint64_t exp) {
         dbg_default_debug("exception on persist():subgroup={},ver={},exp={}.", subgroup_id, version, exp);
@@ -147,7 +148,7 @@ void PersistenceManager::handle_verify_request(subgroup_id_t subgroup_id, persis
         //Read lock the View while reading the SST
         SharedLockedReference<View> view_and_lock = view_manager->get_current_view();
         View& Vc = view_and_lock.get();
-        std::vector<uint32_t> shard_member_ranks = Vc.multicast_group->get_shard_sst_indices(subgroup_id);
+        const std::vector<uint32_t>& shard_member_ranks = Vc.multicast_group->get_shard_sst_indices(subgroup_id);
         persistent::version_t minimum_verified_version = std::numeric_limits<persistent::version_t>::max();
         //For each other member of this node's shard, try to verify the signature in its SST row
         for(const uint32_t shard_member_rank : shard_member_ranks) {
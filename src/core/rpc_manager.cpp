@@ -4,6 +4,7 @@
  * @date Feb 7, 2017
  */
 
+#include <algorithm>
 #include <cassert>
 #include <iostream>
 
@@ -121,18 +122,10 @@ std::exception_ptr RPCManager::parse_and_receive(char* buf, std::size_t size,
                            payload_size, out_alloc);
 }
 
-void RPCManager::rpc_message_handler(subgroup_id_t subgroup_id, node_id_t sender_id,
-                                     persistent::version_t version, uint64_t timestamp,
-                                     char* msg_buf, uint32_t buffer_size) {
-    // WARNING: This assumes the current view doesn't change during execution!
-    // (It accesses curr_view without a lock).
-
-    // set the thread local rpc_handler context
-    _in_rpc_handler = true;
-
+std::size_t RPCManager::receive_ordered_message(node_id_t sender_id, char* msg_buf, uint32_t buffer_size,
+                                                char*& reply_buf) {
     //Use the reply-buffer allocation lambda to detect whether parse_and_receive generated a reply
     size_t reply_size = 0;
-    char* reply_buf;
     parse_and_receive(msg_buf, buffer_size,
                       [this, &reply_buf, &reply_size, &sender_id](size_t size) -> char* {
                           reply_size = size;
@@ -145,6 +138,24 @@ void RPCManager::rpc_message_handler(subgroup_id_t subgroup_id, node_id_t sender
                               throw buffer_overflow_exception("Size of a P2P reply exceeds the maximum P2P reply message size");
                           }
                       });
+    if(sender_id != nid && reply_size > 0) {
+        //If this is not a self-receive, the only thing to do is send the reply (if there was one)
+        connections->send(sender_id);
+    }
+    return reply_size;
+}
+
+void RPCManager::rpc_message_handler(subgroup_id_t subgroup_id, node_id_t sender_id,
+                                     persistent::version_t version, uint64_t timestamp,
+                                     char* msg_buf, uint32_t buffer_size) {
+    // WARNING: This assumes the current view doesn't change during execution!
+    // (It accesses curr_view without a lock).
+
+    // set the thread local rpc_handler context
+    _in_rpc_handler = true;
+
+    char* reply_buf;
+    const size_t reply_size = receive_ordered_message(sender_id, msg_buf, buffer_size, reply_buf);
     if(sender_id == nid) {
         //This is a self-receive of an RPC message I sent, so I have a reply-map that needs fulfilling
         const uint32_t my_shard = view_manager.unsafe_get_current_view().my_subgroups.at(subgroup_id);
@@ -174,9 +185,59 @@ void RPCManager::rpc_message_handler(subgroup_id_t subgroup_id, node_id_t sender
                     reply_buf, reply_size,
                     [](size_t size) -> char* { assert_always(false); });
         }
-    } else if(reply_size > 0) {
-        //Otherwise, the only thing to do is send the reply (if there was one)
-        connections->send(sender_id);
+    }
+
+    // clear the thread local rpc_handler context
+    _in_rpc_handler = false;
+}
+
+void RPCManager::rpc_batch_handler(subgroup_id_t subgroup_id, const std::vector<rpc_message_t>& messages,
+                                   const std::function<void(std::size_t)>& message_delivered) {
+    // WARNING: This assumes the current view doesn't change during execution!
+    // (It accesses curr_view without a lock).
+
+    // set the thread local rpc_handler context once for the whole batch
+    _in_rpc_handler = true;
+
+    //Fulfill the reply maps of all the messages I sent in this batch, in order, under one lock.
+    //This only records the versions and the repliers, so it can come before the messages are handled.
+    const bool any_self_receives = std::any_of(messages.begin(), messages.end(),
+                                               [this](const rpc_message_t& message) { return message.sender_id == nid; });
+    if(any_self_receives) {
+        const View& curr_view = view_manager.unsafe_get_current_view();
+        const uint32_t my_shard = curr_view.my_subgroups.at(subgroup_id);
+        const std::vector<node_id_t>& shard_members = curr_view.subgroup_shard_views.at(subgroup_id).at(my_shard).members;
+        const bool subgroup_is_persistent = view_manager.subgroup_is_persistent(subgroup_id);
+        std::unique_lock<std::mutex> lock(pending_results_mutex);
+        for(const rpc_message_t& message : messages) {
+            if(message.sender_id != nid) {
+                continue;
+            }
+            // as in rpc_message_handler, the thread that called orderedSend may not have queued its PendingResults yet
+            pending_results_cv.wait(lock, [&]() { return !pending_results_to_fulfill[subgroup_id].empty(); });
+            pending_results_to_fulfill[subgroup_id].front().get().fulfill_map(shard_members);
+            pending_results_to_fulfill[subgroup_id].front().get().set_persistent_version(message.version, message.timestamp);
+            if(subgroup_is_persistent) {
+                results_awaiting_local_persistence[subgroup_id].emplace(message.version,
+                                                                        pending_results_to_fulfill[subgroup_id].front());
+            } else {
+                completed_pending_results[subgroup_id].emplace_back(pending_results_to_fulfill[subgroup_id].front());
+            }
+            pending_results_to_fulfill[subgroup_id].pop();
+        }
+    }  //release pending_results_mutex
+
+    for(std::size_t i = 0; i < messages.size(); ++i) {
+        const rpc_message_t& message = messages[i];
+        char* reply_buf;
+        const size_t reply_size = receive_ordered_message(message.sender_id, message.buffer, message.size, reply_buf);
+        if(message.sender_id == nid && reply_size > 0) {
+            //Since this was a self-receive, the reply also goes to myself
+            parse_and_receive(
+                    reply_buf, reply_size,
+                    [](size_t size) -> char* { assert_always(false); });
+        }
+        message_delivered(i);
     }
 
     // clear the thread local rpc_handler context
@@ -382,6 +443,8 @@ void RPCManager::finish_p2p_send(node_id_t dest_id, subgroup_id_t dest_subgroup_
     } catch(std::out_of_range& map_error) {
         throw node_removed_from_group_exception(dest_id);
     }
+    // A reply is expected soon, so make sure the listening thread is not asleep
+    p2p_polling.notify();
     pending_results_handle.fulfill_map({dest_id});
     std::lock_guard<std::mutex> lock(pending_results_mutex);
     // These PendingResults don't need to have ReplyMaps fulfilled, and they
@@ -452,9 +515,6 @@ void RPCManager::p2p_receive_loop() {
     // start the fifo worker thread
     request_worker_thread = std::thread(&RPCManager::p2p_request_worker, this);
 
-    struct timespec last_time, cur_time;
-    clock_gettime(CLOCK_REALTIME, &last_time);
-
     // loop event
     while(!thread_shutdown) {
         bool message_received = false;
@@ -471,22 +531,16 @@ void RPCManager::p2p_receive_loop() {
                     p2p_message_handler(reply_pair.first, (char*)reply_pair.second);
                     connections->update_incoming_seq_num(reply_pair.first);
                 }
-                // update last time
-                clock_gettime(CLOCK_REALTIME, &last_time);
+                p2p_polling.on_progress();
             }
         }
         //Release the View lock before going to sleep if no messages were received
         if(!message_received) {
-            clock_gettime(CLOCK_REALTIME, &cur_time);
-            // check if the system has been inactive for enough time to induce sleep
-            double time_elapsed_in_ms = (cur_time.tv_sec - last_time.tv_sec) * 1e3
-                                        + (cur_time.tv_nsec - last_time.tv_nsec) / 1e6;
-            if(time_elapsed_in_ms > 1) {
-                using namespace std::chrono_literals;
-                std::this_thread::sleep_for(1ms);
-            }
+            p2p_polling.on_idle();
         }
     }
+    dbg_default_debug("P2P listening thread wakeup latencies:\n{}",
+                      p2p_polling.get_wakeup_latencies().to_string());
     // stop fifo worker.
     request_queue_cv.notify_one();
     request_worker_thread.join();
@@ -1105,20 +1105,26 @@ void ViewManager::acknowledge_proposed_change(DerechoSST& gmsSST) {
 
     // Acknowledge the proposed changes
     gmssst::set(gmsSST.num_acked[myRank], gmsSST.num_changes[myRank]);
+    sst::SSTWriteBatch batch = gmsSST.make_write_batch();
     if(myRank != leader) {
         /* The leader should not push the changes information here, since it may
          * not be ready to push a batch of changes (if the next view would be
-         * inadequate). Non-leaders should push the fields in order in separate
-         * put() calls, to preserve ordering between dependent fields.
+         * inadequate). Non-leaders should push the fields in order; the
+         * fences keep each counter from being seen before the fields it covers.
          */
-        gmsSST.put(gmsSST.changes);
-        //This pushes the contiguous set of joiner_xxx_ports fields all at once
-        gmsSST.put(gmsSST.joiner_ips.get_base() - gmsSST.getBaseAddress(),
-                   gmsSST.num_changes.get_base() - gmsSST.joiner_ips.get_base());
-        gmsSST.put(gmsSST.num_changes);
-        gmsSST.put(gmsSST.num_committed);
-    }
-    gmsSST.put(gmsSST.num_acked);
+        batch.add(gmsSST.changes);
+        //This pushes the contiguous set of joiner_xxx_ports fields all at once; the
+        //range comes from the field bases, so it covers any padding between them
+        batch.add(gmsSST.joiner_ips.get_base() - gmsSST.getBaseAddress(),
+                  gmsSST.num_changes.get_base() - gmsSST.joiner_ips.get_base());
+        batch.fence();
+        batch.add(gmsSST.num_changes);
+        batch.fence();
+        batch.add(gmsSST.num_committed);
+    }
+    batch.fence();
+    batch.add(gmsSST.num_acked);
+    gmsSST.put(batch);
     dbg_default_debug("Wedging current view.");
     curr_view->wedge();
     dbg_default_debug("Done wedging current view.");
@@ -1493,6 +1499,7 @@ void ViewManager::finish_view_change(DerechoSST& gmsSST) {
         old_views_cv.notify_all();
     }
     curr_view = std::move(next_view);
+    min_acked_rows.clear();
 
     if(any_persistent_objects) {
         // Write the new view to disk before using it
@@ -1538,7 +1545,8 @@ void ViewManager::construct_multicast_group(const UserMessageCallbacks& callback
                     curr_view->members, curr_view->members[curr_view->my_rank],
                     [this](const uint32_t node_id) { report_failure(node_id); },
                     curr_view->failed, false),
-            num_subgroups, signature_size, num_received_size, slot_size, index_field_size);
+            num_subgroups, signature_size, num_received_size, slot_size, index_field_size,
+            getConfBoolean(CONF_DERECHO_SST_PER_SHARD_SMC) ? 0 : num_received_size);
 
     curr_view->multicast_group = std::make_unique<MulticastGroup>(
             curr_view->members, curr_view->members[curr_view->my_rank],
@@ -1558,7 +1566,8 @@ void ViewManager::transition_multicast_group(
                     next_view->members, next_view->members[next_view->my_rank],
                     [this](const uint32_t node_id) { report_failure(node_id); },
                     next_view->failed, false),
-            num_subgroups, signature_size, new_num_received_size, new_slot_size, new_index_field_size);
+            num_subgroups, signature_size, new_num_received_size, new_slot_size, new_index_field_size,
+            getConfBoolean(CONF_DERECHO_SST_PER_SHARD_SMC) ? 0 : new_num_received_size);
 
     next_view->multicast_group = std::make_unique<MulticastGroup>(
             next_view->members, next_view->members[next_view->my_rank],
@@ -1668,12 +1677,14 @@ std::vector<int> ViewManager::process_suspicions(DerechoSST& gmsSST) {
 
             dbg_default_debug("GMS telling SST to freeze row {}", curr_rank);
             gmsSST.freeze(curr_rank);
+            curr_view->multicast_group->freeze_shard_sst_rows(curr_view->members[curr_rank]);
             //These two lines are the same as Vc.wedge()
             curr_view->multicast_group->wedge();
             gmssst::set(gmsSST.wedged[my_rank], true);
             //Synchronize Vc.failed with gmsSST.suspected
             curr_view->failed[curr_rank] = true;
             curr_view->num_failed++;
+            min_acked_rows.clear();
 
             if(!gmsSST.rip[my_rank] && curr_view->num_failed != 0
                && (curr_view->num_failed - num_departed >= (curr_view->num_members - num_departed + 1) / 2)) {
@@ -1685,10 +1696,12 @@ std::vector<int> ViewManager::process_suspicions(DerechoSST& gmsSST) {
                 }
             }
 
-            // push change to gmsSST.suspected[myRank]
-            gmsSST.put(gmsSST.suspected);
-            // push change to gmsSST.wedged[myRank]
-            gmsSST.put(gmsSST.wedged);
+            // push changes to gmsSST.suspected[myRank] and gmsSST.wedged[myRank]
+            sst::SSTWriteBatch batch = gmsSST.make_write_batch();
+            batch.add(gmsSST.suspected);
+            batch.fence();
+            batch.add(gmsSST.wedged);
+            gmsSST.put(batch);
         }
     }
     return failed_ranks;
@@ -1831,9 +1844,12 @@ void ViewManager::make_subgroup_maps(const SubgroupInfo& subgroup_info,
 
 std::tuple<uint32_t, uint32_t, uint32_t> ViewManager::derive_subgroup_settings(View& view,
                                                                                std::map<subgroup_id_t, SubgroupSettings>& subgroup_settings) {
+    // With per-shard SMC SSTs, the top-level SST has no SMC columns, and each
+    // shard's columns start at offset 0 of its own SST
+    const bool per_shard_smc = getConfBoolean(CONF_DERECHO_SST_PER_SHARD_SMC);
     uint32_t num_received_offset = 0;
     uint32_t slot_offset = 0;
-    uint32_t index_field_size = view.subgroup_shard_views.size();
+    uint32_t index_field_size = per_shard_smc ? 0 : view.subgroup_shard_views.size();
     view.my_subgroups.clear();
     for(subgroup_id_t subgroup_id = 0; subgroup_id < view.subgroup_shard_views.size(); ++subgroup_id) {
         uint32_t num_shards = view.subgroup_shard_views.at(subgroup_id).size();
@@ -1846,7 +1862,7 @@ std::tuple<uint32_t, uint32_t, uint32_t> ViewManager::derive_subgroup_settings(V
             max_shard_senders = std::max(shard_view.num_senders(), max_shard_senders);
 
             const DerechoParams& profile = DerechoParams::from_profile(shard_view.profile);
-            uint32_t slot_size_for_shard = profile.window_size * (profile.sst_max_msg_size + sizeof(uint64_t));
+            uint32_t slot_size_for_shard = profile.smc_region_size();
             uint64_t payload_size = profile.max_msg_size - sizeof(header);
             max_payload_size = std::max(payload_size, max_payload_size);
             view_max_rpc_reply_payload_size = std::max(
@@ -1869,14 +1885,16 @@ std::tuple<uint32_t, uint32_t, uint32_t> ViewManager::derive_subgroup_settings(V
                         shard_view.sender_rank_of(shard_view.my_rank),
                         num_received_offset,
                         slot_offset,
-                        subgroup_id,
+                        per_shard_smc ? 0 : subgroup_id,
                         shard_view.mode,
                         profile,
                 };
             }
         }  // for(shard_num)
         num_received_offset += max_shard_senders;
-        slot_offset += slot_size_for_subgroup;
+        if(!per_shard_smc) {
+            slot_offset += slot_size_for_subgroup;
+        }
         max_payload_sizes[subgroup_id] = max_payload_size;
     }  // for(subgroup_id)
 
@@ -2096,17 +2114,17 @@ bool ViewManager::changes_includes_end_of_view(const DerechoSST& gmsSST, const i
 }
 
 int ViewManager::min_acked(const DerechoSST& gmsSST, const std::vector<char>& failed) {
-    int myRank = gmsSST.get_local_index();
-    int min_num_acked = gmsSST.num_acked[myRank];
-    for(size_t n = 0; n < failed.size(); n++) {
-        if(!failed[n]) {
-            // copy to avoid race condition and non-volatile based optimizations
-            int num_acked_copy = gmsSST.num_acked[n];
-            min_num_acked = std::min(min_num_acked, num_acked_copy);
+    // The rows to reduce over only change when a member fails or the view
+    // changes, and both of those clear min_acked_rows
+    if(min_acked_rows.empty()) {
+        min_acked_rows.push_back(gmsSST.get_local_index());
+        for(uint32_t n = 0; n < failed.size(); n++) {
+            if(!failed[n]) {
+                min_acked_rows.push_back(n);
+            }
         }
     }
-
-    return min_num_acked;
+    return gmsSST.reduce(gmsSST.num_acked, min_acked_rows, sst::reduce_min());
 }
 
 bool ViewManager::previous_leaders_suspected(const DerechoSST& gmsSST, const View& curr_view) {
@@ -2235,12 +2253,11 @@ void ViewManager::leader_ragged_edge_cleanup(const subgroup_id_t subgroup_num,
 
     dbg_default_debug("Shard leader for subgroup {} finished computing global_min", subgroup_num);
     gmssst::set(Vc.gmsSST->global_min_ready[myRank][subgroup_num], true);
-    Vc.gmsSST->put(
-            Vc.multicast_group->get_shard_sst_indices(subgroup_num),
-            (char*)std::addressof(Vc.gmsSST->global_min[0][num_received_offset]) - Vc.gmsSST->getBaseAddress(),
-            sizeof(Vc.gmsSST->global_min[0][num_received_offset]) * num_shard_senders);
-    Vc.gmsSST->put(Vc.multicast_group->get_shard_sst_indices(subgroup_num),
-                   Vc.gmsSST->global_min_ready, subgroup_num);
+    sst::SSTWriteBatch batch = Vc.gmsSST->make_write_batch();
+    batch.add(Vc.gmsSST->global_min, num_received_offset, num_shard_senders);
+    batch.fence();
+    batch.add(Vc.gmsSST->global_min_ready, subgroup_num);
+    Vc.gmsSST->put(Vc.multicast_group->get_shard_sst_indices(subgroup_num), batch);
 
     if(any_persistent_objects) {
         log_ragged_trim(myRank, subgroup_num, num_received_offset, num_shard_senders);
@@ -2263,12 +2280,11 @@ void ViewManager::follower_ragged_edge_cleanup(
                 &Vc.gmsSST->global_min[shard_leader_rank][num_received_offset],
                 num_shard_senders);
     gmssst::set(Vc.gmsSST->global_min_ready[myRank][subgroup_num], true);
-    Vc.gmsSST->put(
-            Vc.multicast_group->get_shard_sst_indices(subgroup_num),
-            (char*)std::addressof(Vc.gmsSST->global_min[0][num_received_offset]) - Vc.gmsSST->getBaseAddress(),
-            sizeof(Vc.gmsSST->global_min[0][num_received_offset]) * num_shard_senders);
-    Vc.gmsSST->put(Vc.multicast_group->get_shard_sst_indices(subgroup_num),
-                   Vc.gmsSST->global_min_ready, subgroup_num);
+    sst::SSTWriteBatch batch = Vc.gmsSST->make_write_batch();
+    batch.add(Vc.gmsSST->global_min, num_received_offset, num_shard_senders);
+    batch.fence();
+    batch.add(Vc.gmsSST->global_min_ready, subgroup_num);
+    Vc.gmsSST->put(Vc.multicast_group->get_shard_sst_indices(subgroup_num), batch);
 }
 
 void ViewManager::deliver_in_order(const int shard_leader_rank,
@@ -2374,6 +2390,19 @@ void ViewManager::send(subgroup_id_t subgroup_num, long long unsigned int payloa
     });
 }
 
+void ViewManager::send_registered(subgroup_id_t subgroup_num, char* buffer, long long unsigned int size,
+                                  const registered_buffer_callback_t& release_callback) {
+    shared_lock_t lock(view_mutex);
+    view_change_cv.wait(lock, [&]() {
+        return curr_view->multicast_group->send_registered(subgroup_num, buffer, size, release_callback);
+    });
+}
+
+void ViewManager::unregister_send_buffer(char* buffer, std::size_t size) {
+    shared_lock_t lock(view_mutex);
+    curr_view->multicast_group->unregister_send_buffer(buffer, size);
+}
+
 const uint64_t ViewManager::compute_global_stability_frontier(subgroup_id_t subgroup_num) {
     shared_lock_t lock(view_mutex);
     return curr_view->multicast_group->compute_global_stability_frontier(subgroup_num);
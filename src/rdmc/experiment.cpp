@@ -288,6 +288,66 @@ void compare_send_types() {
     puts("");
     fflush(stdout);
 }
+// Counts the block transfers of one message of num_blocks blocks that cross
+// from one rack to another, given the rack of each group member.
+size_t count_cross_rack_transfers(rdmc::send_algorithm type,
+                                  const vector<uint32_t> &member_racks,
+                                  size_t num_blocks) {
+    uint32_t group_size = member_racks.size();
+    size_t transfers = 0;
+    for(uint32_t member = 0; member < group_size; member++) {
+        unique_ptr<schedule> s;
+        if(type == rdmc::HYBRID_SEND) {
+            s = make_unique<hybrid_schedule>(group_size, member, member_racks);
+        } else {
+            s = make_unique<binomial_schedule>(group_size, member);
+        }
+        for(size_t step = 0; step < s->get_total_steps(num_blocks); step++) {
+            auto transfer = s->get_outgoing_transfer(num_blocks, step);
+            if(transfer && member_racks[transfer->target] != member_racks[member]) {
+                transfers++;
+            }
+        }
+    }
+    return transfers;
+}
+void compare_hybrid_send() {
+    puts("=========================================================");
+    puts("=     Binomial vs. Hybrid (Rack-Aware) Send - Gb/s      =");
+    puts("=========================================================");
+    puts(
+            "Group Size, Racks,"
+            "Binomial Pipeline (64 MB),Hybrid Send (64 MB),"
+            "Binomial Pipeline (8 MB),Hybrid Send (8 MB),"
+            "Binomial Cross-Rack Blocks (64 MB),Hybrid Cross-Rack Blocks (64 MB)");
+    fflush(stdout);
+
+    const size_t block_size = 1 << 20;
+    const size_t iterations = 64;
+    for(uint32_t gsize = num_nodes; gsize >= 2; --gsize) {
+        vector<uint32_t> members;
+        for(uint32_t i = 0; i < gsize; i++) members.push_back(i);
+        auto member_racks = rdmc::get_member_racks(members);
+        size_t num_racks = set<uint32_t>(member_racks.begin(), member_racks.end()).size();
+
+        auto bp8 = measure_multicast(8 << 20, block_size, gsize, iterations,
+                                     rdmc::BINOMIAL_SEND);
+        auto bp64 = measure_multicast(64 << 20, block_size, gsize, iterations,
+                                      rdmc::BINOMIAL_SEND);
+        auto hs8 = measure_multicast(8 << 20, block_size, gsize, iterations,
+                                     rdmc::HYBRID_SEND);
+        auto hs64 = measure_multicast(64 << 20, block_size, gsize, iterations,
+                                      rdmc::HYBRID_SEND);
+        printf("%u, %zu, %f, %f, %f, %f, %zu, %zu\n", gsize, num_racks,
+               bp64.bandwidth.mean, hs64.bandwidth.mean, bp8.bandwidth.mean,
+               hs8.bandwidth.mean,
+               count_cross_rack_transfers(rdmc::BINOMIAL_SEND, member_racks, 64),
+               count_cross_rack_transfers(rdmc::HYBRID_SEND, member_racks, 64));
+        fflush(stdout);
+    }
+    puts("");
+    fflush(stdout);
+}
 void bandwidth_group_size() {
     puts("=========================================================");
     puts("=              Bandwidth vs. Group Size                 =");
@@ -672,6 +732,59 @@ void test_pattern() {
     puts("PASS");
 }
 
+// Checks that hybrid_schedule is consistent for many group sizes and rack
+// layouts: senders and receivers agree on every transfer, nodes only forward
+// blocks they already have, every node gets each block exactly once, and the
+// first block a node gets is the one get_first_block() predicts.
+void test_hybrid_pattern() {
+    for(uint32_t group_size = 2; group_size <= 24; group_size++) {
+        for(uint32_t rack_size = 1; rack_size <= group_size; rack_size++) {
+            // Rotate the racks so that the sender is not always a rack's first node
+            vector<uint32_t> member_racks(group_size);
+            for(uint32_t node = 0; node < group_size; node++) {
+                member_racks[node] = ((node + group_size / 2) % group_size) / rack_size;
+            }
+            vector<unique_ptr<schedule>> schedules;
+            for(uint32_t node = 0; node < group_size; node++) {
+                schedules.push_back(make_unique<hybrid_schedule>(group_size, node, member_racks));
+            }
+            for(size_t num_blocks = 1; num_blocks <= 32; num_blocks++) {
+                size_t total_steps = schedules[0]->get_total_steps(num_blocks);
+                vector<set<size_t>> blocks(group_size);
+                vector<optional<size_t>> first_blocks(group_size);
+                for(size_t b = 0; b < num_blocks; b++) blocks[0].insert(b);
+                for(size_t step = 0; step < total_steps; step++) {
+                    vector<set<size_t>> received(group_size);
+                    for(uint32_t node = 0; node < group_size; node++) {
+                        auto transfer = schedules[node]->get_outgoing_transfer(num_blocks, step);
+                        if(transfer) {
+                            auto reverse = schedules[transfer->target]->get_incoming_transfer(num_blocks, step);
+                            if(!reverse || reverse->target != node) throw false;
+                            if(reverse->block_number != transfer->block_number) throw false;
+                            if(blocks[node].count(transfer->block_number) == 0) throw false;
+                        }
+                        transfer = schedules[node]->get_incoming_transfer(num_blocks, step);
+                        if(transfer) {
+                            if(blocks[node].count(transfer->block_number)) throw false;
+                            received[node].insert(transfer->block_number);
+                            if(!first_blocks[node]) first_blocks[node] = transfer->block_number;
+                        }
+                    }
+                    for(uint32_t node = 0; node < group_size; node++) {
+                        blocks[node].insert(received[node].begin(), received[node].end());
+                    }
+                }
+                for(uint32_t node = 1; node < group_size; node++) {
+                    if(blocks[node].size() != num_blocks) throw false;
+                    auto first = schedules[node]->get_first_block(num_blocks);
+                    if(min(first->block_number, num_blocks - 1) != *first_blocks[node]) throw false;
+                }
+            }
+        }
+    }
+    puts("PASS");
+}
+
 int main(int argc, char *argv[]) {
     // rlimit rlim;
     // rlim.rlim_cur = RLIM_INFINITY;
@@ -681,6 +794,9 @@ int main(int argc, char *argv[]) {
     if(argc >= 2 && strcmp(argv[1], "test_pattern") == 0) {
         test_pattern();
         exit(0);
+    } else if(argc >= 2 && strcmp(argv[1], "test_hybrid_pattern") == 0) {
+        test_hybrid_pattern();
+        exit(0);
     } else if(argc >= 2 && strcmp(argv[1], "spin") == 0) {
         volatile bool b = true;
         while(b)
@@ -728,6 +844,8 @@ int main(int argc, char *argv[]) {
         blocksize_v_bandwidth(16);
     } else if(strcmp(argv[1], "sendtypes") == 0) {
         compare_send_types();
+    } else if(strcmp(argv[1], "hybrid") == 0) {
+        compare_hybrid_send();
     } else if(strcmp(argv[1], "bandwidth") == 0) {
         bandwidth_group_size();
     } else if(strcmp(argv[1], "overhead") == 0) {
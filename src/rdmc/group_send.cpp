@@ -8,7 +8,9 @@
     #include <derecho/rdmc/detail/lf_helper.hpp>
 #endif
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <cstring>
 
 using namespace std;
@@ -22,7 +24,7 @@ extern mutex groups_lock;
 
 decltype(polling_group::message_types) polling_group::message_types;
 
-group::group(uint16_t _group_number, size_t _block_size,
+group::group(uint16_t _group_number, size_t _block_size, size_t _min_block_size,
              vector<uint32_t> _members, uint32_t _member_index,
              incoming_message_callback_t upcall,
              completion_callback_t callback,
@@ -30,6 +32,8 @@ group::group(uint16_t _group_number, size_t _block_size,
         : members(_members),
           group_number(_group_number),
           block_size(_block_size),
+          min_block_size(_min_block_size),
+          adaptive_block_size(min_block_size < block_size),
           num_members(members.size()),
           member_index(_member_index),
           transfer_schedule(std::move(_schedule)),
@@ -67,14 +71,15 @@ void polling_group::initialize_message_types() {
     message_types.ready_for_block = message_type(
             "rdmc.ready_for_block", send_ready_for_block, receive_ready_for_block);
 }
-polling_group::polling_group(uint16_t _group_number, size_t _block_size,
+polling_group::polling_group(uint16_t _group_number, size_t _block_size, size_t _min_block_size,
                              vector<uint32_t> _members, uint32_t _member_index,
                              incoming_message_callback_t upcall,
                              completion_callback_t callback,
                              unique_ptr<schedule> _schedule)
-        : group(_group_number, _block_size, _members, _member_index, upcall,
+        : group(_group_number, _block_size, _min_block_size, _members, _member_index, upcall,
                 callback, std::move(_schedule)),
-          first_block_buffer(nullptr) {
+          first_block_buffer(nullptr),
+          first_block_size(0) {
     if(member_index != 0) {
         first_block_buffer = unique_ptr<char[]>(new char[block_size]);
         memset(first_block_buffer.get(), 0, block_size);
@@ -101,22 +106,31 @@ void polling_group::receive_block(uint32_t send_imm, size_t received_block_size)
     assert(member_index > 0);
 
     if(receive_step == 0) {
-        num_blocks = parse_immediate(send_imm).total_blocks;
+        // The first block tells us the number of blocks and their size
+        ParsedImmediate immediate = parse_immediate(send_imm, adaptive_block_size);
+        num_blocks = immediate.total_blocks;
+        block_size_shift = immediate.block_size_shift;
+        message_block_size = block_size >> block_size_shift;
         first_block_number = min(transfer_schedule->get_first_block(num_blocks)->block_number,
                                  num_blocks - 1);
-        message_size = num_blocks * block_size;
+        first_block_size = received_block_size;
+        message_size = num_blocks * message_block_size;
         if(num_blocks == 1) {
             message_size = received_block_size;
         }
 
-        assert(*first_block_number == parse_immediate(send_imm).block_number);
+        assert(*first_block_number == immediate.block_number);
 
         //////////////////////////////////////////////////////
         auto destination = incoming_message_upcall(message_size);
         mr_offset = destination.offset;
         mr = destination.mr;
 
-        assert(mr->size >= mr_offset + message_size);
+        // Rounding up to whole blocks of this message's size may overshoot a
+        // buffer sized for whole blocks of block_size, but the last block
+        // must still start inside it
+        assert(mr->size > mr_offset + (num_blocks - 1) * message_block_size);
+        message_size = min(message_size, mr->size - mr_offset);
         //////////////////////////////////////////////////////
 
         num_received_blocks = 1;
@@ -182,19 +196,19 @@ void polling_group::receive_block(uint32_t send_imm, size_t received_block_size)
     } else {
         //        assert(tag.index() <= tag.message_size());
         size_t block_number = incoming_block;
-        if(block_number != parse_immediate(send_imm).block_number) {
+        if(block_number != parse_immediate(send_imm, adaptive_block_size).block_number) {
             printf("Expected block #%d but got #%d on step %d\n",
                    (int)block_number,
-                   (int)parse_immediate(send_imm).block_number,
+                   (int)parse_immediate(send_imm, adaptive_block_size).block_number,
                    (int)receive_step);
             fflush(stdout);
         }
-        assert(block_number == parse_immediate(send_imm).block_number);
+        assert(block_number == parse_immediate(send_imm, adaptive_block_size).block_number);
 
         if(block_number == num_blocks - 1) {
-            message_size = (num_blocks - 1) * block_size + received_block_size;
+            message_size = (num_blocks - 1) * message_block_size + received_block_size;
         } else {
-            assert(received_block_size == block_size);
+            assert(received_block_size == message_block_size);
         }
 
         received_blocks[block_number] = true;
@@ -286,8 +300,10 @@ void polling_group::send_message(shared_ptr<memory_region> message_mr, size_t of
     mr = message_mr;
     mr_offset = offset;
     message_size = length;
-    num_blocks = (message_size - 1) / block_size + 1;
-    if(num_blocks > std::numeric_limits<uint16_t>::max())
+    block_size_shift = choose_block_size_shift(length);
+    message_block_size = block_size >> block_size_shift;
+    num_blocks = (message_size - 1) / message_block_size + 1;
+    if(num_blocks > (adaptive_block_size ? max_adaptive_message_blocks : max_message_blocks))
         throw rdmc::invalid_args();
     // printf("message_size = %lu, block_size = %lu, num_blocks = %lu\n",
     //        message_size, block_size, num_blocks);
@@ -336,16 +352,16 @@ void polling_group::send_next_block() {
     assert(it != endpoints.end());
 #endif
     if(first_block_number && block_number == *first_block_number) {
-        CHECK(it->second.post_send(*first_block_mr, 0, block_size,
+        CHECK(it->second.post_send(*first_block_mr, 0, first_block_size,
                                    form_tag(group_number, target),
-                                   form_immediate(num_blocks, block_number),
+                                   form_immediate(num_blocks, block_number, block_size_shift, adaptive_block_size),
                                    message_types.data_block));
     } else {
-        size_t offset = block_number * block_size;
-        size_t nbytes = min(block_size, message_size - offset);
+        size_t offset = block_number * message_block_size;
+        size_t nbytes = min(message_block_size, message_size - offset);
         CHECK(it->second.post_send(*mr, mr_offset + offset, nbytes,
                                    form_tag(group_number, target),
-                                   form_immediate(num_blocks, block_number),
+                                   form_immediate(num_blocks, block_number, block_size_shift, adaptive_block_size),
                                    message_types.data_block));
     }
     outgoing_block = block_number;
@@ -370,8 +386,8 @@ void polling_group::complete_message() {
         //            buffer + block_size * (*first_block_number));
         //     first_block_buffer = tmp_buffer;
         // } else {
-        memcpy(mr->buffer + mr_offset + block_size * (*first_block_number),
-               first_block_buffer.get(), block_size);
+        memcpy(mr->buffer + mr_offset + message_block_size * (*first_block_number),
+               first_block_buffer.get(), first_block_size);
         // }
         LOG_EVENT(group_number, message_number, *first_block_number,
                   "finished_remap_first_block");
@@ -406,6 +422,29 @@ void polling_group::complete_message() {
         //      << ")" << endl;
     }
 }
+uint8_t polling_group::choose_block_size_shift(size_t length) const {
+    if(!adaptive_block_size) {
+        return 0;
+    }
+    // A message of n blocks takes n + extra_steps steps, each of which costs
+    // the time to send one block plus block_overhead_bytes' worth. The total
+    // is smallest for blocks of sqrt(length * block_overhead_bytes / extra_steps)
+    // bytes, so use the smallest allowed block size that is at least that.
+    const size_t extra_steps = transfer_schedule->get_total_steps(1) - 1;
+    uint8_t shift = 0;
+    if(extra_steps > 0) {
+        const double ideal_block_size = std::max(sqrt((double)length * block_overhead_bytes / extra_steps),
+                                                 (double)min_block_size);
+        while(shift < max_block_size_shift && (block_size >> (shift + 1)) >= ideal_block_size) {
+            shift++;
+        }
+    }
+    // Fall back to bigger blocks if the message would have too many
+    while(shift > 0 && (length - 1) / (block_size >> shift) + 1 > max_adaptive_message_blocks) {
+        shift--;
+    }
+    return shift;
+}
 void polling_group::post_recv(schedule::block_transfer transfer) {
 #ifdef USE_VERBS_API
     auto it = queue_pairs.find(transfer.target);
@@ -423,8 +462,8 @@ void polling_group::post_recv(schedule::block_transfer transfer) {
                                    form_tag(group_number, transfer.target),
                                    message_types.data_block));
     } else {
-        size_t offset = block_size * transfer.block_number;
-        size_t length = min(block_size, (size_t)(message_size - offset));
+        size_t offset = message_block_size * transfer.block_number;
+        size_t length = min(message_block_size, (size_t)(message_size - offset));
 
         if(length > 0) {
             CHECK(it->second.post_recv(*mr, mr_offset + offset, length,
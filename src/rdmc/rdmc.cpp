@@ -9,6 +9,7 @@
     #include <derecho/rdmc/detail/lf_helper.hpp>
 #endif
 
+#include <algorithm>
 #include <atomic>
 #include <cmath>
 #include <cstdint>
@@ -21,6 +22,7 @@
 #include <utility>
 #include <vector>
 
+#include <derecho/conf/conf.hpp>
 #include <derecho/core/derecho_type_definitions.hpp>
 
 using namespace std;
@@ -74,14 +76,23 @@ bool create_group(uint16_t group_number, std::vector<uint32_t> members,
         send_schedule = new chain_schedule(members.size(), member_index);
     } else if(algorithm == TREE_SEND) {
         send_schedule = new tree_schedule(members.size(), member_index);
+    } else if(algorithm == HYBRID_SEND) {
+        send_schedule = new hybrid_schedule(members.size(), member_index,
+                                            get_member_racks(members));
     } else {
         puts("Unsupported group type?!");
         fflush(stdout);
         return false;
     }
 
+    // Without adaptive block sizes, every message uses block_size
+    size_t min_block_size = block_size;
+    if(derecho::getConfBoolean(CONF_DERECHO_RDMC_ADAPTIVE_BLOCK_SIZE)) {
+        min_block_size = std::clamp<size_t>(derecho::getConfUInt64(CONF_DERECHO_RDMC_MIN_BLOCK_SIZE), 1, block_size);
+    }
+
     unique_lock<mutex> lock(groups_lock);
-    auto g = make_shared<polling_group>(group_number, block_size, members,
+    auto g = make_shared<polling_group>(group_number, block_size, min_block_size, members,
                                         member_index, incoming_upcall, callback,
                                         unique_ptr<schedule>(send_schedule));
     auto p = groups.emplace(group_number, std::move(g));
@@ -118,6 +129,26 @@ bool send(uint16_t group_number, shared_ptr<memory_region> mr, size_t offset,
     g->send_message(mr, offset, length);
     return true;
 }
+vector<uint32_t> get_member_racks(const vector<uint32_t>& members) {
+    // The option is a list of node_id:rack pairs, where rack is any label
+    map<uint32_t, string> rack_labels;
+    for(const string& entry : derecho::split_string(derecho::getConfString(CONF_DERECHO_RDMC_RACKS))) {
+        auto colon = entry.find(':');
+        if(colon == string::npos) {
+            continue;
+        }
+        rack_labels[stoul(entry.substr(0, colon))] = entry.substr(colon + 1);
+    }
+    map<string, uint32_t> rack_numbers;
+    vector<uint32_t> member_racks;
+    for(uint32_t member : members) {
+        auto label = rack_labels.find(member);
+        member_racks.push_back(rack_numbers.emplace(label == rack_labels.end() ? "" : label->second,
+                                                    rack_numbers.size())
+                                       .first->second);
+    }
+    return member_racks;
+}
 // void query_addresses(std::map<uint32_t, std::string>& addresses,
 //                      uint32_t& node_rank) {
 //     query_peer_addresses(addresses, node_rank);
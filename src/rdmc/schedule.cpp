@@ -1,7 +1,9 @@
 #include <derecho/rdmc/detail/schedule.hpp>
 
+#include <algorithm>
 #include <cassert>
 #include <climits>
+#include <map>
 
 using std::min;
 using std::optional;
@@ -462,32 +464,194 @@ optional<size_t> binomial_schedule::get_intravertex_block(
     return last->block_number;
 }
 
-optional<schedule::block_transfer> binomial_schedule::get_outgoing_transfer(size_t num_blocks, size_t step) const {
-    return get_outgoing_transfer(member_index, step, num_members,
-                                 log2_num_members, num_blocks,
-                                 get_total_steps(num_blocks));
-}
-optional<schedule::block_transfer> binomial_schedule::get_incoming_transfer(size_t num_blocks, size_t step) const {
-    return get_incoming_transfer(member_index, step, num_members,
-                                 log2_num_members, num_blocks,
-                                 get_total_steps(num_blocks));
-}
-
-optional<schedule::block_transfer> binomial_schedule::get_first_block(size_t num_blocks) const {
-    if(member_index == 0) return std::nullopt;
+binomial_schedule::binomial_schedule(uint32_t members, uint32_t index)
+        : schedule(members, index),
+          log2_num_members(floor(log2(num_members))) {
+    if(member_index == 0) return;
 
     size_t simulated_total_steps = num_members == 1u << log2_num_members
                                            ? 1024 + log2_num_members - 1
                                            : 1024 + log2_num_members;
 
     size_t step = 0;
-    optional<block_transfer> transfer;
-    while(!transfer) {
-        transfer = get_incoming_transfer(member_index, step++, num_members,
-                                         log2_num_members, 1024,
-                                         simulated_total_steps);
+    while(!first_block) {
+        first_block = get_incoming_transfer(member_index, step++, num_members,
+                                            log2_num_members, 1024,
+                                            simulated_total_steps);
         assert(step < simulated_total_steps);
     }
+}
+
+const binomial_schedule::transfer_tables& binomial_schedule::get_tables(size_t num_blocks) const {
+    auto cached = std::find_if(cached_tables.begin(), cached_tables.end(),
+                               [num_blocks](const transfer_tables& tables) { return tables.num_blocks == num_blocks; });
+    if(cached == cached_tables.end()) {
+        // Reuse the least recently used tables' memory
+        if(cached_tables.size() < max_cached_tables) {
+            cached_tables.emplace_back();
+        }
+        cached = cached_tables.end() - 1;
+        const size_t total_steps = get_total_steps(num_blocks);
+        cached->num_blocks = num_blocks;
+        cached->outgoing.resize(total_steps);
+        cached->incoming.resize(total_steps);
+        for(size_t step = 0; step < total_steps; ++step) {
+            auto outgoing = get_outgoing_transfer(member_index, step, num_members,
+                                                  log2_num_members, num_blocks, total_steps);
+            auto incoming = get_incoming_transfer(member_index, step, num_members,
+                                                  log2_num_members, num_blocks, total_steps);
+            cached->outgoing[step] = outgoing ? table_entry{outgoing->target, (uint32_t)outgoing->block_number}
+                                              : table_entry{no_transfer, 0};
+            cached->incoming[step] = incoming ? table_entry{incoming->target, (uint32_t)incoming->block_number}
+                                              : table_entry{no_transfer, 0};
+        }
+    }
+    // Keep the most recently used tables first
+    std::rotate(cached_tables.begin(), cached, cached + 1);
+    return cached_tables.front();
+}
+
+optional<schedule::block_transfer> binomial_schedule::lookup(const vector<table_entry>& table, size_t step) {
+    if(step >= table.size() || table[step].target == no_transfer) return std::nullopt;
+    return block_transfer{table[step].target, table[step].block_number};
+}
 
-    return transfer;
+optional<schedule::block_transfer> binomial_schedule::get_outgoing_transfer(size_t num_blocks, size_t step) const {
+    return lookup(get_tables(num_blocks).outgoing, step);
+}
+optional<schedule::block_transfer> binomial_schedule::get_incoming_transfer(size_t num_blocks, size_t step) const {
+    return lookup(get_tables(num_blocks).incoming, step);
+}
+
+optional<schedule::block_transfer> binomial_schedule::get_first_block(size_t num_blocks) const {
+    return first_block;
+}
+
+hybrid_schedule::hybrid_schedule(uint32_t members, uint32_t index, const vector<uint32_t>& member_racks)
+        : schedule(members, index) {
+    // Number the racks in order of their first member, so that the sender's rack comes first
+    std::map<uint32_t, uint32_t> rack_numbers;
+    for(uint32_t member = 0; member < num_members; ++member) {
+        auto rack = rack_numbers.emplace(member_racks[member], racks.size()).first->second;
+        if(rack == racks.size()) {
+            racks.emplace_back();
+        }
+        racks[rack].push_back(member);
+        if(member == member_index) {
+            my_rack = rack;
+            my_position = racks[rack].size() - 1;
+        }
+    }
+    log2_num_racks = floor(log2(racks.size()));
+    num_pipelines = 1;
+    for(const auto& rack : racks) {
+        num_pipelines = std::max(num_pipelines, (uint32_t)rack.size());
+    }
+}
+size_t hybrid_schedule::get_pipeline_blocks(size_t num_blocks, uint32_t pipeline) const {
+    return (num_blocks + num_pipelines - 1 - pipeline) / num_pipelines;
+}
+size_t hybrid_schedule::get_pipeline_total_steps(size_t pipeline_blocks) const {
+    if(racks.size() == 1 || pipeline_blocks == 0) {
+        return 0;
+    }
+    if(1u << log2_num_racks == racks.size()) {
+        return pipeline_blocks + log2_num_racks - 1;
+    }
+    return pipeline_blocks + log2_num_racks;
+}
+size_t hybrid_schedule::get_leader_total_steps(size_t num_blocks) const {
+    // Pipeline 0 carries the most blocks, so it takes the most steps
+    return num_pipelines * get_pipeline_total_steps(get_pipeline_blocks(num_blocks, 0));
+}
+optional<schedule::block_transfer> hybrid_schedule::get_binomial_transfer(bool outgoing, uint32_t rack,
+                                                                          size_t num_blocks, size_t step) const {
+    const uint32_t pipeline = step % num_pipelines;
+    const size_t pipeline_step = step / num_pipelines;
+    const size_t pipeline_blocks = get_pipeline_blocks(num_blocks, pipeline);
+    const size_t pipeline_total_steps = get_pipeline_total_steps(pipeline_blocks);
+    if(pipeline_step >= pipeline_total_steps) return std::nullopt;
+    auto transfer = outgoing ? binomial_schedule::get_outgoing_transfer(rack, pipeline_step, racks.size(), log2_num_racks,
+                                                                       pipeline_blocks, pipeline_total_steps)
+                             : binomial_schedule::get_incoming_transfer(rack, pipeline_step, racks.size(), log2_num_racks,
+                                                                       pipeline_blocks, pipeline_total_steps);
+    if(!transfer) return std::nullopt;
+    return block_transfer{transfer->target, transfer->block_number * num_pipelines + pipeline};
+}
+optional<size_t> hybrid_schedule::get_leader_block(uint32_t rack, size_t num_blocks, size_t step) const {
+    if(rack == 0) {
+        // The sender has every block, so it starts its chain right away
+        if(step >= num_blocks) return std::nullopt;
+        return step;
+    }
+    auto transfer = get_binomial_transfer(false, rack, num_blocks, step);
+    if(!transfer) return std::nullopt;
+    return transfer->block_number;
+}
+vector<uint32_t> hybrid_schedule::get_connections() const {
+    vector<uint32_t> ret;
+    auto add = [&ret](uint32_t member) {
+        if(std::find(ret.begin(), ret.end(), member) == ret.end()) ret.push_back(member);
+    };
+    if(racks.size() > 1) {
+        const bool receives_binomial = my_position == 0 && my_rack != 0;
+        const bool sends_binomial = my_position + 1 == racks[my_rack].size();
+        for(uint32_t rack : binomial_schedule(racks.size(), my_rack).get_connections()) {
+            if(receives_binomial) add(binomial_sender(rack));
+            if(sends_binomial) add(binomial_receiver(rack));
+        }
+    }
+    if(my_position > 0) {
+        add(racks[my_rack][my_position - 1]);
+    }
+    if(my_position + 1 < racks[my_rack].size()) {
+        add(racks[my_rack][my_position + 1]);
+    }
+    return ret;
+}
+size_t hybrid_schedule::get_total_steps(size_t num_blocks) const {
+    // The binomial transfers and the chains each use their own steps, with the chains following their leaders
+    return std::max(get_leader_total_steps(num_blocks), num_blocks);
+}
+optional<schedule::block_transfer> hybrid_schedule::get_outgoing_transfer(size_t num_blocks, size_t step) const {
+    if(my_position + 1 < racks[my_rack].size()) {
+        // Forward down the chain what the leader got on this step
+        auto block = get_leader_block(my_rack, num_blocks, step);
+        if(!block) return std::nullopt;
+        return block_transfer{racks[my_rack][my_position + 1], *block};
+    }
+    // The end of the chain sends the rack's binomial transfers
+    auto transfer = get_binomial_transfer(true, my_rack, num_blocks, step);
+    if(!transfer) return std::nullopt;
+    return block_transfer{binomial_receiver(transfer->target), transfer->block_number};
+}
+optional<schedule::block_transfer> hybrid_schedule::get_incoming_transfer(size_t num_blocks, size_t step) const {
+    if(my_position > 0) {
+        auto block = get_leader_block(my_rack, num_blocks, step);
+        if(!block) return std::nullopt;
+        return block_transfer{racks[my_rack][my_position - 1], *block};
+    }
+    if(my_rack == 0) return std::nullopt;
+    auto transfer = get_binomial_transfer(false, my_rack, num_blocks, step);
+    if(!transfer) return std::nullopt;
+    return block_transfer{binomial_sender(transfer->target), transfer->block_number};
+}
+optional<schedule::block_transfer> hybrid_schedule::get_first_block(size_t num_blocks) const {
+    if(member_index == 0) return std::nullopt;
+    optional<block_transfer> leader_first_block;
+    if(my_rack == 0) {
+        leader_first_block = block_transfer{0, 0};
+    } else {
+        // The first block comes from pipeline 0, whose steps come first
+        const size_t pipeline_blocks = get_pipeline_blocks(num_blocks, 0);
+        leader_first_block = binomial_schedule(racks.size(), my_rack).get_first_block(pipeline_blocks);
+        assert(leader_first_block);
+        leader_first_block->target = binomial_sender(leader_first_block->target);
+        leader_first_block->block_number = std::min(leader_first_block->block_number, pipeline_blocks - 1) * num_pipelines;
+    }
+    if(my_position == 0) {
+        return leader_first_block;
+    }
+    // A chain member first gets whatever its leader got first
+    return block_transfer{racks[my_rack][my_position - 1], leader_first_block->block_number};
 }
@@ -307,11 +307,16 @@ _resources::_resources(
         char* read_addr,
         int size_w,
         int size_r,
-        int is_lf_server)
+        int is_lf_server,
+        bool allow_shm)
         : remote_failed(false),
           remote_id(r_id),
+          ep(nullptr),
+          write_mr(nullptr),
+          read_mr(nullptr),
           write_buf(write_addr),
-          read_buf(read_addr) {
+          read_buf(read_addr),
+          eq(nullptr) {
     dbg_default_trace("resources constructor: this={}", (void*)this);
 
     if(!write_addr) {
@@ -322,6 +327,17 @@ _resources::_resources(
         dbg_default_warn("{}:{} called with NULL read_addr!", __FILE__, __func__);
     }
 
+    // A co-located remote node can map our write buffer, and we its, so
+    // there is no need to register memory or connect an endpoint
+    tcp::tcp_connections* connections = sst_connections->contains_node(this->remote_id)
+                                                ? sst_connections
+                                                : external_client_connections;
+    shm = shm_peer::try_connect(*connections, this->remote_id, write_buf, size_w, read_buf, allow_shm);
+    if(shm) {
+        dbg_default_info("Using shared memory instead of RDMA for the connection to node {}", this->remote_id);
+        return;
+    }
+
 #define LF_RMR_KEY(rid) (((uint64_t)0xf0000000) << 32 | (uint64_t)(rid))
 #define LF_WMR_KEY(rid) (((uint64_t)0xf8000000) << 32 | (uint64_t)(rid))
     // register the write buffer
@@ -387,6 +403,24 @@ int _resources::post_remote_send(
     }
     int ret = 0;
 
+    if(shm) {
+        if(op == 1) {
+            shm->write(offset, size);
+        } else if(op == 0) {
+            shm->read(offset, size);
+        } else {
+            dbg_default_error("lf.cpp: two-sided sends are not supported over shared memory.");
+            return -EINVAL;
+        }
+        // The copy is already complete, so the only way it can fail is if the
+        // remote process is gone; report that the same way a failed RDMA
+        // completion would be reported
+        if(completion) {
+            util::polling_data.insert_completion_entry(ctxt->ce_idx(), {ctxt->remote_id(), shm->remote_alive() ? 1 : -1});
+        }
+        return 0;
+    }
+
     if(op == 2) {  // two sided send
         struct fi_msg msg;
         struct iovec msg_iov;
@@ -454,6 +488,52 @@ int _resources::post_remote_send(
     return ret;
 }
 
+int _resources::post_remote_write_list(const write_range* writes, const std::size_t num_writes) {
+    if(remote_failed) {
+        dbg_default_warn("lf.cpp: remote has failed, post_remote_write_list() does nothing.");
+        return -EFAULT;
+    }
+    if(shm) {
+        for(std::size_t i = 0; i < num_writes; ++i) {
+            shm->write(writes[i].offset, writes[i].size);
+        }
+        return 0;
+    }
+    void* desc = fi_mr_desc(this->read_mr);
+    auto remote_has_failed = [this]() { return remote_failed.load(); };
+    for(std::size_t i = 0; i < num_writes; ++i) {
+        struct iovec msg_iov;
+        struct fi_rma_iov rma_iov;
+        struct fi_msg_rma msg;
+
+        msg_iov.iov_base = read_buf + writes[i].offset;
+        msg_iov.iov_len = writes[i].size;
+
+        rma_iov.addr = ((LF_USE_VADDR) ? remote_fi_addr : 0) + writes[i].offset;
+        rma_iov.len = writes[i].size;
+        rma_iov.key = this->mr_rwkey;
+
+        msg.msg_iov = &msg_iov;
+        msg.desc = &desc;
+        msg.iov_count = 1;
+        msg.addr = 0;  // not used for a connection endpoint
+        msg.rma_iov = &rma_iov;
+        msg.rma_iov_count = 1;
+        msg.context = nullptr;
+        msg.data = 0l;  // not used
+
+        // FI_MORE tells the provider more writes follow immediately, so it can
+        // defer ringing the doorbell until the last write of the list
+        const uint64_t flags = (i + 1 < num_writes) ? FI_MORE : 0;
+        int ret = retry_on_eagain_unless("fi_writemsg failed.", remote_has_failed,
+                                         fi_writemsg, this->ep, &msg, flags);
+        if(ret != 0) {
+            return ret;
+        }
+    }
+    return 0;
+}
+
 void resources::report_failure() {
     remote_failed = true;
 }
@@ -490,6 +570,14 @@ void resources::post_remote_write(const long long int offset, long long int size
     }
 }
 
+void resources::post_remote_writes(const write_range* writes, const std::size_t num_writes) {
+    int return_code = post_remote_write_list(writes, num_writes);
+    if(return_code != 0) {
+        dbg_default_error("post_remote_writes failed with return code {}", return_code);
+        std::cerr << "post_remote_writes failed with return code " << return_code << std::endl;
+    }
+}
+
 void resources::post_remote_write_with_completion(lf_sender_ctxt* ctxt, const long long int size) {
     int return_code = post_remote_send(ctxt, 0, size, 1, true);
     if(return_code != 0) {
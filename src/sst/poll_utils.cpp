@@ -1,68 +1,179 @@
-#include <iostream>
-#include <numeric>
-#include <functional>
+#include <cassert>
+#include <stdexcept>
+#include <string>
 
 #include <derecho/sst/detail/poll_utils.hpp>
+#include <derecho/utils/logger.hpp>
 
 namespace sst {
 namespace util {
 
-//std::vector<std::list<std::pair<int32_t, int32_t>>> PollingData::completion_entries;
-//std::map<std::thread::id, uint32_t> PollingData::tid_to_index;
-//std::vector<bool> PollingData::if_waiting;
-//std::condition_variable PollingData::poll_cv;
-//std::mutex PollingData::poll_mutex;
-
 //Single global instance, defined here
 PollingData polling_data;
 
-bool PollingData::check_waiting() {
-    return std::accumulate(if_waiting.begin(), if_waiting.end(), false, [](bool a, bool b) { return a || b; });
+thread_local PollingData::thread_registration PollingData::this_thread_slot;
+
+PollingData::completion_slot::completion_slot() : enqueue_pos(0), dequeue_pos(0), call_sequence(0), waiting(false), owned(false), has_overflow(false) {
+    for(uint64_t i = 0; i < slot_capacity; ++i) {
+        cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
 }
 
-void PollingData::insert_completion_entry(uint32_t index, std::pair<int32_t, int32_t> ce) {
-    std::lock_guard<std::mutex> lk(poll_mutex);
-    completion_entries[index].push_back(ce);
+bool PollingData::completion_slot::push(const std::pair<int32_t, int32_t>& ce) {
+    uint64_t pos = enqueue_pos.load(std::memory_order_relaxed);
+    while(true) {
+        cell& target = cells[pos % slot_capacity];
+        const uint64_t sequence = target.sequence.load(std::memory_order_acquire);
+        if(sequence == pos) {
+            // The cell is free; claim it unless another producer got there first
+            if(enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                target.entry = ce;
+                target.sequence.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        } else if(sequence < pos) {
+            // The owner has not yet read the entry written a whole queue ago
+            return false;
+        } else {
+            pos = enqueue_pos.load(std::memory_order_relaxed);
+        }
+    }
 }
 
-std::optional<std::pair<int32_t, int32_t>> PollingData::get_completion_entry(const std::thread::id id) {
-    std::lock_guard<std::mutex> lk(poll_mutex);
-    auto index = tid_to_index[id];
-    if(completion_entries[index].empty()) {
-        return {};
+bool PollingData::completion_slot::push_overflow(const std::pair<int32_t, int32_t>& ce) {
+    std::lock_guard<std::mutex> lock(overflow_mutex);
+    overflow.push_back(ce);
+    has_overflow.store(true, std::memory_order_release);
+    return overflow.size() == 1;
+}
+
+std::optional<std::pair<int32_t, int32_t>> PollingData::completion_slot::pop() {
+    cell& target = cells[dequeue_pos % slot_capacity];
+    if(target.sequence.load(std::memory_order_acquire) != dequeue_pos + 1) {
+        if(!has_overflow.load(std::memory_order_acquire)) {
+            return std::nullopt;
+        }
+        std::lock_guard<std::mutex> lock(overflow_mutex);
+        if(overflow.empty()) {
+            return std::nullopt;
+        }
+        const std::pair<int32_t, int32_t> ce = overflow.front();
+        overflow.pop_front();
+        has_overflow.store(!overflow.empty(), std::memory_order_release);
+        return ce;
     }
-    auto ce = completion_entries[index].front();
-    completion_entries[index].pop_front();
+    const std::pair<int32_t, int32_t> ce = target.entry;
+    // Free the cell for the producer that will claim this position next time around
+    target.sequence.store(dequeue_pos + slot_capacity, std::memory_order_release);
+    ++dequeue_pos;
     return ce;
 }
 
-uint32_t PollingData::get_index(const std::thread::id id) {
-    std::lock_guard<std::mutex> lk(poll_mutex);
-    if(tid_to_index.find(id) == tid_to_index.end()) {
-        completion_entries.push_back(std::list<std::pair<int32_t, int32_t>>());
-        tid_to_index[id] = completion_entries.size() - 1;
-        if_waiting.push_back(false);
+PollingData::thread_registration::~thread_registration() {
+    if(index != max_slots) {
+        polling_data.release_slot(index);
     }
-    return tid_to_index[id];
+}
+
+PollingData::PollingData() : num_slots(0), num_waiting(0) {
+    for(auto& slot : slots) {
+        slot.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+PollingData::~PollingData() {
+    for(auto& slot : slots) {
+        delete slot.load(std::memory_order_relaxed);
+    }
+}
+
+PollingData::completion_slot& PollingData::my_slot() {
+    if(this_thread_slot.index == max_slots) {
+        std::lock_guard<std::mutex> lk(registration_mutex);
+        if(!free_slots.empty()) {
+            this_thread_slot.index = free_slots.back();
+            free_slots.pop_back();
+        } else {
+            const uint32_t index = num_slots.load(std::memory_order_relaxed);
+            if(index == max_slots) {
+                throw std::runtime_error("More than " + std::to_string(max_slots)
+                                         + " live threads waiting for SST completions");
+            }
+            slots[index].store(new completion_slot(), std::memory_order_release);
+            num_slots.store(index + 1, std::memory_order_relaxed);
+            this_thread_slot.index = index;
+        }
+        completion_slot& slot = *slots[this_thread_slot.index].load(std::memory_order_acquire);
+        // Discard completions that arrived for the previous owner after it stopped waiting
+        while(slot.pop()) {
+        }
+        slot.owned.store(true, std::memory_order_release);
+        return slot;
+    }
+    return *slots[this_thread_slot.index].load(std::memory_order_acquire);
+}
+
+void PollingData::release_slot(uint32_t index) {
+    reset_waiting(std::this_thread::get_id());
+    completion_slot& slot = *slots[index].load(std::memory_order_acquire);
+    // Stop accepting completions, then free the cells the exiting owner never read
+    slot.owned.store(false, std::memory_order_release);
+    while(slot.pop()) {
+    }
+    std::lock_guard<std::mutex> lk(registration_mutex);
+    free_slots.push_back(index);
+}
+
+void PollingData::insert_completion_entry(uint32_t index, std::pair<int32_t, int32_t> ce) {
+    completion_slot* slot = index < max_slots ? slots[index].load(std::memory_order_acquire) : nullptr;
+    if(slot == nullptr || !slot->owned.load(std::memory_order_acquire)) {
+        // The thread that posted the operation has exited, so nobody will read it
+        return;
+    }
+    if(!slot->push(ce) && slot->push_overflow(ce)) {
+        dbg_default_warn("PollingData: the owner of completion slot {} has {} unread completions; keeping the rest in an overflow list",
+                         index, slot_capacity);
+    }
+}
+
+std::optional<std::pair<int32_t, int32_t>> PollingData::get_completion_entry(const std::thread::id id) {
+    assert(id == std::this_thread::get_id());
+    return my_slot().pop();
+}
+
+uint32_t PollingData::get_index(const std::thread::id id) {
+    assert(id == std::this_thread::get_id());
+    my_slot();
+    return this_thread_slot.index;
+}
+
+uint32_t PollingData::next_sequence(const std::thread::id id) {
+    assert(id == std::this_thread::get_id());
+    return ++my_slot().call_sequence;
 }
 
 void PollingData::set_waiting(const std::thread::id id) {
-    std::lock_guard<std::mutex> lk(poll_mutex);
-    auto index = tid_to_index[id];
-    if_waiting[index] = true;
-    poll_cv.notify_all();
+    assert(id == std::this_thread::get_id());
+    if(!my_slot().waiting.exchange(true) && num_waiting.fetch_add(1) == 0) {
+        // The polling thread may be asleep in wait_for_requests
+        std::lock_guard<std::mutex> lk(poll_mutex);
+        poll_cv.notify_all();
+    }
 }
 
 void PollingData::reset_waiting(const std::thread::id id) {
-    std::lock_guard<std::mutex> lk(poll_mutex);
-    auto index = tid_to_index[id];
-    if_waiting[index] = false;
+    assert(id == std::this_thread::get_id());
+    if(this_thread_slot.index == max_slots) {
+        return;
+    }
+    if(my_slot().waiting.exchange(false)) {
+        num_waiting.fetch_sub(1);
+    }
 }
 
 void PollingData::wait_for_requests() {
     std::unique_lock<std::mutex> lk(poll_mutex);
-    // poll_cv.wait(lk, check_waiting);
-    poll_cv.wait(lk, std::bind(&PollingData::check_waiting, this));
+    poll_cv.wait(lk, [this]() { return num_waiting.load() > 0; });
 }
 }  // namespace util
 }  // namespace sst
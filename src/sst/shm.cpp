@@ -0,0 +1,466 @@
+/**
+ * @file shm.cpp
+ * Implementation of the shared-memory transport declared in shm.hpp.
+ */
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <ifaddrs.h>
+#include <map>
+#include <mutex>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <new>
+#include <pthread.h>
+#include <string>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+#include <derecho/conf/conf.hpp>
+#include <derecho/core/detail/connection_manager.hpp>
+#include <derecho/sst/detail/shm.hpp>
+#include <derecho/utils/logger.hpp>
+
+namespace sst {
+
+namespace {
+
+constexpr std::size_t max_shm_name_len = 64;
+constexpr std::size_t max_hostname_len = 64;
+
+/** Where a buffer lies in a shared memory segment. */
+struct shm_location_t {
+    char segment_name[max_shm_name_len];
+    uint64_t segment_size;
+    uint64_t buffer_offset;
+} __attribute__((packed));
+
+/**
+ * What one end of a connection offers the other during shm_peer::try_connect.
+ * The other fields are only meaningful if usable is nonzero and the hostnames
+ * match, so they can stay in host byte order.
+ */
+struct shm_offer_t {
+    uint8_t usable;
+    char hostname[max_hostname_len];
+    shm_location_t buffer;
+    uint64_t buffer_size;
+    /** The offering process's heartbeat counter. */
+    shm_location_t heartbeat;
+} __attribute__((packed));
+
+/** A buffer handed out by shm_allocate(). */
+struct segment_t {
+    std::size_t size;
+    /** The name of the shared memory segment, or empty for private memory. */
+    std::string name;
+    /** An open descriptor of the segment, which holds a shared flock on it; -1 for private memory. */
+    int fd;
+};
+
+std::mutex segments_mutex;
+/** All live buffers from shm_allocate(), keyed by base address. Protected by segments_mutex. */
+std::map<const char*, segment_t> segments;
+
+/**
+ * If [buffer, buffer + size) lies in a shared memory segment, fills in its
+ * location and returns true.
+ */
+bool locate_segment(const char* buffer, std::size_t size, shm_location_t& location) {
+    std::lock_guard<std::mutex> lock(segments_mutex);
+    auto segment = segments.upper_bound(buffer);
+    if(segment == segments.begin()) {
+        return false;
+    }
+    --segment;
+    if(segment->second.name.empty() || buffer + size > segment->first + segment->second.size) {
+        return false;
+    }
+    strncpy(location.segment_name, segment->second.name.c_str(), max_shm_name_len - 1);
+    location.segment_size = segment->second.size;
+    location.buffer_offset = buffer - segment->first;
+    return true;
+}
+
+/**
+ * Maps the segment at the given location, which must be exactly as large as
+ * the location says. If fd is not null, leaves the segment open there.
+ * Returns nullptr on failure.
+ */
+char* map_segment(const shm_location_t& location, bool writable, int* fd = nullptr) {
+    char* mapping = nullptr;
+    int segment_fd = shm_open(location.segment_name, writable ? O_RDWR : O_RDONLY, 0);
+    if(segment_fd < 0) {
+        return nullptr;
+    }
+    struct stat segment_stat;
+    if(fstat(segment_fd, &segment_stat) == 0 && static_cast<uint64_t>(segment_stat.st_size) == location.segment_size) {
+        void* addr = mmap(nullptr, location.segment_size, writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                          MAP_SHARED, segment_fd, 0);
+        if(addr != MAP_FAILED) {
+            mapping = static_cast<char*>(addr);
+        }
+    }
+    if(mapping && fd) {
+        *fd = segment_fd;
+    } else {
+        close(segment_fd);
+    }
+    return mapping;
+}
+
+/** Returns true if the segment open at fd is still the one that the given name refers to. */
+bool still_linked(int fd, const std::string& name) {
+    struct stat fd_stat;
+    struct stat name_stat;
+    return fstat(fd, &fd_stat) == 0 && stat(("/dev/shm" + name).c_str(), &name_stat) == 0
+           && fd_stat.st_dev == name_stat.st_dev && fd_stat.st_ino == name_stat.st_ino;
+}
+
+/**
+ * Copies size bytes in ascending address order, storing a word at a time
+ * with release semantics, so that a reader that sees a later word also sees
+ * all the earlier ones (the ordering Derecho assumes of RDMA writes).
+ */
+void copy_in_order(char* dst, const char* src, std::size_t size) {
+    std::size_t i = 0;
+    for(; i < size && reinterpret_cast<uintptr_t>(dst + i) % sizeof(uint64_t) != 0; ++i) {
+        __atomic_store_n(dst + i, src[i], __ATOMIC_RELEASE);
+    }
+    for(; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, src + i, sizeof(word));
+        __atomic_store_n(reinterpret_cast<uint64_t*>(dst + i), word, __ATOMIC_RELEASE);
+    }
+    for(; i < size; ++i) {
+        __atomic_store_n(dst + i, src[i], __ATOMIC_RELEASE);
+    }
+}
+
+std::once_flag stale_segments_removed;
+
+/**
+ * Removes the segments left in /dev/shm by Derecho processes that exited
+ * without calling shm_free(), such as ones that crashed. The process that
+ * creates a segment holds a shared flock on it until it frees it, and the
+ * kernel releases the lock when the process exits, so a segment is stale if
+ * an exclusive lock on it can be taken. Unlike the process ID in the name,
+ * this cannot be fooled by PID namespaces or a reused process ID.
+ */
+void remove_stale_segments() {
+    DIR* shm_dir = opendir("/dev/shm");
+    if(!shm_dir) {
+        return;
+    }
+    while(struct dirent* entry = readdir(shm_dir)) {
+        if(strncmp(entry->d_name, "derecho-", strlen("derecho-")) != 0) {
+            continue;
+        }
+        const std::string name = "/" + std::string(entry->d_name);
+        int fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if(fd < 0) {
+            continue;
+        }
+        if(flock(fd, LOCK_EX | LOCK_NB) == 0 && still_linked(fd, name)) {
+            dbg_default_info("Removing shared memory segment {}, which no live process holds", entry->d_name);
+            shm_unlink(name.c_str());
+        }
+        close(fd);
+    }
+    closedir(shm_dir);
+}
+
+/**
+ * Creates a segment of the given size and maps it, taking a shared flock on
+ * it that fd keeps for as long as the segment lives. Returns nullptr, with
+ * errno set, on failure.
+ */
+char* create_segment(const std::string& name, std::size_t size, int& fd) {
+    fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if(fd < 0) {
+        return nullptr;
+    }
+    // Another process's remove_stale_segments() can lock and unlink the new
+    // segment before this one locks it, which would leave peers unable to
+    // open it, so check that the name still refers to it once it is locked
+    if(flock(fd, LOCK_SH) != 0 || !still_linked(fd, name)) {
+        close(fd);
+        errno = ENOENT;
+        return nullptr;
+    }
+    // Reserve the pages now: with only ftruncate, running out of
+    // space in /dev/shm would raise SIGBUS on first touch instead
+    const int error = posix_fallocate(fd, 0, size);
+    if(error == 0) {
+        void* addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if(addr != MAP_FAILED) {
+            return static_cast<char*>(addr);
+        }
+    } else {
+        errno = error;
+    }
+    const int saved_errno = errno;
+    shm_unlink(name.c_str());
+    close(fd);
+    errno = saved_errno;
+    return nullptr;
+}
+
+/**
+ * A counter in shared memory that a thread of this process increments
+ * periodically, so that co-located peers can tell that the process is still
+ * running. RDMA peers learn the same from failed or missing completions.
+ */
+struct local_heartbeat_t {
+    volatile uint64_t* counter;
+    std::string name;
+
+    local_heartbeat_t() {
+        char* buffer = shm_allocate(sizeof(uint64_t));
+        counter = reinterpret_cast<volatile uint64_t*>(buffer);
+        {
+            std::lock_guard<std::mutex> lock(segments_mutex);
+            name = segments.at(buffer).name;
+        }
+        const auto period = std::chrono::milliseconds(
+                std::max(1u, derecho::getConfUInt32(CONF_DERECHO_SST_POLL_CQ_TIMEOUT_MS) / 10));
+        // The counter is never freed, so the thread can run until the process exits
+        std::thread([counter = counter, period]() {
+            pthread_setname_np(pthread_self(), "shm_heartbeat");
+            while(true) {
+                __atomic_add_fetch(counter, 1, __ATOMIC_RELEASE);
+                std::this_thread::sleep_for(period);
+            }
+        }).detach();
+    }
+    /** Leaves the memory mapped for the heartbeat thread, but removes the segment's name. */
+    ~local_heartbeat_t() {
+        if(!name.empty()) {
+            shm_unlink(name.c_str());
+        }
+    }
+};
+
+/** Returns this process's heartbeat, starting it on the first call. */
+const local_heartbeat_t& local_heartbeat() {
+    static local_heartbeat_t heartbeat;
+    return heartbeat;
+}
+
+}  // namespace
+
+char* shm_allocate(std::size_t size) {
+    static std::atomic<uint64_t> next_segment_num{0};
+    assert(size > 0);
+    char* buffer = nullptr;
+    std::string name;
+    int fd = -1;
+    if(derecho::getConfBoolean(CONF_DERECHO_SHM_TRANSPORT)) {
+        std::call_once(stale_segments_removed, remove_stale_segments);
+        // A name can be taken by a process with the same ID in another PID
+        // namespace, or lost to a concurrent remove_stale_segments(), so try a few
+        int error = 0;
+        for(int attempt = 0; attempt < 3 && !buffer; ++attempt) {
+            name = "/derecho-" + std::to_string(getpid()) + "-" + std::to_string(next_segment_num++);
+            buffer = create_segment(name, size, fd);
+            error = errno;
+            if(!buffer && error != EEXIST && error != ENOENT) {
+                break;
+            }
+        }
+        errno = error;
+        if(!buffer) {
+            dbg_default_warn("Could not create shared memory segment {}: {}. Using private memory instead.",
+                             name, strerror(errno));
+            name.clear();
+        }
+    }
+    if(!buffer) {
+        void* addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(addr == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        buffer = static_cast<char*>(addr);
+    }
+    std::lock_guard<std::mutex> lock(segments_mutex);
+    segments[buffer] = segment_t{size, name, name.empty() ? -1 : fd};
+    return buffer;
+}
+
+void shm_free(char* buffer) {
+    if(buffer == nullptr) {
+        return;
+    }
+    segment_t segment;
+    {
+        std::lock_guard<std::mutex> lock(segments_mutex);
+        auto segment_iter = segments.find(buffer);
+        if(segment_iter == segments.end()) {
+            dbg_default_error("shm_free() called on a buffer that shm_allocate() did not return");
+            return;
+        }
+        segment = std::move(segment_iter->second);
+        segments.erase(segment_iter);
+    }
+    munmap(buffer, segment.size);
+    if(!segment.name.empty()) {
+        shm_unlink(segment.name.c_str());
+        close(segment.fd);
+    }
+}
+
+std::unique_ptr<shm_peer> shm_peer::try_connect(tcp::tcp_connections& connections, node_id_t remote_id,
+                                                char* write_buf, std::size_t write_size, char* read_buf,
+                                                bool allow) {
+    shm_offer_t local_offer;
+    shm_offer_t remote_offer;
+    memset(&local_offer, 0, sizeof(local_offer));
+    const std::string remote_ip = connections.get_socket(remote_id).get().get_remote_ip();
+    if(allow && derecho::getConfBoolean(CONF_DERECHO_SHM_TRANSPORT)
+       && is_local_ip(remote_ip) && locate_segment(write_buf, write_size, local_offer.buffer)
+       && locate_segment(const_cast<char*>(reinterpret_cast<volatile char*>(local_heartbeat().counter)),
+                         sizeof(uint64_t), local_offer.heartbeat)) {
+        local_offer.usable = 1;
+        local_offer.buffer_size = write_size;
+        gethostname(local_offer.hostname, max_hostname_len - 1);
+    }
+    try {
+        connections.exchange(remote_id, local_offer, remote_offer);
+    } catch(tcp::socket_error&) {
+        dbg_default_error("Failed to exchange shared memory info with node {}", remote_id);
+        return nullptr;
+    }
+    remote_offer.hostname[max_hostname_len - 1] = '\0';
+    remote_offer.buffer.segment_name[max_shm_name_len - 1] = '\0';
+    remote_offer.heartbeat.segment_name[max_shm_name_len - 1] = '\0';
+
+    char* mapping = nullptr;
+    char* heartbeat_mapping = nullptr;
+    int heartbeat_fd = -1;
+    if(local_offer.usable && remote_offer.usable
+       && strncmp(local_offer.hostname, remote_offer.hostname, max_hostname_len) == 0) {
+        mapping = map_segment(remote_offer.buffer, true);
+        if(mapping) {
+            heartbeat_mapping = map_segment(remote_offer.heartbeat, false, &heartbeat_fd);
+        }
+        if(!heartbeat_mapping) {
+            dbg_default_warn("Could not map shared memory segments {} and {} of node {}: {}",
+                             remote_offer.buffer.segment_name, remote_offer.heartbeat.segment_name,
+                             remote_id, strerror(errno));
+            if(mapping) {
+                munmap(mapping, remote_offer.buffer.segment_size);
+                mapping = nullptr;
+            }
+        }
+    }
+    // Both ends must have mapped the other's segments, or neither uses them
+    uint8_t local_mapped = (mapping != nullptr);
+    uint8_t remote_mapped = 0;
+    try {
+        connections.exchange(remote_id, local_mapped, remote_mapped);
+    } catch(tcp::socket_error&) {
+        remote_mapped = 0;
+    }
+    if(!local_mapped || !remote_mapped) {
+        if(mapping) {
+            munmap(mapping, remote_offer.buffer.segment_size);
+            munmap(heartbeat_mapping, remote_offer.heartbeat.segment_size);
+            close(heartbeat_fd);
+        }
+        return nullptr;
+    }
+    return std::unique_ptr<shm_peer>(new shm_peer(
+            mapping, remote_offer.buffer.segment_size, mapping + remote_offer.buffer.buffer_offset, read_buf,
+            heartbeat_mapping, remote_offer.heartbeat.segment_size,
+            reinterpret_cast<const volatile uint64_t*>(heartbeat_mapping + remote_offer.heartbeat.buffer_offset),
+            heartbeat_fd));
+}
+
+shm_peer::shm_peer(char* mapping, std::size_t mapping_size, char* remote_buf, char* local_buf,
+                   char* heartbeat_mapping, std::size_t heartbeat_mapping_size,
+                   const volatile uint64_t* remote_heartbeat, int heartbeat_fd)
+        : mapping(mapping),
+          mapping_size(mapping_size),
+          remote_buf(remote_buf),
+          local_buf(local_buf),
+          heartbeat_mapping(heartbeat_mapping),
+          heartbeat_mapping_size(heartbeat_mapping_size),
+          remote_heartbeat(remote_heartbeat),
+          heartbeat_fd(heartbeat_fd),
+          heartbeat_timeout(derecho::getConfUInt32(CONF_DERECHO_SST_POLL_CQ_TIMEOUT_MS)),
+          last_heartbeat(__atomic_load_n(remote_heartbeat, __ATOMIC_ACQUIRE)),
+          last_heartbeat_change(std::chrono::steady_clock::now()) {}
+
+shm_peer::~shm_peer() {
+    munmap(mapping, mapping_size);
+    munmap(heartbeat_mapping, heartbeat_mapping_size);
+    close(heartbeat_fd);
+}
+
+void shm_peer::write(const long long int offset, const long long int size) {
+    assert(remote_buf + offset + size <= mapping + mapping_size);
+    copy_in_order(remote_buf + offset, local_buf + offset, size);
+}
+
+void shm_peer::read(const long long int offset, const long long int size) {
+    assert(remote_buf + offset + size <= mapping + mapping_size);
+    copy_in_order(local_buf + offset, remote_buf + offset, size);
+}
+
+bool shm_peer::remote_alive() {
+    std::lock_guard<std::mutex> lock(heartbeat_mutex);
+    // The peer holds a shared lock on its heartbeat segment until it exits
+    if(flock(heartbeat_fd, LOCK_EX | LOCK_NB) == 0) {
+        flock(heartbeat_fd, LOCK_UN);
+        return false;
+    }
+    const uint64_t heartbeat = __atomic_load_n(remote_heartbeat, __ATOMIC_ACQUIRE);
+    const auto now = std::chrono::steady_clock::now();
+    if(heartbeat != last_heartbeat) {
+        last_heartbeat = heartbeat;
+        last_heartbeat_change = now;
+        return true;
+    }
+    // A peer that is alive but hung stops beating, as an RDMA peer would stop acknowledging
+    return now - last_heartbeat_change < heartbeat_timeout;
+}
+
+bool is_local_ip(const std::string& ip) {
+    if(ip.compare(0, 4, "127.") == 0 || ip == "::1") {
+        return true;
+    }
+    struct ifaddrs* interfaces;
+    if(getifaddrs(&interfaces) != 0) {
+        return false;
+    }
+    bool found = false;
+    char address[INET6_ADDRSTRLEN];
+    for(struct ifaddrs* interface = interfaces; interface != nullptr && !found; interface = interface->ifa_next) {
+        if(interface->ifa_addr == nullptr) {
+            continue;
+        }
+        if(interface->ifa_addr->sa_family == AF_INET) {
+            inet_ntop(AF_INET, &reinterpret_cast<struct sockaddr_in*>(interface->ifa_addr)->sin_addr,
+                      address, sizeof(address));
+        } else if(interface->ifa_addr->sa_family == AF_INET6) {
+            inet_ntop(AF_INET6, &reinterpret_cast<struct sockaddr_in6*>(interface->ifa_addr)->sin6_addr,
+                      address, sizeof(address));
+        } else {
+            continue;
+        }
+        found = (ip == address);
+    }
+    freeifaddrs(interfaces);
+    return found;
+}
+
+}  // namespace sst
@@ -91,11 +91,16 @@ static bool shutdown = false;
  * where the results of RDMA reads from the remote node will arrive.
  * @param size_w The size of the write buffer (in bytes).
  * @param size_r The size of the read buffer (in bytes).
+ * @param allow_shm Whether the connection may use shared memory instead of
+ * RDMA if the remote node is on the same host.
  */
 _resources::_resources(int r_index, char* write_addr, char* read_addr, int size_w,
-                       int size_r)
+                       int size_r, bool allow_shm)
         : remote_failed(false),
           remote_index(r_index),
+          qp(nullptr),
+          write_mr(nullptr),
+          read_mr(nullptr),
           write_buf(write_addr),
           read_buf(read_addr) {
     if(!write_buf) {
@@ -106,6 +111,17 @@ _resources::_resources(int r_index, char* write_addr, char* read_addr, int size_
         cout << "Read address is NULL" << endl;
     }
 
+    // A co-located remote node can map our write buffer, and we its, so
+    // there is no need for memory regions or a queue pair
+    tcp::tcp_connections* connections = sst_connections->contains_node(r_index)
+                                                ? sst_connections
+                                                : external_client_connections;
+    shm = shm_peer::try_connect(*connections, r_index, write_buf, size_w, read_buf, allow_shm);
+    if(shm) {
+        dbg_default_info("Using shared memory instead of RDMA for the connection to node {}", r_index);
+        return;
+    }
+
     // register the memory buffer
     int mr_flags = 0;
     // allow access for only local writes and remote reads
@@ -337,6 +353,28 @@ int _resources::post_remote_send(verbs_sender_ctxt* sctxt, const long long int o
         return EFAULT;
     }
 
+    if(shm) {
+        if(op == 0) {
+            shm->read(offset, size);
+        } else if(op == 1) {
+            shm->write(offset, size);
+        } else {
+            cerr << "post_remote_send(): two-sided sends are not supported over shared memory." << std::endl;
+            return EINVAL;
+        }
+        // The copy is already complete, so the only way it can fail is if the
+        // remote process is gone; report that the same way a failed RDMA
+        // completion would be reported
+        if(completion) {
+            if(sctxt == nullptr) {
+                cerr << "post_remote_send(): sctxt cannot be nullptr for send with completion." << std::endl;
+                return EINVAL;
+            }
+            util::polling_data.insert_completion_entry(sctxt->ce_idx(), {sctxt->remote_id(), shm->remote_alive() ? 1 : -1});
+        }
+        return 0;
+    }
+
     // don't care where the read buffer is saved
     sge.addr = (uintptr_t)(read_buf + offset);
     sge.length = size;
@@ -396,6 +434,92 @@ int _resources::post_remote_send(verbs_sender_ctxt* sctxt, const long long int o
     return ret;
 }
 
+/**
+ * Posts a list of RDMA writes, none of which request a completion, chained
+ * together so that each call to ibv_post_send rings the doorbell only once.
+ * Flow control is the same as for individual writes in post_remote_send; if
+ * the queue pair fills up partway through the list, the writes built so far
+ * are posted before waiting for space.
+ *
+ * @param writes The ranges of the local row to write to the remote row, in order.
+ * @return The return code of the first failed IB Verbs post_send operation, or 0.
+ */
+int _resources::post_remote_write_list(const write_range* writes, const std::size_t num_writes) {
+    // Reused across calls so that batched writes do not allocate
+    thread_local std::vector<struct ibv_send_wr> work_requests;
+    thread_local std::vector<struct ibv_sge> sges;
+
+    if(remote_failed) {
+        return EFAULT;
+    }
+    if(shm) {
+        for(std::size_t i = 0; i < num_writes; ++i) {
+            shm->write(writes[i].offset, writes[i].size);
+        }
+        return 0;
+    }
+    work_requests.resize(num_writes);
+    sges.resize(num_writes);
+
+    std::size_t chain_start = 0;
+    // Posts work_requests[chain_start, chain_end) with a single ibv_post_send
+    auto post_chain = [&](std::size_t chain_end) {
+        if(chain_end == chain_start) {
+            return 0;
+        }
+        work_requests[chain_end - 1].next = NULL;
+        struct ibv_send_wr* first_wr = &work_requests[chain_start];
+        struct ibv_send_wr* bad_wr = NULL;
+        int ret;
+        do {
+            ret = ibv_post_send(qp, first_wr, &bad_wr);
+            // Work requests before bad_wr were posted; only retry the rest
+            if(ret == ENOMEM) {
+                first_wr = bad_wr;
+            }
+        } while(ret == ENOMEM);
+        chain_start = chain_end;
+        return ret;
+    };
+
+    for(std::size_t i = 0; i < num_writes; ++i) {
+        struct ibv_sge& sge = sges[i];
+        struct ibv_send_wr& sr = work_requests[i];
+        sge.addr = (uintptr_t)(read_buf + writes[i].offset);
+        sge.length = writes[i].size;
+        sge.lkey = read_mr->lkey;
+        memset(&sr, 0, sizeof(sr));
+        sr.next = (i + 1 < num_writes) ? &work_requests[i + 1] : NULL;
+        sr.wr_id = 0;
+        sr.sg_list = &sge;
+        sr.num_sge = 1;
+        sr.opcode = IBV_WR_RDMA_WRITE;
+        sr.wr.rdma.remote_addr = remote_props.addr + writes[i].offset;
+        sr.wr.rdma.rkey = remote_props.rkey;
+
+        uint32_t my_slot = ++without_completion_send_cnt;
+        if(my_slot > without_completion_send_capacity) {
+            // The signaled write that frees space may be in the unposted part
+            // of the chain, so post it before spinning
+            int ret = post_chain(i);
+            if(ret) {
+                return ret;
+            }
+            while(without_completion_send_cnt >= without_completion_send_capacity && !remote_failed)
+                ;
+            if(remote_failed) {
+                cerr << "sst::resources: Remote has failed, aborting post_remote_write_list()" << std::endl;
+                return EFAULT;
+            }
+        }
+        if((my_slot + 1) % without_completion_send_signal_interval == 0) {
+            sr.send_flags = IBV_SEND_SIGNALED;
+            sr.wr_id = reinterpret_cast<uint64_t>(&(this->without_completion_sender_ctxt));
+        }
+    }
+    return post_chain(num_writes);
+}
+
 resources::resources(int r_index, char* write_addr, char* read_addr, int size_w,
                      int size_r) : _resources(r_index, write_addr, read_addr, size_w, size_r) {
 }
@@ -448,6 +572,17 @@ void resources::post_remote_write(const long long int offset, const long long in
     }
 }
 
+/**
+ * @param writes The ranges of the local buffer to write into the same ranges
+ * of remote memory, in the order they should be performed.
+ */
+void resources::post_remote_writes(const write_range* writes, const std::size_t num_writes) {
+    int rc = post_remote_write_list(writes, num_writes);
+    if(rc) {
+        cout << "Could not post list of " << num_writes << " RDMA writes, error code is " << rc << ", remote_index is " << remote_index << endl;
+    }
+}
+
 void resources::post_remote_write_with_completion(verbs_sender_ctxt* sctxt, const long long int size) {
     int rc = post_remote_send(sctxt, 0, size, 1, true);
     if(rc) {
@@ -463,7 +598,7 @@ void resources::post_remote_write_with_completion(verbs_sender_ctxt* sctxt, cons
 }
 
 resources_two_sided::resources_two_sided(int r_index, char* write_addr, char* read_addr, int size_w,
-                                         int size_r) : _resources(r_index, write_addr, read_addr, size_w, size_r) {
+                                         int size_r) : _resources(r_index, write_addr, read_addr, size_w, size_r, false) {
 }
 
 void resources_two_sided::report_failure() {
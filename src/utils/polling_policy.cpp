@@ -0,0 +1,155 @@
+#include <derecho/conf/conf.hpp>
+#include <derecho/utils/polling_policy.hpp>
+#include <derecho/utils/time.h>
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <linux/futex.h>
+#include <sched.h>
+#include <sstream>
+#include <stdexcept>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+
+namespace derecho {
+
+PollingMode polling_mode_from_string(const std::string& name) {
+    if(name == "spin") {
+        return PollingMode::SPIN;
+    } else if(name == "spin_yield") {
+        return PollingMode::SPIN_YIELD;
+    } else if(name == "backoff") {
+        return PollingMode::BACKOFF;
+    } else if(name == "spin_sleep") {
+        return PollingMode::SPIN_SLEEP;
+    } else if(name == "spin_wait") {
+        return PollingMode::SPIN_WAIT;
+    }
+    throw std::invalid_argument("Unknown polling mode: " + name);
+}
+
+void LatencyHistogram::record(uint64_t latency_ns) {
+    std::size_t bucket = latency_ns == 0 ? 0 : 63 - __builtin_clzll(latency_ns);
+    buckets[std::min(bucket, NUM_BUCKETS - 1)].fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::count() const {
+    uint64_t total = 0;
+    for(const auto& bucket : buckets) {
+        total += bucket.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+uint64_t LatencyHistogram::percentile_upper_bound(double percentile) const {
+    const uint64_t total = count();
+    if(total == 0) {
+        return 0;
+    }
+    const uint64_t target = static_cast<uint64_t>(std::ceil(total * percentile / 100.0));
+    uint64_t seen = 0;
+    for(std::size_t i = 0; i < NUM_BUCKETS; ++i) {
+        seen += buckets[i].load(std::memory_order_relaxed);
+        if(seen >= target && seen > 0) {
+            return 2ull << i;
+        }
+    }
+    return 2ull << (NUM_BUCKETS - 1);
+}
+
+std::string LatencyHistogram::to_string() const {
+    std::stringstream out;
+    for(std::size_t i = 0; i < NUM_BUCKETS; ++i) {
+        uint64_t bucket_count = buckets[i].load(std::memory_order_relaxed);
+        if(bucket_count > 0) {
+            out << "[" << (1ull << i) << ", " << (2ull << i) << ") ns: " << bucket_count << std::endl;
+        }
+    }
+    return out.str();
+}
+
+PollingPolicy::PollingPolicy(PollingMode mode, uint64_t spin_us, uint64_t max_sleep_us)
+        : mode(mode),
+          spin_ns(spin_us * 1000),
+          max_sleep_ns(std::max<uint64_t>(max_sleep_us, 1) * 1000),
+          last_progress_time(get_time()),
+          next_sleep_ns(1000),
+          last_notify_time(0),
+          wake_sequence(0),
+          waiting(false) {}
+
+PollingPolicy PollingPolicy::from_config(const std::string& thread_name) {
+    const std::string prefix = "DERECHO/" + thread_name + "_polling_";
+    return PollingPolicy(polling_mode_from_string(getConfString(prefix + "mode")),
+                         getConfUInt64(prefix + "spin_us"),
+                         getConfUInt64(prefix + "max_sleep_us"));
+}
+
+void PollingPolicy::on_progress() {
+    last_progress_time = get_time();
+    next_sleep_ns = 1000;
+}
+
+void PollingPolicy::on_idle() {
+    if(mode == PollingMode::SPIN) {
+        return;
+    }
+    const uint64_t now = get_time();
+    if(now - last_progress_time <= spin_ns) {
+        return;
+    }
+    switch(mode) {
+        case PollingMode::SPIN_YIELD:
+            sched_yield();
+            break;
+        case PollingMode::BACKOFF:
+            std::this_thread::sleep_for(std::chrono::nanoseconds(next_sleep_ns));
+            next_sleep_ns = std::min(next_sleep_ns * 2, max_sleep_ns);
+            break;
+        case PollingMode::SPIN_SLEEP:
+            std::this_thread::sleep_for(std::chrono::nanoseconds(max_sleep_ns));
+            break;
+        case PollingMode::SPIN_WAIT:
+            if(wait_for_notify(max_sleep_ns)) {
+                // Work is on its way, so spin for it again instead of
+                // going straight back to the futex
+                last_progress_time = get_time();
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+void PollingPolicy::notify() {
+    last_notify_time.store(get_time(), std::memory_order_relaxed);
+    wake_sequence.fetch_add(1, std::memory_order_seq_cst);
+    if(waiting.load(std::memory_order_seq_cst)) {
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&wake_sequence),
+                FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+    }
+}
+
+bool PollingPolicy::wait_for_notify(uint64_t timeout_ns) {
+    // If notify() increments wake_sequence after it is read here, the futex
+    // wait returns immediately because the value no longer matches.
+    const uint32_t sequence = wake_sequence.load(std::memory_order_seq_cst);
+    waiting.store(true, std::memory_order_seq_cst);
+    struct timespec timeout;
+    timeout.tv_sec = timeout_ns / 1000000000ull;
+    timeout.tv_nsec = timeout_ns % 1000000000ull;
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&wake_sequence),
+            FUTEX_WAIT_PRIVATE, sequence, &timeout, nullptr, 0);
+    waiting.store(false, std::memory_order_relaxed);
+    if(wake_sequence.load(std::memory_order_seq_cst) == sequence) {
+        return false;
+    }
+    const uint64_t now = get_time();
+    const uint64_t notify_time = last_notify_time.load(std::memory_order_relaxed);
+    wakeup_latencies.record(now > notify_time ? now - notify_time : 0);
+    return true;
+}
+
+}  // namespace derecho